@@ -0,0 +1,186 @@
+#pragma once
+
+#ifndef IMAGE_POOL_H_INCLUDED
+#define IMAGE_POOL_H_INCLUDED
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+#include <boost/noncopyable.hpp>
+
+// Alignment of the data and of the row step of pooled and aligned images:
+// a cache line, enough for any SIMD load.
+static int const IMAGE_ROW_ALIGNMENT = 64;
+
+
+// Fills step[] of a dims-dimensional matrix of the cv type whose rows start at
+// IMAGE_ROW_ALIGNMENT boundaries and returns its size in bytes. Row steps that
+// are multiples of 4 KB get one more cache line, so that the rows of a column
+// do not all map to the same cache sets.
+inline size_t alignedImageSteps(int dims, const int* sizes, int type, size_t* step)
+{
+  step[dims - 1] = CV_ELEM_SIZE(type);
+  for (int i = dims - 2; i >= 0; --i)
+  {
+    step[i] = step[i + 1] * sizes[i + 1];
+    if (i == dims - 2)
+    {
+      step[i] = cv::alignSize(step[i], IMAGE_ROW_ALIGNMENT);
+      if (step[i] % 4096 == 0)
+        step[i] += IMAGE_ROW_ALIGNMENT;
+    }
+  }
+  return step[0] * sizes[0];
+}
+
+
+struct ImagePoolStats
+{
+  uint64 hits;            // allocations served from a free list
+  uint64 misses;          // allocations that went to the system
+  uint64 discards;        // released blocks freed because the cache was full
+  size_t bytesInUse;
+  size_t peakBytesInUse;
+  size_t bytesCached;     // held in free lists
+
+  ImagePoolStats()
+  : hits(0),
+    misses(0),
+    discards(0),
+    bytesInUse(0),
+    peakBytesInUse(0),
+    bytesCached(0)
+  { }
+};
+
+
+// cv::MatAllocator keeping released image buffers in per-size-class free lists,
+// so that per-frame images of a video pipeline are recycled instead of
+// reallocated. Rows are laid out as by alignedImageSteps(). Size classes step
+// by a quarter of a power of two (at most 25% waste), and at most
+// maxCachedBytes are kept around.
+//
+//   ImagePool pool;
+//   cv::Mat frame;
+//   frame.allocator = &pool;
+//   frame.create(height, width, CV_8UC3);  // or MinImgMat(width, height, type, &pool)
+//
+// The pool must outlive every matrix allocated from it. It is thread-safe.
+class ImagePool : public cv::MatAllocator, private boost::noncopyable
+{
+public:
+  explicit ImagePool(size_t maxCachedBytes = 256 << 20)
+  : maxCachedBytes_(maxCachedBytes)
+  { }
+
+  ~ImagePool()
+  {
+    trim();
+  }
+
+  void allocate(int dims, const int* sizes, int type, int*& refcount,
+                uchar*& datastart, uchar*& data, size_t* step)
+  {
+    size_t const capacity = sizeClass(alignedImageSteps(dims, sizes, type, step) + IMAGE_ROW_ALIGNMENT);
+
+    Block * block = 0;
+    {
+      cv::AutoLock lock(mutex_);
+      std::vector<Block*> & freeList = free_[capacity];
+      if (!freeList.empty())
+      {
+        block = freeList.back();
+        freeList.pop_back();
+        stats_.bytesCached -= capacity;
+        ++stats_.hits;
+      }
+      else
+      {
+        ++stats_.misses;
+      }
+      stats_.bytesInUse += capacity;
+      stats_.peakBytesInUse = std::max(stats_.peakBytesInUse, stats_.bytesInUse);
+    }
+
+    if (!block)
+    {
+      block = new Block;
+      block->memory = static_cast<uchar*>(cv::fastMalloc(capacity));
+      block->capacity = capacity;
+    }
+    block->refcount = 1;
+    refcount = &block->refcount;
+    datastart = data = cv::alignPtr(block->memory, IMAGE_ROW_ALIGNMENT);
+  }
+
+  void deallocate(int* refcount, uchar* /*datastart*/, uchar* /*data*/)
+  {
+    Block * block = reinterpret_cast<Block*>(refcount);
+    {
+      cv::AutoLock lock(mutex_);
+      stats_.bytesInUse -= block->capacity;
+      if (stats_.bytesCached + block->capacity <= maxCachedBytes_)
+      {
+        free_[block->capacity].push_back(block);
+        stats_.bytesCached += block->capacity;
+        return;
+      }
+      ++stats_.discards;
+    }
+    release(block);
+  }
+
+  // frees every cached buffer
+  void trim()
+  {
+    std::map<size_t, std::vector<Block*> > cached;
+    {
+      cv::AutoLock lock(mutex_);
+      cached.swap(free_);
+      stats_.bytesCached = 0;
+    }
+    for (std::map<size_t, std::vector<Block*> >::iterator it = cached.begin(); it != cached.end(); ++it)
+      for (size_t i = 0; i < it->second.size(); ++i)
+        release(it->second[i]);
+  }
+
+  ImagePoolStats stats() const
+  {
+    cv::AutoLock lock(mutex_);
+    return stats_;
+  }
+
+private:
+  struct Block
+  {
+    int refcount;  // first member, so that the refcount pointer is the block pointer
+    uchar* memory;
+    size_t capacity;
+  };
+
+  // bytes rounded up to 4 KB or to the next of 4, 5, 6, 7 times a power of two
+  static size_t sizeClass(size_t bytes)
+  {
+    size_t const minClass = 4096;
+    if (bytes <= minClass)
+      return minClass;
+    size_t quarter = 1;
+    while (quarter * 8 <= bytes)
+      quarter <<= 1;
+    return (bytes + quarter - 1) / quarter * quarter;
+  }
+
+  static void release(Block * block)
+  {
+    cv::fastFree(block->memory);
+    delete block;
+  }
+
+  size_t const maxCachedBytes_;
+  mutable cv::Mutex mutex_;
+  std::map<size_t, std::vector<Block*> > free_;
+  ImagePoolStats stats_;
+};
+
+#endif  /* IMAGE_POOL_H_INCLUDED */
@@ -3,7 +3,11 @@
 #ifndef OCV_INTEROP_H_INCLUDED
 #define OCV_INTEROP_H_INCLUDED
 
+#include <new>
+#include <vector>
 #include <opencv2/opencv.hpp>
+#include "minerrutils.h"
+#include "image-pool.h"
 
 inline int minImgFromCvMat(MinImg *dst, const cv::Mat *src)
 {
@@ -92,4 +96,160 @@ inline int minImgToCvMat(const MinImg *src, cv::Mat *dst)
   return NO_ERRORS;
 }
 
+
+// Alignment of the rows of images allocated by MinImgMat.
+static int const OCV_INTEROP_ALIGNMENT = IMAGE_ROW_ALIGNMENT;
+
+
+// cv::MatAllocator that lays out every matrix as alignedImageSteps() does, without
+// pooling (see ImagePool). Matrices keep their usual refcounted lifetime, and
+// their ROIs and copies release through the same allocator.
+class AlignedMatAllocator : public cv::MatAllocator
+{
+public:
+  void allocate(int dims, const int* sizes, int type, int*& refcount,
+                uchar*& datastart, uchar*& data, size_t* step)
+  {
+    size_t const total = alignedImageSteps(dims, sizes, type, step);
+
+    // the refcount lives in a header that also remembers the unaligned block
+    Header * header = new Header;
+    header->block = static_cast<uchar*>(cv::fastMalloc(total + OCV_INTEROP_ALIGNMENT));
+    header->refcount = 1;
+    refcount = &header->refcount;
+    datastart = data = cv::alignPtr(header->block, OCV_INTEROP_ALIGNMENT);
+  }
+
+  void deallocate(int* refcount, uchar* /*datastart*/, uchar* /*data*/)
+  {
+    Header * header = reinterpret_cast<Header*>(refcount);
+    cv::fastFree(header->block);
+    delete header;
+  }
+
+private:
+  struct Header
+  {
+    int refcount;  // first member, so that the refcount pointer is the header pointer
+    uchar* block;
+  };
+};
+
+inline AlignedMatAllocator * alignedMatAllocator()
+{
+  static AlignedMatAllocator allocator;
+  return &allocator;
+}
+
+
+// A MinImg and a cv::Mat describing the same pixels. The buffer is shared
+// by reference count: copies, ROIs and cv::Mat headers obtained from mat()
+// keep it alive, and no pixel is ever copied between the two views.
+//
+//   MinImgMat img(width, height, CV_8UC1);   // aligned rows; pass an ImagePool to recycle buffers
+//   minImgKernel(img.minImg(), ...);         // MinImg-based code
+//   cv::GaussianBlur(img.mat(), ...);        // OpenCV on the same buffer
+class MinImgMat
+{
+public:
+  MinImgMat()
+  : img_()
+  { }
+
+  // allocates a width x height image of the cv type with OCV_INTEROP_ALIGNMENT-aligned rows
+  // from allocator, which must lay out rows as alignedImageSteps() (e.g. an ImagePool)
+  MinImgMat(int width, int height, int cvType, cv::MatAllocator * allocator = alignedMatAllocator())
+  : img_()
+  {
+    mat_.allocator = allocator;
+    mat_.create(height, width, cvType);
+    update();
+  }
+
+  // shares the buffer of mat (refcounted if mat owns its data)
+  explicit MinImgMat(cv::Mat const& mat)
+  : mat_(mat),
+    img_()
+  {
+    update();
+  }
+
+  // wraps pixels owned by somebody else; img must outlive this object and its copies
+  static MinImgMat borrow(MinImg const& img)
+  {
+    cv::Mat mat;
+    THROW_ON_MINERR(minImgToCvMat(&img, &mat));
+    return MinImgMat(mat);
+  }
+
+  // plane images of one type in a single aligned allocation, e.g. for planar YUV
+  static std::vector<MinImgMat> createPlanes(int width, int height, int planes, int cvType,
+                                             cv::MatAllocator * allocator = alignedMatAllocator())
+  {
+    MinImgMat const all(width, height * planes, cvType, allocator);
+    std::vector<MinImgMat> result;
+    for (int i = 0; i < planes; ++i)
+      result.push_back(MinImgMat(all.mat_.rowRange(i * height, (i + 1) * height)));
+    return result;
+  }
+
+  // sub-view sharing the buffer
+  MinImgMat roi(cv::Rect const& rect) const
+  {
+    return MinImgMat(mat_(rect));
+  }
+
+  MinImgMat roi(int x, int y, int width, int height) const
+  {
+    return roi(cv::Rect(x, y, width, height));
+  }
+
+  bool empty() const { return mat_.empty(); }
+
+  // true if the first pixel and the row step are multiples of alignment
+  bool isAligned(int alignment = OCV_INTEROP_ALIGNMENT) const
+  {
+    return reinterpret_cast<size_t>(mat_.data) % alignment == 0 && mat_.step[0] % alignment == 0;
+  }
+
+  // reallocates the buffer, unless it already has this size and type
+  void create(int width, int height, int cvType)
+  {
+    if (mat_.allocator == 0)
+      mat_.allocator = alignedMatAllocator();
+    mat_.create(height, width, cvType);
+    update();
+  }
+
+  // shares the buffer of mat instead of the current one
+  void assign(cv::Mat const& mat)
+  {
+    mat_ = mat;
+    update();
+  }
+
+  void release()
+  {
+    mat_.release();
+    update();
+  }
+
+  // Both views describe the same pixels, which may be written through them.
+  // A copy of the cv::Mat header that gets reallocated no longer shares them;
+  // change the buffer with create() or assign() instead.
+  MinImg const* minImg() const { return &img_; }
+  cv::Mat const& mat() const { return mat_; }
+
+private:
+  void update()
+  {
+    img_ = MinImg();
+    if (!mat_.empty())
+      THROW_ON_MINERR(minImgFromCvMat(&img_, &mat_));
+  }
+
+  cv::Mat mat_;
+  MinImg img_;
+};
+
 #endif  /* OCV_INTEROP_H_INCLUDED */
\ No newline at end of file
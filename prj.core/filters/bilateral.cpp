@@ -0,0 +1,297 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "filters.h"
+
+
+namespace rsdt { namespace filters {
+
+// Bilateral grid (Paris-Durand, Chen et al.): pixels are splatted into a coarse
+// (y, x, intensity) grid of homogeneous values (channel sums and a weight), the grid
+// is blurred by a separable Gaussian and the result is sliced back by trilinear
+// interpolation at each pixel's (x, y, intensity). Colour images use the grey level
+// as the range coordinate and carry the three channels as values.
+
+namespace {
+
+struct Grid
+{
+  int cols;      // x cells
+  int rows;      // y cells
+  int depth;     // intensity cells
+  int values;    // channels + weight
+  int pad;       // cells around the image on every side
+  double space_step;
+  double range_step;
+  std::vector<float> data;
+  // offset of the lower intensity cell and weight of the upper one, per grey level
+  size_t z_offset[256];
+  float z_weight[256];
+
+  size_t cell_stride() const { return values; }
+  size_t x_stride() const { return depth * cell_stride(); }
+  size_t y_stride() const { return cols * x_stride(); }
+  float * row(int y) { return &data[y * y_stride()]; }
+  float const* row(int y) const { return &data[y * y_stride()]; }
+
+  void init_range_lut()
+  {
+    for (int v = 0; v < 256; ++v)
+    {
+      double const fz = v / range_step;
+      int const z = static_cast<int>(fz);
+      z_offset[v] = (z + pad) * cell_stride();
+      z_weight[v] = static_cast<float>(fz - z);
+    }
+  }
+};
+
+
+// grid row y receives image rows [first_row[y], first_row[y + 1]), so splatting is race-free
+// when split over grid rows
+template <int CN>
+class Splat : public cv::ParallelLoopBody
+{
+public:
+  Splat(cv::Mat const& src, cv::Mat const& guide, Grid & grid, std::vector<int> const& first_row)
+    : src_(src), guide_(guide), grid_(grid), first_row_(first_row)
+  {
+    x_offset_.resize(src.cols);
+    for (int x = 0; x < src.cols; ++x)
+      x_offset_[x] = (cvRound(x / grid.space_step) + grid.pad) * grid.x_stride();
+  }
+
+  void operator()(cv::Range const& range) const
+  {
+    size_t const zs = grid_.cell_stride();
+    for (int gy = range.start; gy < range.end; ++gy)
+    {
+      float * const grow = grid_.row(gy);
+      for (int y = first_row_[gy]; y < first_row_[gy + 1]; ++y)
+      {
+        uchar const* s = src_.ptr(y);
+        uchar const* g = guide_.ptr(y);
+        for (int x = 0; x < src_.cols; ++x, s += CN)
+        {
+          // linear in intensity, nearest in space
+          float const wz = grid_.z_weight[g[x]];
+          float * const c0 = grow + x_offset_[x] + grid_.z_offset[g[x]];
+          float * const c1 = c0 + zs;
+          for (int c = 0; c < CN; ++c)
+          {
+            c0[c] += (1 - wz) * s[c];
+            c1[c] += wz * s[c];
+          }
+          c0[CN] += 1 - wz;
+          c1[CN] += wz;
+        }
+      }
+    }
+  }
+
+private:
+  cv::Mat const& src_;
+  cv::Mat const& guide_;
+  Grid & grid_;
+  std::vector<int> const& first_row_;
+  std::vector<size_t> x_offset_;
+};
+
+
+// in-place convolution of n lines of count cells of V values each, spaced by stride
+template <int V>
+static void blur_lines(float * base, size_t line_stride, int lines, size_t stride, int count,
+                       std::vector<float> const& taps, std::vector<float> & buf)
+{
+  int const r = static_cast<int>(taps.size()) / 2;
+  buf.assign((count + 2 * r) * V, 0.0f);
+  for (int l = 0; l < lines; ++l)
+  {
+    float * const line = base + l * line_stride;
+    for (int i = 0; i < count; ++i)
+      std::copy(line + i * stride, line + i * stride + V, &buf[(i + r) * V]);
+    for (int i = 0; i < count; ++i)
+    {
+      float * const out = line + i * stride;
+      std::fill(out, out + V, 0.0f);
+      for (int t = 0; t <= 2 * r; ++t)
+      {
+        float const* in = &buf[(i + t) * V];
+        for (int v = 0; v < V; ++v)
+          out[v] += taps[t] * in[v];
+      }
+    }
+  }
+}
+
+// blur along intensity and x inside every y slice of the grid
+template <int V>
+class BlurSlices : public cv::ParallelLoopBody
+{
+public:
+  BlurSlices(Grid & grid, std::vector<float> const& taps) : grid_(grid), taps_(taps) { }
+
+  void operator()(cv::Range const& range) const
+  {
+    std::vector<float> buf;
+    for (int gy = range.start; gy < range.end; ++gy)
+    {
+      float * const slice = grid_.row(gy);
+      blur_lines<V>(slice, grid_.x_stride(), grid_.cols, grid_.cell_stride(), grid_.depth, taps_, buf);
+      blur_lines<V>(slice, grid_.cell_stride(), grid_.depth, grid_.x_stride(), grid_.cols, taps_, buf);
+    }
+  }
+
+private:
+  Grid & grid_;
+  std::vector<float> const& taps_;
+};
+
+// blur along y inside every x slice of the grid
+template <int V>
+class BlurColumns : public cv::ParallelLoopBody
+{
+public:
+  BlurColumns(Grid & grid, std::vector<float> const& taps) : grid_(grid), taps_(taps) { }
+
+  void operator()(cv::Range const& range) const
+  {
+    std::vector<float> buf;
+    for (int gx = range.start; gx < range.end; ++gx)
+      blur_lines<V>(&grid_.data[gx * grid_.x_stride()], grid_.cell_stride(), grid_.depth,
+                    grid_.y_stride(), grid_.rows, taps_, buf);
+  }
+
+private:
+  Grid & grid_;
+  std::vector<float> const& taps_;
+};
+
+
+template <int CN>
+class Slice : public cv::ParallelLoopBody
+{
+public:
+  Slice(Grid const& grid, cv::Mat const& guide, cv::Mat & dst) : grid_(grid), guide_(guide), dst_(dst)
+  {
+    x0_.resize(dst.cols);
+    wx_.resize(dst.cols);
+    for (int x = 0; x < dst.cols; ++x)
+    {
+      double const fx = x / grid.space_step + grid.pad;
+      int const x0 = static_cast<int>(fx);
+      x0_[x] = x0 * grid.x_stride();
+      wx_[x] = static_cast<float>(fx - x0);
+    }
+  }
+
+  void operator()(cv::Range const& range) const
+  {
+    size_t const xs = grid_.x_stride();
+    size_t const ys = grid_.y_stride();
+    size_t const zs = grid_.cell_stride();
+    for (int y = range.start; y < range.end; ++y)
+    {
+      double const fy = y / grid_.space_step + grid_.pad;
+      int const y0 = static_cast<int>(fy);
+      float const wy = static_cast<float>(fy - y0);
+      float const* const grow = grid_.row(y0);
+      uchar const* g = guide_.ptr(y);
+      uchar * d = dst_.ptr(y);
+      for (int x = 0; x < dst_.cols; ++x, d += CN)
+      {
+        float const wz = grid_.z_weight[g[x]];
+        float const wx = wx_[x];
+        float const* const c = grow + x0_[x] + grid_.z_offset[g[x]];
+        float const w[8] = {
+          (1 - wy) * (1 - wx) * (1 - wz), (1 - wy) * (1 - wx) * wz,
+          (1 - wy) * wx * (1 - wz),       (1 - wy) * wx * wz,
+          wy * (1 - wx) * (1 - wz),       wy * (1 - wx) * wz,
+          wy * wx * (1 - wz),             wy * wx * wz };
+        float const* const corner[8] = {
+          c, c + zs, c + xs, c + xs + zs, c + ys, c + ys + zs, c + ys + xs, c + ys + xs + zs };
+
+        float acc[CN + 1] = { 0 };
+        for (int k = 0; k < 8; ++k)
+          for (int v = 0; v <= CN; ++v)
+            acc[v] += w[k] * corner[k][v];
+        float const inv = acc[CN] > 0 ? 1.0f / acc[CN] : 0.0f;
+        for (int ch = 0; ch < CN; ++ch)
+          d[ch] = cv::saturate_cast<uchar>(acc[ch] * inv);
+      }
+    }
+  }
+
+private:
+  Grid const& grid_;
+  cv::Mat const& guide_;
+  cv::Mat & dst_;
+  std::vector<size_t> x0_;
+  std::vector<float> wx_;
+};
+
+
+template <int CN>
+static void filter_on_grid(cv::Mat const& src, cv::Mat const& guide, cv::Mat & dst, Grid & grid,
+                           std::vector<float> const& taps, std::vector<int> const& first_row)
+{
+  cv::parallel_for_(cv::Range(0, grid.rows), Splat<CN>(src, guide, grid, first_row));
+  cv::parallel_for_(cv::Range(0, grid.rows), BlurSlices<CN + 1>(grid, taps));
+  cv::parallel_for_(cv::Range(0, grid.cols), BlurColumns<CN + 1>(grid, taps));
+
+  // a grey src is its own guide and may be dst as well
+  cv::Mat const slice_guide = guide.data == dst.data ? guide.clone() : guide;
+  dst.create(src.size(), src.type());
+  cv::parallel_for_(cv::Range(0, src.rows), Slice<CN>(grid, slice_guide, dst));
+}
+
+}
+
+
+void bilateral_grid(cv::Mat const& src, cv::Mat & dst, BilateralGridSettings const& settings)
+{
+  CV_Assert(src.type() == CV_8UC1 || src.type() == CV_8UC3);
+  CV_Assert(settings.sigma_space > 0 && settings.sigma_range > 0 && settings.cells_per_sigma > 0);
+
+  cv::Mat guide;
+  if (src.channels() == 3)
+    cv::cvtColor(src, guide, CV_BGR2GRAY);
+  else
+    guide = src;
+
+  // the blur is a Gaussian of sigma = cells_per_sigma cells, truncated at 2 sigma
+  double const cps = settings.cells_per_sigma;
+  int const blur_r = std::max(1, static_cast<int>(std::ceil(2 * cps)));
+  std::vector<float> taps(2 * blur_r + 1);
+  float taps_sum = 0;
+  for (int i = -blur_r; i <= blur_r; ++i)
+    taps_sum += taps[i + blur_r] = static_cast<float>(std::exp(-0.5 * i * i / (cps * cps)));
+  for (size_t i = 0; i < taps.size(); ++i)
+    taps[i] /= taps_sum;
+
+  Grid grid;
+  grid.space_step = settings.sigma_space / cps;
+  grid.range_step = settings.sigma_range / cps;
+  grid.pad = blur_r;
+  grid.values = src.channels() + 1;
+  // + 1 for the upper neighbour of trilinear splatting and slicing
+  grid.cols = static_cast<int>((src.cols - 1) / grid.space_step) + 1 + 2 * grid.pad + 1;
+  grid.rows = static_cast<int>((src.rows - 1) / grid.space_step) + 1 + 2 * grid.pad + 1;
+  grid.depth = static_cast<int>(255 / grid.range_step) + 1 + 2 * grid.pad + 1;
+  grid.data.assign(grid.rows * grid.y_stride(), 0.0f);
+  grid.init_range_lut();
+
+  std::vector<int> first_row(grid.rows + 1, src.rows);
+  for (int y = src.rows - 1; y >= 0; --y)
+    first_row[cvRound(y / grid.space_step) + grid.pad] = y;
+  for (int gy = grid.rows - 1; gy >= 0; --gy)
+    first_row[gy] = std::min(first_row[gy], first_row[gy + 1]);
+
+  if (src.channels() == 3)
+    filter_on_grid<3>(src, guide, dst, grid, taps, first_row);
+  else
+    filter_on_grid<1>(src, guide, dst, grid, taps, first_row);
+}
+
+}}
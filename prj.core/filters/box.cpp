@@ -0,0 +1,46 @@
+#include <vector>
+#include "kernels.h"
+#include "simd.h"
+
+
+namespace rsdt { namespace filters { namespace kernels {
+
+void box_blur(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int rx, int ry)
+{
+  int const kw = 2 * rx + 1;
+  int const kh = 2 * ry + 1;
+  int const padded_width = width + 2 * rx;
+  uint8_t const* const top = src - ry * src_step - rx;
+
+  // vertical sums of kh rows for every padded column, updated as the window moves down
+  std::vector<int32_t> col(padded_width, 0);
+  for (int i = 0; i < kh; ++i)
+  {
+    uint8_t const* row = top + i * src_step;
+    for (int x = 0; x < padded_width; ++x)
+      col[x] += row[x];
+  }
+
+  float const scale = 1.0f / (kw * kh);
+  for (int y = 0; y < height; ++y)
+  {
+    if (y > 0)
+      simd::add_sub_u8_to_s32(&col[0], top + (y + kh - 1) * src_step, top + (y - 1) * src_step,
+                              padded_width);
+
+    int32_t s = 0;
+    for (int x = 0; x < kw; ++x)
+      s += col[x];
+    uint8_t * d = dst + y * dst_step;
+    for (int x = 0; ; ++x)
+    {
+      d[x] = static_cast<uint8_t>(s * scale + 0.5f);
+      if (x + 1 == width)
+        break;
+      s += col[x + kw] - col[x];
+    }
+  }
+}
+
+}}}
@@ -0,0 +1,298 @@
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "filters.h"
+#include "kernels.h"
+
+
+namespace rsdt { namespace filters {
+
+// copy of src with the given border on every side, as the raw kernels expect
+static cv::Mat pad(cv::Mat const& src, int left, int top, int right, int bottom,
+                   int border_type, cv::Scalar const& value = cv::Scalar())
+{
+  cv::Mat padded;
+  cv::copyMakeBorder(src, padded, top, bottom, left, right, border_type, value);
+  return padded;
+}
+
+static uint8_t const* origin(cv::Mat const& padded, int left, int top)
+{
+  return padded.ptr(top) + left;
+}
+
+
+void box_blur(cv::Mat const& src, cv::Mat & dst, cv::Size const& ksize)
+{
+  CV_Assert(src.type() == CV_8UC1 && ksize.width % 2 == 1 && ksize.height % 2 == 1);
+  int const rx = ksize.width / 2;
+  int const ry = ksize.height / 2;
+  cv::Mat const padded = pad(src, rx, ry, rx, ry, cv::BORDER_REFLECT_101);
+  dst.create(src.size(), CV_8UC1);
+  kernels::box_blur(origin(padded, rx, ry), padded.step, dst.data, dst.step, src.cols, src.rows, rx, ry);
+}
+
+
+// Q8 coefficients of cv::getGaussianKernel; rounding residue goes to the center tap
+static std::vector<int> gaussian_q8(int ksize, double sigma)
+{
+  cv::Mat const k = cv::getGaussianKernel(ksize, sigma, CV_64F);
+  std::vector<int> q(ksize);
+  int sum = 0;
+  for (int i = 0; i < ksize; ++i)
+  {
+    q[i] = cvRound(k.at<double>(i) * 256);
+    sum += q[i];
+  }
+  q[ksize / 2] += 256 - sum;
+  return q;
+}
+
+void gaussian_blur(cv::Mat const& src, cv::Mat & dst, cv::Size const& ksize, double sigma_x, double sigma_y)
+{
+  CV_Assert(src.type() == CV_8UC1 && ksize.width % 2 == 1 && ksize.height % 2 == 1);
+  if (sigma_y <= 0)
+    sigma_y = sigma_x;
+  std::vector<int> const kx = gaussian_q8(ksize.width, sigma_x);
+  std::vector<int> const ky = gaussian_q8(ksize.height, sigma_y);
+  int const rx = ksize.width / 2;
+  int const ry = ksize.height / 2;
+  cv::Mat const padded = pad(src, rx, ry, rx, ry, cv::BORDER_REFLECT_101);
+  dst.create(src.size(), CV_8UC1);
+  kernels::sep_filter_q8(origin(padded, rx, ry), padded.step, dst.data, dst.step, src.cols, src.rows,
+                         &kx[0], ksize.width, &ky[0], ksize.height);
+}
+
+
+// tiles of median_blur: column stripes sized for the cache, split into row bands
+// long enough to amortize filling the column histograms
+class MedianTiles : public cv::ParallelLoopBody
+{
+public:
+  MedianTiles(cv::Mat const& padded, cv::Mat & dst, int r)
+    : padded_(padded), dst_(dst), r_(r),
+      tile_width_(kernels::median_tile_width(r)),
+      band_height_(std::max(64, 8 * (2 * r + 1))),
+      tile_cols_((dst.cols + tile_width_ - 1) / tile_width_)
+  { }
+
+  int count() const
+  {
+    return tile_cols_ * ((dst_.rows + band_height_ - 1) / band_height_);
+  }
+
+  void operator()(cv::Range const& range) const
+  {
+    for (int i = range.start; i < range.end; ++i)
+    {
+      int const x0 = (i % tile_cols_) * tile_width_;
+      int const y0 = (i / tile_cols_) * band_height_;
+      int const width = std::min(tile_width_, dst_.cols - x0);
+      int const height = std::min(band_height_, dst_.rows - y0);
+      kernels::median_blur(origin(padded_, r_ + x0, r_ + y0), padded_.step,
+                           dst_.ptr(y0) + x0, dst_.step, width, height, r_);
+    }
+  }
+
+private:
+  cv::Mat const& padded_;
+  cv::Mat & dst_;
+  int const r_;
+  int const tile_width_;
+  int const band_height_;
+  int const tile_cols_;
+};
+
+void median_blur(cv::Mat const& src, cv::Mat & dst, int ksize)
+{
+  CV_Assert(src.type() == CV_8UC1 && ksize % 2 == 1 && ksize / 2 <= kernels::MEDIAN_MAX_RADIUS);
+  int const r = ksize / 2;
+  cv::Mat const padded = pad(src, r, r, r, r, cv::BORDER_REPLICATE);
+  dst.create(src.size(), CV_8UC1);
+  MedianTiles const tiles(padded, dst, r);
+  cv::parallel_for_(cv::Range(0, tiles.count()), tiles);
+}
+
+
+// rows [row0, row1] of a structuring element sharing the run of ones [col0, col1)
+struct StrelRun
+{
+  int row0;
+  int row1;
+  int col0;
+  int col1;
+};
+
+static bool by_columns(StrelRun const& a, StrelRun const& b)
+{
+  return a.col0 != b.col0 ? a.col0 < b.col0 : a.col1 < b.col1;
+}
+
+static bool strel_runs(cv::Mat const& strel, std::vector<StrelRun> & runs)
+{
+  CV_Assert(strel.type() == CV_8UC1);
+  runs.clear();
+  for (int i = 0; i < strel.rows; ++i)
+  {
+    uchar const* row = strel.ptr(i);
+    int c0 = 0;
+    while (c0 < strel.cols && !row[c0])
+      ++c0;
+    int c1 = c0;
+    while (c1 < strel.cols && row[c1])
+      ++c1;
+    for (int j = c1; j < strel.cols; ++j)
+      if (row[j])
+        return false;
+    if (c0 == c1)
+      continue;
+
+    if (!runs.empty() && runs.back().row1 == i - 1 && runs.back().col0 == c0 && runs.back().col1 == c1)
+    {
+      runs.back().row1 = i;
+    }
+    else
+    {
+      StrelRun const run = { i, i, c0, c1 };
+      runs.push_back(run);
+    }
+  }
+  return !runs.empty();
+}
+
+bool is_row_convex(cv::Mat const& strel)
+{
+  std::vector<StrelRun> runs;
+  return strel_runs(strel, runs);
+}
+
+// extremum over the strel offsets: for every run, a horizontal pass over its columns
+// (shared between runs with the same columns) followed by a vertical pass over its rows
+static void minmax_2d(cv::Mat const& src, cv::Mat & dst, cv::Mat const& strel, bool is_max)
+{
+  CV_Assert(src.type() == CV_8UC1);
+  std::vector<StrelRun> runs;
+  if (!strel_runs(strel, runs))
+    CV_Error(CV_StsBadArg, "structuring element must be non-empty and row-convex");
+  // runs with the same columns (e.g. mirrored rows of an ellipse) become neighbours
+  std::sort(runs.begin(), runs.end(), by_columns);
+
+  // border value that never wins, as the defaults of cv::erode / cv::dilate
+  int const ax = strel.cols / 2;
+  int const ay = strel.rows / 2;
+  cv::Mat const padded = pad(src, ax, ay, strel.cols - 1 - ax, strel.rows - 1 - ay,
+                             cv::BORDER_CONSTANT, cv::Scalar::all(is_max ? 0 : 255));
+
+  // src is only read through padded, so dst may alias it
+  dst.create(src.size(), CV_8UC1);
+  cv::Mat horizontal(padded.rows, src.cols, CV_8UC1);
+  cv::Mat vertical(src.size(), CV_8UC1);
+  int horizontal_col0 = -1;
+  int horizontal_col1 = -1;
+  for (size_t r = 0; r < runs.size(); ++r)
+  {
+    StrelRun const& run = runs[r];
+    if (run.col0 != horizontal_col0 || run.col1 != horizontal_col1)
+    {
+      kernels::minmax_h(padded.ptr() + run.col0, padded.step, horizontal.data, horizontal.step,
+                        src.cols, padded.rows, run.col1 - run.col0, is_max);
+      horizontal_col0 = run.col0;
+      horizontal_col1 = run.col1;
+    }
+    cv::Mat & out = r == 0 ? dst : vertical;
+    kernels::minmax_v(horizontal.ptr(run.row0), horizontal.step, out.data, out.step,
+                      src.cols, src.rows, run.row1 - run.row0 + 1, is_max);
+    if (r > 0)
+    {
+      if (is_max)
+        cv::max(dst, vertical, dst);
+      else
+        cv::min(dst, vertical, dst);
+    }
+  }
+}
+
+void erode(cv::Mat const& src, cv::Mat & dst, cv::Mat const& strel)
+{
+  minmax_2d(src, dst, strel, false);
+}
+
+void dilate(cv::Mat const& src, cv::Mat & dst, cv::Mat const& strel)
+{
+  minmax_2d(src, dst, strel, true);
+}
+
+void morphology(cv::Mat const& src, cv::Mat & dst, int op, cv::Mat const& strel)
+{
+  cv::Mat tmp;
+  switch (op)
+  {
+  case cv::MORPH_ERODE:
+    erode(src, dst, strel);
+    break;
+  case cv::MORPH_DILATE:
+    dilate(src, dst, strel);
+    break;
+  case cv::MORPH_OPEN:
+    erode(src, tmp, strel);
+    dilate(tmp, dst, strel);
+    break;
+  case cv::MORPH_CLOSE:
+    dilate(src, tmp, strel);
+    erode(tmp, dst, strel);
+    break;
+  case cv::MORPH_GRADIENT:
+    erode(src, tmp, strel);
+    dilate(src, dst, strel);
+    cv::subtract(dst, tmp, dst);
+    break;
+  case cv::MORPH_TOPHAT:
+    morphology(src, tmp, cv::MORPH_OPEN, strel);
+    cv::subtract(src, tmp, dst);
+    break;
+  case cv::MORPH_BLACKHAT:
+    morphology(src, tmp, cv::MORPH_CLOSE, strel);
+    cv::subtract(tmp, src, dst);
+    break;
+  default:
+    CV_Error(CV_StsBadArg, "unknown morphology operation");
+  }
+}
+
+
+void morphology_bundle(cv::Mat const& src, cv::Mat const& strel, int outputs, MorphBundle & bundle)
+{
+  CV_Assert(src.type() == CV_8UC1 && (outputs & ~MORPH_OUT_ALL) == 0);
+  bool const need_dilated = (outputs & (MORPH_OUT_DILATE | MORPH_OUT_GRADIENT |
+                                        MORPH_OUT_CLOSE | MORPH_OUT_BLACKHAT)) != 0;
+  bool const need_eroded = (outputs & (MORPH_OUT_ERODE | MORPH_OUT_GRADIENT |
+                                       MORPH_OUT_OPEN | MORPH_OUT_TOPHAT)) != 0;
+  bool const need_opened = (outputs & (MORPH_OUT_OPEN | MORPH_OUT_TOPHAT)) != 0;
+  bool const need_closed = (outputs & (MORPH_OUT_CLOSE | MORPH_OUT_BLACKHAT)) != 0;
+
+  // intermediates go to the bundle fields when requested, to locals otherwise
+  cv::Mat dilated_tmp, eroded_tmp, opened_tmp, closed_tmp;
+  cv::Mat & dilated = outputs & MORPH_OUT_DILATE ? bundle.dilated : dilated_tmp;
+  cv::Mat & eroded = outputs & MORPH_OUT_ERODE ? bundle.eroded : eroded_tmp;
+  cv::Mat & opened = outputs & MORPH_OUT_OPEN ? bundle.opened : opened_tmp;
+  cv::Mat & closed = outputs & MORPH_OUT_CLOSE ? bundle.closed : closed_tmp;
+
+  if (need_dilated)
+    dilate(src, dilated, strel);
+  if (need_eroded)
+    erode(src, eroded, strel);
+  if (need_opened)
+    dilate(eroded, opened, strel);
+  if (need_closed)
+    erode(dilated, closed, strel);
+
+  if (outputs & MORPH_OUT_GRADIENT)
+    cv::subtract(dilated, eroded, bundle.gradient);
+  if (outputs & MORPH_OUT_TOPHAT)
+    cv::subtract(src, opened, bundle.tophat);
+  if (outputs & MORPH_OUT_BLACKHAT)
+    cv::subtract(closed, src, bundle.blackhat);
+}
+
+}}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+
+// In-project implementations of the demo_filters operations, for 8-bit
+// single-channel images. Results match the OpenCV counterparts named below up
+// to rounding of the fixed-point arithmetic.
+
+namespace rsdt { namespace filters {
+
+// running-sum box filter, as cv::blur with BORDER_REFLECT_101; cost independent of ksize
+void box_blur(cv::Mat const& src, cv::Mat & dst, cv::Size const& ksize);
+
+// separable Gaussian with Q8 coefficients, as cv::GaussianBlur with BORDER_REFLECT_101
+void gaussian_blur(cv::Mat const& src, cv::Mat & dst, cv::Size const& ksize,
+                   double sigma_x, double sigma_y = 0);
+
+// histogram-based median (Perreault-Hebert), as cv::medianBlur; cost independent of ksize.
+// Runs in parallel over cache-sized tiles; ksize up to 255
+void median_blur(cv::Mat const& src, cv::Mat & dst, int ksize);
+
+struct BilateralGridSettings
+{
+  double sigma_space;      // pixels
+  double sigma_range;      // grey levels
+  double cells_per_sigma;  // grid resolution; 1 is the usual coarse grid, 2 and more come closer to exact
+
+  BilateralGridSettings(double space = 4, double range = 30, double cells = 1)
+  : sigma_space(space),
+    sigma_range(range),
+    cells_per_sigma(cells)
+  { }
+};
+
+// approximate Gaussian bilateral filter on a bilateral grid, for 8-bit grey and BGR images,
+// comparable to cv::bilateralFilter(src, dst, d, sigma_range, sigma_space) with d about 4 sigma_space.
+// Cost is linear in the pixel count plus the grid size, which shrinks with growing sigmas.
+// Colour images are smoothed across edges of their grey level.
+void bilateral_grid(cv::Mat const& src, cv::Mat & dst, BilateralGridSettings const& settings);
+
+// true if every row of the structuring element is a single run of ones
+// (rectangle, cross and ellipse of cv::getStructuringElement are)
+bool is_row_convex(cv::Mat const& strel);
+
+// van Herk / Gil-Werman erosion and dilation, as cv::erode / cv::dilate with the default
+// border; cost per pixel depends on the number of distinct row runs of strel, not its size.
+// strel must be row-convex.
+void erode(cv::Mat const& src, cv::Mat & dst, cv::Mat const& strel);
+void dilate(cv::Mat const& src, cv::Mat & dst, cv::Mat const& strel);
+
+// op is one of cv::MORPH_*, as cv::morphologyEx
+void morphology(cv::Mat const& src, cv::Mat & dst, int op, cv::Mat const& strel);
+
+// outputs of morphology_bundle, combined with '|'
+enum MorphOutput
+{
+  MORPH_OUT_DILATE   = 1 << 0,
+  MORPH_OUT_ERODE    = 1 << 1,
+  MORPH_OUT_OPEN     = 1 << 2,
+  MORPH_OUT_CLOSE    = 1 << 3,
+  MORPH_OUT_GRADIENT = 1 << 4,
+  MORPH_OUT_TOPHAT   = 1 << 5,
+  MORPH_OUT_BLACKHAT = 1 << 6,
+  MORPH_OUT_ALL      = (1 << 7) - 1
+};
+
+// results of morphology_bundle; fields not requested are left untouched
+struct MorphBundle
+{
+  cv::Mat dilated;
+  cv::Mat eroded;
+  cv::Mat opened;
+  cv::Mat closed;
+  cv::Mat gradient;
+  cv::Mat tophat;
+  cv::Mat blackhat;
+};
+
+// the requested members of the morphology family, sharing intermediates: at most one
+// dilation and one erosion of src plus one dilation of the erosion (open, tophat) and one
+// erosion of the dilation (close, blackhat), i.e. 4 min/max passes instead of 12 for
+// separate morphology calls. Each output matches morphology() with the corresponding op.
+// src must not share data with the bundle fields.
+void morphology_bundle(cv::Mat const& src, cv::Mat const& strel, int outputs, MorphBundle & bundle);
+
+}}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+// Raw 8-bit single-channel kernels behind filters.h. They do no border
+// handling: src points to the first output pixel of an image that is readable
+// the stated number of pixels beyond the output area, steps are in bytes.
+
+namespace rsdt { namespace filters { namespace kernels {
+
+// normalized (2rx+1) x (2ry+1) box filter by running sums; src readable rx / ry beyond each edge
+void box_blur(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int rx, int ry);
+
+// separable filter with non-negative Q8 coefficients (each set sums to 256);
+// src readable (kx_size - 1) / 2 and (ky_size - 1) / 2 beyond each edge
+void sep_filter_q8(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+                   int width, int height,
+                   int const* kx, int kx_size, int const* ky, int ky_size);
+
+// (2r+1) x (2r+1) median from per-column two-level histograms (Perreault-Hebert),
+// constant time per pixel in r; src readable r beyond each edge, r <= MEDIAN_MAX_RADIUS.
+// Memory is proportional to width + 2r, so large images should be passed in
+// column tiles of median_tile_width(r).
+int const MEDIAN_MAX_RADIUS = 127;
+void median_blur(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+                 int width, int height, int r);
+
+// output width of a median_blur tile whose column histograms fit in a typical L2 cache
+int median_tile_width(int r);
+
+// dst(x, y) = max (or min) of src(x .. x + k - 1, y) by van Herk / Gil-Werman;
+// src readable k - 1 beyond the right edge
+void minmax_h(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int k, bool is_max);
+
+// dst(x, y) = max (or min) of src(x, y .. y + k - 1) by van Herk / Gil-Werman,
+// whole rows at a time; src readable k - 1 beyond the bottom edge
+void minmax_v(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int k, bool is_max);
+
+}}}
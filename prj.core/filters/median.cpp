@@ -0,0 +1,114 @@
+#include <vector>
+#include <algorithm>
+#include "kernels.h"
+#include "simd.h"
+
+
+namespace rsdt { namespace filters { namespace kernels {
+
+// Two-level histograms: 16 coarse bins (value >> 4) and 16 x 16 fine bins.
+// Column histograms cover the k rows of the current output row; the kernel
+// histogram keeps its coarse part exact while sliding right, and brings a fine
+// segment up to date only when the median falls into it.
+
+static int const COARSE_BINS = 16;
+static int const FINE_BINS = 256;
+// bytes of column histograms per padded column
+static int const COLUMN_BYTES = (COARSE_BINS + FINE_BINS) * sizeof(uint16_t);
+static int const L2_BUDGET = 256 * 1024;
+
+int median_tile_width(int r)
+{
+  return std::max(64, L2_BUDGET / COLUMN_BYTES - 2 * r);
+}
+
+static inline void add_pixel(uint16_t * coarse, uint16_t * fine, uint8_t v)
+{
+  ++coarse[v >> 4];
+  ++fine[v];
+}
+
+static inline void remove_pixel(uint16_t * coarse, uint16_t * fine, uint8_t v)
+{
+  --coarse[v >> 4];
+  --fine[v];
+}
+
+void median_blur(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+                 int width, int height, int r)
+{
+  int const k = 2 * r + 1;
+  int const padded_width = width + 2 * r;
+  int const rank = k * k / 2;
+  uint8_t const* const top = src - r * src_step - r;
+
+  std::vector<uint16_t> col_coarse(padded_width * COARSE_BINS, 0);
+  std::vector<uint16_t> col_fine(padded_width * FINE_BINS, 0);
+  for (int i = 0; i < k - 1; ++i)
+  {
+    uint8_t const* row = top + i * src_step;
+    for (int x = 0; x < padded_width; ++x)
+      add_pixel(&col_coarse[x * COARSE_BINS], &col_fine[x * FINE_BINS], row[x]);
+  }
+
+  uint16_t coarse[COARSE_BINS];
+  uint16_t fine[FINE_BINS];
+  // window position at which each fine segment was last brought up to date
+  int fine_at[COARSE_BINS];
+
+  for (int y = 0; y < height; ++y)
+  {
+    // column x enters the window with its bottom pixel added and, below the first row,
+    // the pixel that left at the top removed
+    uint8_t const* removed = y > 0 ? top + (y - 1) * src_step : 0;
+    uint8_t const* added = top + (y + k - 1) * src_step;
+    std::fill(coarse, coarse + COARSE_BINS, 0);
+    for (int x = 0; x < k; ++x)
+    {
+      if (removed)
+        remove_pixel(&col_coarse[x * COARSE_BINS], &col_fine[x * FINE_BINS], removed[x]);
+      add_pixel(&col_coarse[x * COARSE_BINS], &col_fine[x * FINE_BINS], added[x]);
+      simd::add_u16x16(coarse, &col_coarse[x * COARSE_BINS]);
+    }
+    std::fill(fine_at, fine_at + COARSE_BINS, -k);
+
+    uint8_t * d = dst + y * dst_step;
+    for (int x = 0; ; ++x)
+    {
+      int c = 0;
+      int count = 0;
+      while (count + coarse[c] <= rank)
+        count += coarse[c++];
+
+      uint16_t * seg = fine + c * 16;
+      if (x - fine_at[c] >= k)
+      {
+        std::fill(seg, seg + 16, 0);
+        for (int j = x; j < x + k; ++j)
+          simd::add_u16x16(seg, &col_fine[j * FINE_BINS + c * 16]);
+      }
+      else
+      {
+        for (int j = fine_at[c]; j < x; ++j)
+          simd::add_sub_u16x16(seg, &col_fine[(j + k) * FINE_BINS + c * 16], &col_fine[j * FINE_BINS + c * 16]);
+      }
+      fine_at[c] = x;
+
+      int f = 0;
+      while (count + seg[f] <= rank)
+        count += seg[f++];
+      d[x] = static_cast<uint8_t>(c * 16 + f);
+
+      if (x + 1 == width)
+        break;
+
+      int const in = x + k;
+      if (removed)
+        remove_pixel(&col_coarse[in * COARSE_BINS], &col_fine[in * FINE_BINS], removed[in]);
+      add_pixel(&col_coarse[in * COARSE_BINS], &col_fine[in * FINE_BINS], added[in]);
+      simd::add_sub_u16x16(coarse, &col_coarse[in * COARSE_BINS], &col_coarse[x * COARSE_BINS]);
+    }
+  }
+}
+
+}}}
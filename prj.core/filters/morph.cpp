@@ -0,0 +1,100 @@
+#include <vector>
+#include <cstring>
+#include "kernels.h"
+#include "simd.h"
+
+
+namespace rsdt { namespace filters { namespace kernels {
+
+struct MaxOp
+{
+  static uint8_t apply(uint8_t a, uint8_t b) { return a > b ? a : b; }
+};
+
+struct MinOp
+{
+  static uint8_t apply(uint8_t a, uint8_t b) { return a < b ? a : b; }
+};
+
+static inline void pick_rows(uint8_t const* a, uint8_t const* b, uint8_t * dst, int n, bool is_max)
+{
+  if (is_max)
+    simd::max_u8(a, b, dst, n);
+  else
+    simd::min_u8(a, b, dst, n);
+}
+
+
+template <typename Op>
+static void minmax_h_impl(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+                          int width, int height, int k)
+{
+  int const n = width + k - 1;
+  // running extremum from the start (prefix) and to the end (suffix) of each block of k pixels
+  std::vector<uint8_t> prefix(n);
+  std::vector<uint8_t> suffix(n);
+  for (int y = 0; y < height; ++y)
+  {
+    uint8_t const* s = src + y * src_step;
+    for (int b0 = 0; b0 < n; b0 += k)
+    {
+      int const b1 = b0 + k < n ? b0 + k : n;
+      prefix[b0] = s[b0];
+      for (int i = b0 + 1; i < b1; ++i)
+        prefix[i] = Op::apply(prefix[i - 1], s[i]);
+      suffix[b1 - 1] = s[b1 - 1];
+      for (int i = b1 - 2; i >= b0; --i)
+        suffix[i] = Op::apply(suffix[i + 1], s[i]);
+    }
+
+    // the window [x, x + k - 1] is the tail of one block and the head of the next
+    uint8_t * d = dst + y * dst_step;
+    for (int x = 0; x < width; ++x)
+      d[x] = Op::apply(suffix[x], prefix[x + k - 1]);
+  }
+}
+
+void minmax_h(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int k, bool is_max)
+{
+  if (is_max)
+    minmax_h_impl<MaxOp>(src, src_step, dst, dst_step, width, height, k);
+  else
+    minmax_h_impl<MinOp>(src, src_step, dst, dst_step, width, height, k);
+}
+
+
+void minmax_v(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+              int width, int height, int k, bool is_max)
+{
+  if (k == 1)
+  {
+    for (int y = 0; y < height; ++y)
+      memcpy(dst + y * dst_step, src + y * src_step, width);
+    return;
+  }
+
+  // suffix extrema of the current block of k rows and the prefix extremum of the next one
+  std::vector<uint8_t> suffix(k * width);
+  std::vector<uint8_t> prefix(width);
+  for (int b = 0; b < height; b += k)
+  {
+    // every output row needs the k input rows starting there, so [b, b + k) is complete
+    memcpy(&suffix[(k - 1) * width], src + (b + k - 1) * src_step, width);
+    for (int i = k - 2; i >= 0; --i)
+      pick_rows(&suffix[(i + 1) * width], src + (b + i) * src_step, &suffix[i * width], width, is_max);
+
+    memcpy(dst + b * dst_step, &suffix[0], width);
+    for (int y = b + 1; y < b + k && y < height; ++y)
+    {
+      uint8_t const* last = src + (y + k - 1) * src_step;
+      if (y == b + 1)
+        memcpy(&prefix[0], last, width);
+      else
+        pick_rows(&prefix[0], last, &prefix[0], width, is_max);
+      pick_rows(&suffix[(y - b) * width], &prefix[0], dst + y * dst_step, width, is_max);
+    }
+  }
+}
+
+}}}
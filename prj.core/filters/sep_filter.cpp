@@ -0,0 +1,115 @@
+#include <vector>
+#include "kernels.h"
+#include "simd.h"
+
+
+namespace rsdt { namespace filters { namespace kernels {
+
+// inter(x) = sum kx[i] * src(x + i); fits 16 bits for Q8 coefficients summing to 256
+static void filter_row_q8(uint8_t const* src, uint16_t * inter, int width, int const* kx, int kx_size)
+{
+  int x = 0;
+#if defined(RSDT_FILTERS_SSE2)
+  __m128i const z = _mm_setzero_si128();
+  for (; x + 8 <= width; x += 8)
+  {
+    __m128i acc = z;
+    for (int i = 0; i < kx_size; ++i)
+    {
+      __m128i const p = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + x + i)), z);
+      acc = _mm_add_epi16(acc, _mm_mullo_epi16(p, _mm_set1_epi16(static_cast<short>(kx[i]))));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(inter + x), acc);
+  }
+#elif defined(RSDT_FILTERS_NEON)
+  for (; x + 8 <= width; x += 8)
+  {
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (int i = 0; i < kx_size; ++i)
+      acc = vmlaq_u16(acc, vmovl_u8(vld1_u8(src + x + i)), vdupq_n_u16(static_cast<uint16_t>(kx[i])));
+    vst1q_u16(inter + x, acc);
+  }
+#endif
+  for (; x < width; ++x)
+  {
+    int acc = 0;
+    for (int i = 0; i < kx_size; ++i)
+      acc += kx[i] * src[x + i];
+    inter[x] = static_cast<uint16_t>(acc);
+  }
+}
+
+// dst(x) = round(sum ky[j] * rows[j][x] / 2^16)
+static void filter_column_q8(uint16_t const* const* rows, uint8_t * dst, int width, int const* ky, int ky_size)
+{
+  int x = 0;
+#if defined(RSDT_FILTERS_SSE2)
+  __m128i const z = _mm_setzero_si128();
+  __m128i const half = _mm_set1_epi32(1 << 15);
+  for (; x + 8 <= width; x += 8)
+  {
+    __m128i lo = half;
+    __m128i hi = half;
+    for (int j = 0; j < ky_size; ++j)
+    {
+      __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[j] + x));
+      __m128i const k = _mm_set1_epi16(static_cast<short>(ky[j]));
+      __m128i const pl = _mm_mullo_epi16(v, k);
+      __m128i const ph = _mm_mulhi_epu16(v, k);
+      lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(pl, ph));
+      hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(pl, ph));
+    }
+    __m128i const r = _mm_packs_epi32(_mm_srli_epi32(lo, 16), _mm_srli_epi32(hi, 16));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(r, z));
+  }
+#elif defined(RSDT_FILTERS_NEON)
+  for (; x + 8 <= width; x += 8)
+  {
+    uint32x4_t lo = vdupq_n_u32(1 << 15);
+    uint32x4_t hi = vdupq_n_u32(1 << 15);
+    for (int j = 0; j < ky_size; ++j)
+    {
+      uint16x8_t const v = vld1q_u16(rows[j] + x);
+      uint16x4_t const k = vdup_n_u16(static_cast<uint16_t>(ky[j]));
+      lo = vmlal_u16(lo, vget_low_u16(v), k);
+      hi = vmlal_u16(hi, vget_high_u16(v), k);
+    }
+    uint16x8_t const r = vcombine_u16(vshrn_n_u32(lo, 16), vshrn_n_u32(hi, 16));
+    vst1_u8(dst + x, vqmovn_u16(r));
+  }
+#endif
+  for (; x < width; ++x)
+  {
+    uint32_t acc = 1 << 15;
+    for (int j = 0; j < ky_size; ++j)
+      acc += static_cast<uint32_t>(ky[j]) * rows[j][x];
+    dst[x] = static_cast<uint8_t>(acc >> 16);
+  }
+}
+
+
+void sep_filter_q8(uint8_t const* src, size_t src_step, uint8_t * dst, size_t dst_step,
+                   int width, int height,
+                   int const* kx, int kx_size, int const* ky, int ky_size)
+{
+  int const rx = (kx_size - 1) / 2;
+  int const ry = (ky_size - 1) / 2;
+  uint8_t const* const top = src - ry * src_step - rx;
+
+  // horizontally filtered rows in a ring of ky_size rows
+  std::vector<uint16_t> ring(ky_size * width);
+  std::vector<uint16_t const*> rows(ky_size);
+  for (int i = 0; i < ky_size - 1; ++i)
+    filter_row_q8(top + i * src_step, &ring[i * width], width, kx, kx_size);
+
+  for (int y = 0; y < height; ++y)
+  {
+    int const newest = y + ky_size - 1;
+    filter_row_q8(top + newest * src_step, &ring[(newest % ky_size) * width], width, kx, kx_size);
+    for (int j = 0; j < ky_size; ++j)
+      rows[j] = &ring[((y + j) % ky_size) * width];
+    filter_column_q8(&rows[0], dst + y * dst_step, width, ky, ky_size);
+  }
+}
+
+}}}
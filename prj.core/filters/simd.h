@@ -0,0 +1,120 @@
+#pragma once
+
+#include <stdint.h>
+
+// USE_SSE_SIMD / USE_NEON_SIMD come from compiler_definitions.cmake; the
+// intrinsics are only used when the target actually has the instruction set
+#if defined(USE_SSE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RSDT_FILTERS_SSE2
+#include <emmintrin.h>
+#elif defined(USE_NEON_SIMD) || defined(__ARM_NEON)
+#define RSDT_FILTERS_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace rsdt { namespace filters { namespace simd {
+
+// dst[i] = max(a[i], b[i]), i < n
+inline void max_u8(uint8_t const* a, uint8_t const* b, uint8_t * dst, int n)
+{
+  int i = 0;
+#if defined(RSDT_FILTERS_SSE2)
+  for (; i + 16 <= n; i += 16)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_max_epu8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i)),
+                                  _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i))));
+#elif defined(RSDT_FILTERS_NEON)
+  for (; i + 16 <= n; i += 16)
+    vst1q_u8(dst + i, vmaxq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+#endif
+  for (; i < n; ++i)
+    dst[i] = a[i] > b[i] ? a[i] : b[i];
+}
+
+// dst[i] = min(a[i], b[i]), i < n
+inline void min_u8(uint8_t const* a, uint8_t const* b, uint8_t * dst, int n)
+{
+  int i = 0;
+#if defined(RSDT_FILTERS_SSE2)
+  for (; i + 16 <= n; i += 16)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                     _mm_min_epu8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(a + i)),
+                                  _mm_loadu_si128(reinterpret_cast<__m128i const*>(b + i))));
+#elif defined(RSDT_FILTERS_NEON)
+  for (; i + 16 <= n; i += 16)
+    vst1q_u8(dst + i, vminq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+#endif
+  for (; i < n; ++i)
+    dst[i] = a[i] < b[i] ? a[i] : b[i];
+}
+
+// sum[i] += add[i] - sub[i], i < n
+inline void add_sub_u8_to_s32(int32_t * sum, uint8_t const* add, uint8_t const* sub, int n)
+{
+  int i = 0;
+#if defined(RSDT_FILTERS_SSE2)
+  __m128i const z = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(add + i));
+    __m128i const s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(sub + i));
+    __m128i const dlo = _mm_sub_epi16(_mm_unpacklo_epi8(a, z), _mm_unpacklo_epi8(s, z));
+    __m128i const dhi = _mm_sub_epi16(_mm_unpackhi_epi8(a, z), _mm_unpackhi_epi8(s, z));
+    __m128i * p = reinterpret_cast<__m128i *>(sum + i);
+    // sign extension of the 16-bit differences to 32 bits
+    _mm_storeu_si128(p + 0, _mm_add_epi32(_mm_loadu_si128(p + 0), _mm_srai_epi32(_mm_unpacklo_epi16(dlo, dlo), 16)));
+    _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), _mm_srai_epi32(_mm_unpackhi_epi16(dlo, dlo), 16)));
+    _mm_storeu_si128(p + 2, _mm_add_epi32(_mm_loadu_si128(p + 2), _mm_srai_epi32(_mm_unpacklo_epi16(dhi, dhi), 16)));
+    _mm_storeu_si128(p + 3, _mm_add_epi32(_mm_loadu_si128(p + 3), _mm_srai_epi32(_mm_unpackhi_epi16(dhi, dhi), 16)));
+  }
+#elif defined(RSDT_FILTERS_NEON)
+  for (; i + 8 <= n; i += 8)
+  {
+    int16x8_t const d = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(add + i), vld1_u8(sub + i)));
+    vst1q_s32(sum + i, vaddq_s32(vld1q_s32(sum + i), vmovl_s16(vget_low_s16(d))));
+    vst1q_s32(sum + i + 4, vaddq_s32(vld1q_s32(sum + i + 4), vmovl_s16(vget_high_s16(d))));
+  }
+#endif
+  for (; i < n; ++i)
+    sum[i] += add[i] - sub[i];
+}
+
+// h[i] += add[i] - sub[i], i < 16; a histogram of 16 bins in one step
+inline void add_sub_u16x16(uint16_t * h, uint16_t const* add, uint16_t const* sub)
+{
+#if defined(RSDT_FILTERS_SSE2)
+  __m128i * p = reinterpret_cast<__m128i *>(h);
+  __m128i const* a = reinterpret_cast<__m128i const*>(add);
+  __m128i const* s = reinterpret_cast<__m128i const*>(sub);
+  _mm_storeu_si128(p + 0, _mm_sub_epi16(_mm_add_epi16(_mm_loadu_si128(p + 0), _mm_loadu_si128(a + 0)),
+                                        _mm_loadu_si128(s + 0)));
+  _mm_storeu_si128(p + 1, _mm_sub_epi16(_mm_add_epi16(_mm_loadu_si128(p + 1), _mm_loadu_si128(a + 1)),
+                                        _mm_loadu_si128(s + 1)));
+#elif defined(RSDT_FILTERS_NEON)
+  vst1q_u16(h + 0, vsubq_u16(vaddq_u16(vld1q_u16(h + 0), vld1q_u16(add + 0)), vld1q_u16(sub + 0)));
+  vst1q_u16(h + 8, vsubq_u16(vaddq_u16(vld1q_u16(h + 8), vld1q_u16(add + 8)), vld1q_u16(sub + 8)));
+#else
+  for (int i = 0; i < 16; ++i)
+    h[i] = static_cast<uint16_t>(h[i] + add[i] - sub[i]);
+#endif
+}
+
+// h[i] += add[i], i < 16
+inline void add_u16x16(uint16_t * h, uint16_t const* add)
+{
+#if defined(RSDT_FILTERS_SSE2)
+  __m128i * p = reinterpret_cast<__m128i *>(h);
+  __m128i const* a = reinterpret_cast<__m128i const*>(add);
+  _mm_storeu_si128(p + 0, _mm_add_epi16(_mm_loadu_si128(p + 0), _mm_loadu_si128(a + 0)));
+  _mm_storeu_si128(p + 1, _mm_add_epi16(_mm_loadu_si128(p + 1), _mm_loadu_si128(a + 1)));
+#elif defined(RSDT_FILTERS_NEON)
+  vst1q_u16(h + 0, vaddq_u16(vld1q_u16(h + 0), vld1q_u16(add + 0)));
+  vst1q_u16(h + 8, vaddq_u16(vld1q_u16(h + 8), vld1q_u16(add + 8)));
+#else
+  for (int i = 0; i < 16; ++i)
+    h[i] = static_cast<uint16_t>(h[i] + add[i]);
+#endif
+}
+
+}}}
@@ -1,11 +1,16 @@
 #include <cstdio>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <stdexcept>
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/calib3d/calib3d.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include "undistort.h"
+#include "view_selection.h"
+#include "calibration_session.h"
 
 
 using std::string;
@@ -13,9 +18,211 @@ using std::vector;
 using cv::Mat;
 using cv::Point2f;
 using cv::Point3f;
+using rsdt::calib3d::UndistortMap;
+using rsdt::calib3d::ViewSelector;
+using rsdt::calib3d::CalibrationSession;
 
 
-int main()
+static cv::Size const BOARD_SIZE(9, 6);
+static double const SQUARE_SIZE = 1.0;
+
+
+// intrinsics and undistortion maps written by calibration, read by the undistort mode
+static char const* const UNDISTORT_MAP_PATH = "_camera.undistmap";
+
+// chessboard search runs on a copy downscaled to this size of the longer side,
+// 0 to search at full resolution without the fast check
+static int const DETECT_MAX_SIDE = 640;
+
+
+static void refine_corners(Mat const& gray, vector<Point2f> & pts, int half_win)
+{
+  cv::cornerSubPix(gray, pts, cv::Size(half_win, half_win),
+      cv::Size(-1,-1), cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
+}
+
+// Coarse-to-fine chessboard detection: CALIB_CB_FAST_CHECK on a downscaled copy
+// rejects images without a board in milliseconds; found corners are scaled
+// back and refined with cornerSubPix on the full-resolution image.
+static bool find_corners_coarse_to_fine(Mat const& gray, cv::Size const& board_size,
+                                        vector<Point2f> & pts, int max_side)
+{
+  double const scale = std::min(1.0, static_cast<double>(max_side) / std::max(gray.cols, gray.rows));
+  Mat small;
+  if (scale < 1.0)
+    cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+  else
+    small = gray;
+
+  int const flags = cv::CALIB_CB_ADAPTIVE_THRESH + cv::CALIB_CB_NORMALIZE_IMAGE + cv::CALIB_CB_FAST_CHECK;
+  if (!cv::findChessboardCorners(small, board_size, pts, flags))
+    return false;
+
+  for (size_t i = 0; i < pts.size(); ++i)
+  {
+    // pixel centers: x_full + 0.5 = (x_small + 0.5) / scale
+    pts[i].x = static_cast<float>((pts[i].x + 0.5) / scale - 0.5);
+    pts[i].y = static_cast<float>((pts[i].y + 0.5) / scale - 0.5);
+  }
+  // the search window must cover the coarse localisation error of about 1 / scale pixels
+  refine_corners(gray, pts, std::max(11, cvCeil(2.0 / scale)));
+  return true;
+}
+
+
+// a calibration image or video frame, decoded once and kept for the undistortion pass
+struct CalibImage
+{
+  string name;
+  Mat src;
+  vector<Point2f> pattern_pts;
+  bool found;
+
+  CalibImage()
+  : found(false)
+  { }
+};
+
+
+// reads images not decoded yet and detects chessboard corners; each image is
+// independent, so the results are the same whatever the order in which they are processed
+class DetectCorners : public cv::ParallelLoopBody
+{
+public:
+  DetectCorners(vector<CalibImage> & images, cv::Size const& board_size, bool save_corners)
+  : images_(images),
+    board_size_(board_size),
+    save_corners_(save_corners)
+  { }
+
+  virtual void operator()(cv::Range const& range) const
+  {
+    for (int i = range.start; i < range.end; ++i)
+      detect(images_[i]);
+  }
+
+private:
+  void detect(CalibImage & img) const
+  {
+    if (img.src.empty())
+      img.src = cv::imread(img.name + ".jpg", CV_LOAD_IMAGE_COLOR);
+    if (img.src.empty())
+      return;
+
+    Mat src_gray;
+    cv::cvtColor(img.src, src_gray, CV_BGR2GRAY);
+    if (DETECT_MAX_SIDE > 0)
+    {
+      img.found = find_corners_coarse_to_fine(src_gray, board_size_, img.pattern_pts, DETECT_MAX_SIDE);
+    }
+    else
+    {
+      img.found = cv::findChessboardCorners(img.src, board_size_, img.pattern_pts);
+      if (img.found)
+        refine_corners(src_gray, img.pattern_pts, 11);
+    }
+    if (!img.found || !save_corners_)
+      return;
+
+    Mat dst;
+    cv::cvtColor(src_gray, dst, CV_GRAY2BGR);
+    cv::drawChessboardCorners(dst, board_size_, Mat(img.pattern_pts), img.found);
+    cv::imwrite("_" + img.name + ".corners.jpg", dst);
+  }
+
+  vector<CalibImage> & images_;
+  cv::Size board_size_;
+  bool save_corners_;
+};
+
+
+// builds the undistortion maps and saves them for later runs
+static UndistortMap save_calibration(Mat const& camera_matrix, Mat const& dist_coeffs,
+                                     cv::Size const& src_size)
+{
+  UndistortMap const map = rsdt::calib3d::create_undistort_map(camera_matrix, dist_coeffs, src_size);
+  rsdt::calib3d::save_undistort_map(UNDISTORT_MAP_PATH, map);
+  printf("Undistortion map saved to %s\n", UNDISTORT_MAP_PATH);
+  return map;
+}
+
+// calibrates from the views and saves the undistortion maps
+static UndistortMap calibrate(vector<vector<Point2f> > const& pts_by_img, cv::Size const& src_size)
+{
+  vector<Point3f> corners3d;
+  for (int y = 0; y < BOARD_SIZE.height; ++y)
+      for (int x = 0; x < BOARD_SIZE.width; ++x)
+          corners3d.push_back(Point3f(x * SQUARE_SIZE, y * SQUARE_SIZE, 0));
+  vector<vector<Point3f> > corners3d_by_img(pts_by_img.size(), corners3d);
+
+  Mat camera_matrix = Mat::eye(3, 3, CV_64F);
+  Mat dist_coeffs = Mat::zeros(8, 1, CV_64F);
+  vector<Mat> rvecs;
+  vector<Mat> tvecs;
+  double rms = cv::calibrateCamera(corners3d_by_img, pts_by_img, src_size, camera_matrix,
+                                   dist_coeffs, rvecs, tvecs, CV_CALIB_FIX_K4);
+  printf("Calibration RMS error %.4f from %d views\n", rms, static_cast<int>(pts_by_img.size()));
+
+  return save_calibration(camera_matrix, dist_coeffs, src_size);
+}
+
+
+static string base_name(string const& path)
+{
+  size_t const slash = path.find_last_of("/\\");
+  string name = slash == string::npos ? path : path.substr(slash + 1);
+  size_t const dot = name.find_last_of('.');
+  return dot == string::npos ? name : name.substr(0, dot);
+}
+
+// undistorts stills to _<name>.undist.jpg and videos to _<name>.undist.avi
+static void undistort_input(string const& path, UndistortMap const& map)
+{
+  string const name = base_name(path);
+  Mat undist;
+
+  Mat const img = cv::imread(path, CV_LOAD_IMAGE_UNCHANGED);
+  if (!img.empty())
+  {
+    printf("Correcting %s\n", path.c_str());
+    rsdt::calib3d::undistort(img, undist, map);
+    cv::imwrite("_" + name + ".undist.jpg", undist);
+    return;
+  }
+
+  cv::VideoCapture cap(path);
+  if (!cap.isOpened())
+    throw std::runtime_error("Unable to open " + path);
+  double fps = cap.get(CV_CAP_PROP_FPS);
+  if (fps <= 0)
+    fps = 25;
+  cv::VideoWriter writer;
+  Mat frame;
+  int frames = 0;
+  while (cap.read(frame))
+  {
+    rsdt::calib3d::undistort(frame, undist, map);
+    if (!writer.isOpened() && !writer.open("_" + name + ".undist.avi", CV_FOURCC('M','J','P','G'),
+                                           fps, map.image_size, frame.channels() == 3))
+      throw std::runtime_error("Unable to create output video for " + path);
+    writer << undist;
+    ++frames;
+  }
+  printf("Corrected %d frames of %s\n", frames, path.c_str());
+}
+
+// usage: calib3d undistort [input ...]
+// applies the maps saved by a calibration run to arbitrary images and videos
+static int run_undistort(vector<string> const& inputs)
+{
+  UndistortMap const map = rsdt::calib3d::load_undistort_map(UNDISTORT_MAP_PATH);
+  for (size_t i = 0; i < inputs.size(); ++i)
+    undistort_input(inputs[i], map);
+  return 0;
+}
+
+
+static int run_calibration()
 {
   vector<string> filenames;
   {
@@ -34,40 +241,31 @@ int main()
     filenames.push_back("right14");
   }
 
-  cv::Size const board_size(9, 6);
-  double const square_size = 1.0;
-
-  Mat camera_matrix;
-  Mat dist_coeffs;
   vector<vector<Point2f> > pts_by_img;
 
-  cv::Size src_size;
+  vector<CalibImage> images(filenames.size());
   for (size_t i = 0; i < filenames.size(); ++i)
-  {
-    string const& fn = filenames[i];
-    printf("Processing %s\n", fn.c_str());
+    images[i].name = filenames[i];
+  cv::parallel_for_(cv::Range(0, static_cast<int>(images.size())), DetectCorners(images, BOARD_SIZE, true));
 
-    Mat src = cv::imread(fn + ".jpg", CV_LOAD_IMAGE_COLOR);
-    src_size = src.size();
-    vector<Point2f> pattern_pts;
-    bool const found = cv::findChessboardCorners(src, board_size, pattern_pts);
-    if (!found)
+  // reported and collected in file order, independent of the thread schedule
+  cv::Size src_size;
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    CalibImage const& img = images[i];
+    printf("Processing %s\n", img.name.c_str());
+    if (img.src.empty())
     {
-      printf("Corners not found for %s\n", fn.c_str());
+      printf("Unable to read %s\n", img.name.c_str());
       continue;
     }
-      
-    Mat src_gray;
-    cv::cvtColor(src, src_gray, CV_BGR2GRAY);
-    cv::cornerSubPix(src_gray, pattern_pts, cv::Size(11,11),
-        cv::Size(-1,-1), cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, 0.1));
-
-    Mat dst;
-    cv::cvtColor(src_gray, dst, CV_GRAY2BGR);
-    cv::drawChessboardCorners(dst, board_size, Mat(pattern_pts), found);
-    cv::imwrite("_" + fn + ".corners.jpg", dst);
-
-    pts_by_img.push_back(pattern_pts);
+    src_size = img.src.size();
+    if (!img.found)
+    {
+      printf("Corners not found for %s\n", img.name.c_str());
+      continue;
+    }
+    pts_by_img.push_back(img.pattern_pts);
   }
 
   if (pts_by_img.empty())
@@ -77,37 +275,204 @@ int main()
   }
 
 
-  vector<Point3f> corners3d;
-  for (int y = 0; y < board_size.height; ++y)
-      for (int x = 0; x < board_size.width; ++x)
-          corners3d.push_back(Point3f(x * square_size, y * square_size, 0));
-  vector<vector<Point3f> > corners3d_by_img(pts_by_img.size(), corners3d);
+  UndistortMap const map = calibrate(pts_by_img, src_size);
 
-  camera_matrix = Mat::eye(3, 3, CV_64F);
-  dist_coeffs = Mat::zeros(8, 1, CV_64F);
-  vector<Mat> rvecs;
-  vector<Mat> tvecs;
-  double rms = cv::calibrateCamera(corners3d_by_img, pts_by_img, src_size, camera_matrix,
-                                   dist_coeffs, rvecs, tvecs, CV_CALIB_FIX_K4);
 
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    CalibImage const& img = images[i];
+    if (img.src.empty())
+      continue;
+    printf("Correcting %s\n", img.name.c_str());
 
-  Mat map1;
-  Mat map2;
-  cv::initUndistortRectifyMap(camera_matrix, dist_coeffs, Mat(),
-      cv::getOptimalNewCameraMatrix(camera_matrix, dist_coeffs, src_size, 1, src_size, 0),
-      src_size, CV_16SC2, map1, map2);
+    Mat undist;
+    rsdt::calib3d::undistort(img.src, undist, map);
+    cv::imwrite("_" + img.name + ".undist.jpg", undist);
+  }
 
+  return 0;
+}
 
-  for (size_t i = 0; i < filenames.size(); ++i)
+
+// receives the boards found by scan_video, in frame order
+class BoardSink
+{
+public:
+  virtual ~BoardSink() { }
+
+  virtual void start(cv::Size const& image_size) = 0;
+
+  // returns false to stop the scan
+  virtual bool add(int frame, vector<Point2f> const& pattern_pts) = 0;
+};
+
+// Decodes the capture in batches and detects the boards of each batch in
+// parallel. Returns the frame size; frames and boards receive the counts of
+// scanned frames and found boards.
+static cv::Size scan_video(string const& path, BoardSink & sink, int & frames, int & boards)
+{
+  cv::VideoCapture cap(path);
+  if (!cap.isOpened())
+    throw std::runtime_error("Unable to open " + path);
+
+  int const batch_size = 4 * std::max(1, cv::getNumThreads());
+  vector<CalibImage> batch(batch_size);
+  cv::Size src_size;
+  frames = 0;
+  boards = 0;
+  while (true)
   {
-    string const& fn = filenames[i];
-    printf("Correcting %s\n", fn.c_str());
+    // the capture reuses one frame buffer, so each slot keeps its own copy
+    cv::Mat frame;
+    int n = 0;
+    for (; n < batch_size; ++n)
+    {
+      batch[n].found = false;
+      if (!cap.read(frame))
+        break;
+      frame.copyTo(batch[n].src);
+    }
+    if (n == 0)
+      break;
+    if (frames == 0)
+    {
+      src_size = batch[0].src.size();
+      sink.start(src_size);
+    }
 
-    Mat src = cv::imread(fn + ".jpg", CV_LOAD_IMAGE_COLOR);
-    Mat undist;
-    cv::remap(src, undist, map1, map2, cv::INTER_LINEAR);
-    cv::imwrite("_" + fn + ".undist.jpg", undist);
+    cv::parallel_for_(cv::Range(0, n), DetectCorners(batch, BOARD_SIZE, false));
+    for (int i = 0; i < n; ++i, ++frames)
+    {
+      if (batch[i].src.size() != src_size)
+        throw std::runtime_error("Frame size changes within " + path);
+      if (!batch[i].found)
+        continue;
+      ++boards;
+      if (!sink.add(frames, batch[i].pattern_pts))
+      {
+        ++frames;
+        return src_size;
+      }
+    }
+    if (n < batch_size)
+      break;
+  }
+  return src_size;
+}
+
+
+class SelectViews : public BoardSink
+{
+public:
+  virtual void start(cv::Size const& image_size)
+  {
+    selector = new ViewSelector(image_size, BOARD_SIZE);
   }
 
+  virtual bool add(int frame, vector<Point2f> const& pattern_pts)
+  {
+    selector->add(frame, pattern_pts);
+    return true;
+  }
+
+  cv::Ptr<ViewSelector> selector;
+};
+
+// usage: calib3d video file
+// scans the whole capture, then calibrates from a bounded selection of diverse board views
+static int run_video_calibration(string const& path)
+{
+  SelectViews sink;
+  int frames = 0;
+  int boards = 0;
+  cv::Size const src_size = scan_video(path, sink, frames, boards);
+  if (sink.selector.empty() || sink.selector->candidates() == 0)
+  {
+    printf("No calibration patterns found in %s\n", path.c_str());
+    return 1;
+  }
+
+  vector<int> frame_indices;
+  vector<vector<Point2f> > pts_by_img;
+  sink.selector->select(frame_indices, pts_by_img);
+  printf("Scanned %d frames: %d boards, %d distinct, %d views selected\n",
+         frames, boards, static_cast<int>(sink.selector->candidates()), static_cast<int>(pts_by_img.size()));
+  for (size_t i = 0; i < frame_indices.size(); ++i)
+    printf("  frame %d\n", frame_indices[i]);
+
+  calibrate(pts_by_img, src_size);
+  return 0;
+}
+
+
+class OnlineCalibration : public BoardSink
+{
+public:
+  virtual void start(cv::Size const& image_size)
+  {
+    session = new CalibrationSession(image_size, BOARD_SIZE, SQUARE_SIZE);
+  }
+
+  virtual bool add(int frame, vector<Point2f> const& pattern_pts)
+  {
+    // boards that moved less than min_motion since the last added view repeat it
+    if (!last_pts_.empty()
+        && rsdt::calib3d::mean_corner_displacement(pattern_pts, last_pts_) < view_settings_.min_motion)
+      return true;
+    last_pts_ = pattern_pts;
+    bool const converged = session->add_view(pattern_pts);
+    if (session->rms() >= 0)
+      printf("view %d (frame %d): RMS error %.4f\n",
+             static_cast<int>(session->views()), frame, session->rms());
+    return !converged;
+  }
+
+  cv::Ptr<CalibrationSession> session;
+
+private:
+  rsdt::calib3d::ViewSelectionSettings view_settings_;
+  vector<Point2f> last_pts_;
+};
+
+// usage: calib3d online file
+// adds views as they are found and stops as soon as the reprojection error has converged
+static int run_online_calibration(string const& path)
+{
+  OnlineCalibration sink;
+  int frames = 0;
+  int boards = 0;
+  cv::Size const src_size = scan_video(path, sink, frames, boards);
+  if (sink.session.empty() || sink.session->rms() < 0)
+  {
+    printf("Not enough calibration patterns found in %s\n", path.c_str());
+    return 1;
+  }
+
+  printf("%s after %d frames: RMS error %.4f from %d views\n",
+         sink.session->converged() ? "Converged" : "Capture ended", frames,
+         sink.session->rms(), static_cast<int>(sink.session->views()));
+  save_calibration(sink.session->camera_matrix(), sink.session->dist_coeffs(), src_size);
   return 0;
-}
\ No newline at end of file
+}
+
+
+int main(int argc, char const** argv)
+{
+  try
+  {
+    if (argc == 1)
+      return run_calibration();
+    if (string(argv[1]) == "undistort")
+      return run_undistort(vector<string>(argv + 2, argv + argc));
+    if (string(argv[1]) == "video" && argc == 3)
+      return run_video_calibration(argv[2]);
+    if (string(argv[1]) == "online" && argc == 3)
+      return run_online_calibration(argv[2]);
+    throw std::runtime_error("Bad command line; usage: ./calib3d [undistort input ... | video file | online file]");
+  }
+  catch (std::exception const& e)
+  {
+    fprintf(stderr, "Exception: %s\n", e.what());
+    return 1;
+  }
+}
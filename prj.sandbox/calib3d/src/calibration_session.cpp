@@ -0,0 +1,51 @@
+#include <cmath>
+#include <cfloat>
+#include <opencv2/calib3d/calib3d.hpp>
+#include "calibration_session.h"
+
+
+namespace rsdt { namespace calib3d {
+
+CalibrationSession::CalibrationSession(cv::Size const& image_size, cv::Size const& board_size,
+                                       double square_size, CalibrationSessionSettings const& settings)
+: image_size_(image_size),
+  settings_(settings),
+  camera_matrix_(cv::Mat::eye(3, 3, CV_64F)),
+  dist_coeffs_(cv::Mat::zeros(8, 1, CV_64F)),
+  rms_(-1),
+  stable_updates_(0),
+  converged_(false)
+{
+  for (int y = 0; y < board_size.height; ++y)
+    for (int x = 0; x < board_size.width; ++x)
+      board_pts_.push_back(cv::Point3f(x * square_size, y * square_size, 0));
+}
+
+bool CalibrationSession::add_view(std::vector<cv::Point2f> const& corners)
+{
+  CV_Assert(corners.size() == board_pts_.size());
+  image_pts_.push_back(corners);
+  object_pts_.push_back(board_pts_);
+  if (static_cast<int>(image_pts_.size()) < settings_.min_views)
+    return converged_;
+
+  bool const warm = rms_ >= 0;
+  int const flags = warm ? settings_.flags | CV_CALIB_USE_INTRINSIC_GUESS : settings_.flags;
+  cv::TermCriteria const criteria = warm
+      ? cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, settings_.max_iterations, DBL_EPSILON)
+      : cv::TermCriteria(CV_TERMCRIT_EPS + CV_TERMCRIT_ITER, 30, DBL_EPSILON);
+  std::vector<cv::Mat> rvecs;
+  std::vector<cv::Mat> tvecs;
+  double const rms = cv::calibrateCamera(object_pts_, image_pts_, image_size_, camera_matrix_,
+                                         dist_coeffs_, rvecs, tvecs, flags, criteria);
+
+  if (warm && std::fabs(rms - rms_) <= settings_.convergence_eps * rms_)
+    ++stable_updates_;
+  else
+    stable_updates_ = 0;
+  rms_ = rms;
+  converged_ = stable_updates_ >= settings_.converged_updates;
+  return converged_;
+}
+
+}}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/calib3d/calib3d.hpp>
+
+
+namespace rsdt { namespace calib3d {
+
+struct CalibrationSessionSettings
+{
+  int min_views;            // views collected before the first solve
+  double convergence_eps;   // relative RMS change below which an update counts as converged
+  int converged_updates;    // consecutive converged updates after which the session is done
+  int flags;                // calibrateCamera flags, CALIB_USE_INTRINSIC_GUESS is added after the first solve
+  int max_iterations;       // solver iterations of a warm-started update
+
+  CalibrationSessionSettings()
+  : min_views(4),
+    convergence_eps(0.01),
+    converged_updates(3),
+    flags(CV_CALIB_FIX_K4),
+    max_iterations(10)
+  { }
+};
+
+
+// Incremental calibration: views are added one at a time and every update
+// re-solves starting from the previous camera matrix and distortion, which
+// needs far fewer solver iterations than a cold start. The session reports the
+// running RMS reprojection error and declares convergence once it settles.
+class CalibrationSession
+{
+public:
+  CalibrationSession(cv::Size const& image_size, cv::Size const& board_size, double square_size,
+                     CalibrationSessionSettings const& settings = CalibrationSessionSettings());
+
+  // adds a view and updates the solution; returns converged()
+  bool add_view(std::vector<cv::Point2f> const& corners);
+
+  bool converged() const { return converged_; }
+
+  // RMS reprojection error of the last solve, negative before the first one
+  double rms() const { return rms_; }
+
+  size_t views() const { return image_pts_.size(); }
+
+  cv::Mat const& camera_matrix() const { return camera_matrix_; }
+  cv::Mat const& dist_coeffs() const { return dist_coeffs_; }
+
+private:
+  cv::Size image_size_;
+  CalibrationSessionSettings settings_;
+  std::vector<cv::Point3f> board_pts_;
+  std::vector<std::vector<cv::Point2f> > image_pts_;
+  std::vector<std::vector<cv::Point3f> > object_pts_;
+  cv::Mat camera_matrix_;
+  cv::Mat dist_coeffs_;
+  double rms_;
+  int stable_updates_;
+  bool converged_;
+};
+
+}}
@@ -0,0 +1,233 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <stdint.h>
+#include <boost/noncopyable.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "undistort.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+namespace rsdt { namespace calib3d {
+
+// read-only view of a whole file; mmap'd where available, read into memory otherwise
+class MappedFile : public MapStorage, private boost::noncopyable
+{
+public:
+  explicit MappedFile(std::string const& path)
+  : data_(0),
+    size_(0)
+  {
+#ifndef _WIN32
+    int const fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::runtime_error("Unable to open " + path);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+      close(fd);
+      throw std::runtime_error("Unable to stat " + path);
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void * const p = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      throw std::runtime_error("Unable to mmap " + path);
+    data_ = static_cast<uchar const*>(p);
+#else
+    FILE * const f = fopen(path.c_str(), "rb");
+    if (!f)
+      throw std::runtime_error("Unable to open " + path);
+    fseek(f, 0, SEEK_END);
+    buffer_.resize(static_cast<size_t>(ftell(f)));
+    fseek(f, 0, SEEK_SET);
+    size_t const read = buffer_.empty() ? 0 : fread(&buffer_[0], 1, buffer_.size(), f);
+    fclose(f);
+    if (buffer_.empty() || read != buffer_.size())
+      throw std::runtime_error("Unable to read " + path);
+    data_ = &buffer_[0];
+    size_ = buffer_.size();
+#endif
+  }
+
+  ~MappedFile()
+  {
+#ifndef _WIN32
+    munmap(const_cast<uchar *>(data_), size_);
+#endif
+  }
+
+  uchar const* data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  uchar const* data_;
+  size_t size_;
+#ifdef _WIN32
+  std::vector<uchar> buffer_;
+#endif
+};
+
+
+static char const UNDISTORT_MAP_MAGIC[8] = { 'R', 'S', 'D', 'T', 'U', 'D', 'M', '1' };
+static int const MAX_DIST_COEFFS = 14;
+static size_t const MAP_ALIGNMENT = 64;
+
+struct UndistortMapHeader
+{
+  char magic[8];
+  int32_t width;
+  int32_t height;
+  int32_t dist_count;
+  int32_t reserved;
+  double camera_matrix[9];
+  double dist_coeffs[MAX_DIST_COEFFS];
+  uint64_t map1_offset;
+  uint64_t map2_offset;
+};
+
+static size_t align_offset(size_t offset)
+{
+  return (offset + MAP_ALIGNMENT - 1) / MAP_ALIGNMENT * MAP_ALIGNMENT;
+}
+
+static void write_padding(FILE * f, size_t from, size_t to)
+{
+  static char const zeros[MAP_ALIGNMENT] = { 0 };
+  if (to > from)
+    fwrite(zeros, 1, to - from, f);
+}
+
+
+UndistortMap create_undistort_map(cv::Mat const& camera_matrix, cv::Mat const& dist_coeffs,
+                                  cv::Size const& image_size)
+{
+  UndistortMap map;
+  map.image_size = image_size;
+  camera_matrix.convertTo(map.camera_matrix, CV_64F);
+  dist_coeffs.reshape(1, static_cast<int>(dist_coeffs.total())).convertTo(map.dist_coeffs, CV_64F);
+  cv::initUndistortRectifyMap(map.camera_matrix, map.dist_coeffs, cv::Mat(),
+      cv::getOptimalNewCameraMatrix(map.camera_matrix, map.dist_coeffs, image_size, 1, image_size, 0),
+      image_size, CV_16SC2, map.map1, map.map2);
+  return map;
+}
+
+
+void save_undistort_map(std::string const& path, UndistortMap const& map)
+{
+  CV_Assert(map.map1.type() == CV_16SC2 && map.map2.type() == CV_16UC1);
+  CV_Assert(map.map1.size() == map.image_size && map.map2.size() == map.image_size);
+  int const dist_count = static_cast<int>(map.dist_coeffs.total());
+  if (dist_count > MAX_DIST_COEFFS)
+    throw std::runtime_error("Too many distortion coefficients");
+
+  UndistortMapHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, UNDISTORT_MAP_MAGIC, sizeof(h.magic));
+  h.width = map.image_size.width;
+  h.height = map.image_size.height;
+  h.dist_count = dist_count;
+  for (int i = 0; i < 9; ++i)
+    h.camera_matrix[i] = map.camera_matrix.at<double>(i / 3, i % 3);
+  for (int i = 0; i < dist_count; ++i)
+    h.dist_coeffs[i] = map.dist_coeffs.at<double>(i);
+
+  size_t const map1_row = map.map1.cols * map.map1.elemSize();
+  size_t const map2_row = map.map2.cols * map.map2.elemSize();
+  h.map1_offset = align_offset(sizeof(h));
+  h.map2_offset = align_offset(h.map1_offset + map1_row * map.map1.rows);
+
+  FILE * const f = fopen(path.c_str(), "wb");
+  if (!f)
+    throw std::runtime_error("Unable to create " + path);
+  fwrite(&h, sizeof(h), 1, f);
+  write_padding(f, sizeof(h), h.map1_offset);
+  for (int y = 0; y < map.map1.rows; ++y)
+    fwrite(map.map1.ptr(y), 1, map1_row, f);
+  write_padding(f, h.map1_offset + map1_row * map.map1.rows, h.map2_offset);
+  for (int y = 0; y < map.map2.rows; ++y)
+    fwrite(map.map2.ptr(y), 1, map2_row, f);
+  bool const ok = !ferror(f);
+  if (fclose(f) != 0 || !ok)
+    throw std::runtime_error("Unable to write " + path);
+}
+
+
+UndistortMap load_undistort_map(std::string const& path)
+{
+  MappedFile * const file = new MappedFile(path);
+  cv::Ptr<MapStorage> storage(file);
+  if (file->size() < sizeof(UndistortMapHeader))
+    throw std::runtime_error("Truncated undistortion map " + path);
+
+  UndistortMapHeader const* h = reinterpret_cast<UndistortMapHeader const*>(file->data());
+  if (memcmp(h->magic, UNDISTORT_MAP_MAGIC, sizeof(h->magic)) != 0)
+    throw std::runtime_error("Not an undistortion map: " + path);
+  if (h->width <= 0 || h->height <= 0 || h->dist_count < 0 || h->dist_count > MAX_DIST_COEFFS)
+    throw std::runtime_error("Corrupted undistortion map " + path);
+  uint64_t const pixels = static_cast<uint64_t>(h->width) * h->height;
+  if (h->map1_offset % MAP_ALIGNMENT != 0 || h->map2_offset % MAP_ALIGNMENT != 0
+      || h->map1_offset + pixels * 4 > file->size() || h->map2_offset + pixels * 2 > file->size())
+    throw std::runtime_error("Truncated undistortion map " + path);
+
+  UndistortMap map;
+  map.image_size = cv::Size(h->width, h->height);
+  map.camera_matrix = cv::Mat(3, 3, CV_64F, const_cast<double *>(h->camera_matrix)).clone();
+  map.dist_coeffs = cv::Mat(h->dist_count, 1, CV_64F, const_cast<double *>(h->dist_coeffs)).clone();
+  uchar * const base = const_cast<uchar *>(file->data());
+  map.map1 = cv::Mat(map.image_size, CV_16SC2, base + h->map1_offset);
+  map.map2 = cv::Mat(map.image_size, CV_16UC1, base + h->map2_offset);
+  map.storage = storage;
+  return map;
+}
+
+
+class RemapBands : public cv::ParallelLoopBody
+{
+public:
+  RemapBands(cv::Mat const& src, cv::Mat & dst, UndistortMap const& map, int band_rows)
+  : src_(src),
+    dst_(dst),
+    map_(map),
+    band_rows_(band_rows)
+  { }
+
+  virtual void operator()(cv::Range const& range) const
+  {
+    for (int band = range.start; band < range.end; ++band)
+    {
+      int const y0 = band * band_rows_;
+      int const y1 = std::min(y0 + band_rows_, dst_.rows);
+      // the destination band is a view into dst_, remap writes into it in place
+      cv::Mat dst_band = dst_.rowRange(y0, y1);
+      cv::remap(src_, dst_band, map_.map1.rowRange(y0, y1), map_.map2.rowRange(y0, y1),
+                cv::INTER_LINEAR);
+    }
+  }
+
+private:
+  cv::Mat const& src_;
+  cv::Mat & dst_;
+  UndistortMap const& map_;
+  int band_rows_;
+};
+
+void undistort(cv::Mat const& src, cv::Mat & dst, UndistortMap const& map, int band_rows)
+{
+  if (src.size() != map.image_size)
+    throw std::runtime_error("Image size does not match the undistortion map");
+  CV_Assert(band_rows > 0 && src.data != dst.data);
+  dst.create(map.image_size, src.type());
+  int const bands = (dst.rows + band_rows - 1) / band_rows;
+  cv::parallel_for_(cv::Range(0, bands), RemapBands(src, dst, map, band_rows));
+}
+
+}}
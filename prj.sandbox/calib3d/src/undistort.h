@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <opencv2/core/core.hpp>
+
+
+namespace rsdt { namespace calib3d {
+
+// owner of the memory a loaded map points into; destroyed through this base,
+// so it may be released wherever the last UndistortMap copy goes away
+class MapStorage
+{
+public:
+  virtual ~MapStorage() { }
+};
+
+// Camera intrinsics together with the CV_16SC2 / CV_16UC1 maps of
+// cv::initUndistortRectifyMap. Maps loaded from a file point straight
+// into its memory mapping, which stays alive as long as this object.
+struct UndistortMap
+{
+  cv::Size image_size;
+  cv::Mat camera_matrix;  // 3x3 CV_64F
+  cv::Mat dist_coeffs;    // Nx1 CV_64F
+  cv::Mat map1;
+  cv::Mat map2;
+  cv::Ptr<MapStorage> storage;
+};
+
+// builds the maps for the whole image (alpha = 1 of getOptimalNewCameraMatrix)
+UndistortMap create_undistort_map(cv::Mat const& camera_matrix, cv::Mat const& dist_coeffs,
+                                  cv::Size const& image_size);
+
+// Binary layout, native byte order: a fixed header (magic, image size,
+// intrinsics, map offsets) followed by the raw rows of map1 and map2,
+// each starting at a 64-byte aligned offset. Throws std::runtime_error on failure.
+void save_undistort_map(std::string const& path, UndistortMap const& map);
+
+UndistortMap load_undistort_map(std::string const& path);
+
+// cv::remap with INTER_LINEAR over horizontal bands of band_rows rows
+// processed in parallel; dst is (re)allocated to the map size
+void undistort(cv::Mat const& src, cv::Mat & dst, UndistortMap const& map, int band_rows = 32);
+
+}}
@@ -0,0 +1,209 @@
+#include <cmath>
+#include <algorithm>
+#include "view_selection.h"
+
+
+namespace rsdt { namespace calib3d {
+
+// pose bins: 3 tilt classes about each board axis times 3 board size classes
+static int const POSE_BINS = 3 * 3 * 3;
+static double const TILT_THRESHOLD = 0.08;  // |log| of the opposite edge length ratio
+
+
+static int popcount(uint64 v)
+{
+  int n = 0;
+  for (; v; v &= v - 1)
+    ++n;
+  return n;
+}
+
+static double distance(cv::Point2f const& a, cv::Point2f const& b)
+{
+  double const dx = a.x - b.x;
+  double const dy = a.y - b.y;
+  return std::sqrt(dx * dx + dy * dy);
+}
+
+static int tilt_class(double a, double b)
+{
+  double const t = std::log(std::max(a, 1e-6) / std::max(b, 1e-6));
+  return t < -TILT_THRESHOLD ? 0 : (t > TILT_THRESHOLD ? 2 : 1);
+}
+
+
+double mean_corner_displacement(std::vector<cv::Point2f> const& a, std::vector<cv::Point2f> const& b)
+{
+  CV_Assert(a.size() == b.size());
+  double sum = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    sum += distance(a[i], b[i]);
+  return a.empty() ? 0 : sum / a.size();
+}
+
+
+ViewSelector::ViewSelector(cv::Size const& image_size, cv::Size const& board_size,
+                           ViewSelectionSettings const& settings)
+: image_size_(image_size),
+  board_size_(board_size),
+  settings_(settings)
+{
+  CV_Assert(settings_.grid_cols > 0 && settings_.grid_rows > 0
+            && settings_.grid_cols * settings_.grid_rows <= 64);
+  CV_Assert(settings_.max_candidates >= 2);
+  bin_count_.assign(POSE_BINS * settings_.grid_cols * settings_.grid_rows, 0);
+}
+
+void ViewSelector::add(int index, std::vector<cv::Point2f> const& corners)
+{
+  if (static_cast<int>(corners.size()) != board_size_.area())
+    return;
+  int const pose_bin = poseBin(corners);
+  int const bin = pose_bin * settings_.grid_cols * settings_.grid_rows + centreCell(corners);
+
+  // a board that repeats one already kept in its bin adds nothing
+  for (size_t i = 0; i < candidates_.size(); ++i)
+    if (candidates_[i].bin == bin
+        && mean_corner_displacement(corners, candidates_[i].corners) < settings_.min_motion)
+      return;
+
+  Candidate c;
+  c.index = index;
+  c.corners = corners;
+  c.cells = coveredCells(corners);
+  c.pose_bin = pose_bin;
+  c.bin = bin;
+  candidates_.push_back(c);
+  ++bin_count_[bin];
+
+  // memory and selection time stay bounded for any capture length,
+  // while rare poses and regions keep their candidates
+  if (static_cast<int>(candidates_.size()) > settings_.max_candidates)
+    dropRedundant();
+}
+
+// Drops one board of the fullest bin: the later of the two consecutive
+// members that differ least, or its only member if every bin holds one.
+void ViewSelector::dropRedundant()
+{
+  int const fullest = static_cast<int>(std::max_element(bin_count_.begin(), bin_count_.end())
+                                       - bin_count_.begin());
+  size_t drop = candidates_.size();
+  size_t prev = candidates_.size();
+  bool paired = false;
+  double least = 0;
+  for (size_t i = 0; i < candidates_.size(); ++i)
+  {
+    if (candidates_[i].bin != fullest)
+      continue;
+    if (prev == candidates_.size())
+      drop = i;
+    else
+    {
+      double const d = mean_corner_displacement(candidates_[i].corners, candidates_[prev].corners);
+      if (!paired || d < least)
+      {
+        least = d;
+        drop = i;
+        paired = true;
+      }
+    }
+    prev = i;
+  }
+  --bin_count_[fullest];
+  candidates_.erase(candidates_.begin() + drop);
+}
+
+void ViewSelector::select(std::vector<int> & frame_indices,
+                          std::vector<std::vector<cv::Point2f> > & corners) const
+{
+  std::vector<bool> used(candidates_.size(), false);
+  std::vector<int> pose_count(POSE_BINS, 0);
+  std::vector<size_t> selected;
+  uint64 covered = 0;
+  while (static_cast<int>(selected.size()) < settings_.max_views)
+  {
+    // ties go to the earliest frame, so the result is deterministic
+    double best_score = -1;
+    size_t best = candidates_.size();
+    for (size_t i = 0; i < candidates_.size(); ++i)
+    {
+      if (used[i])
+        continue;
+      Candidate const& c = candidates_[i];
+      double const score = popcount(c.cells & ~covered)
+                         + settings_.tilt_weight / (1 + pose_count[c.pose_bin]);
+      if (score > best_score)
+      {
+        best_score = score;
+        best = i;
+      }
+    }
+    if (best == candidates_.size())
+      break;
+    used[best] = true;
+    covered |= candidates_[best].cells;
+    ++pose_count[candidates_[best].pose_bin];
+    selected.push_back(best);
+  }
+
+  std::sort(selected.begin(), selected.end());
+  frame_indices.clear();
+  corners.clear();
+  for (size_t i = 0; i < selected.size(); ++i)
+  {
+    frame_indices.push_back(candidates_[selected[i]].index);
+    corners.push_back(candidates_[selected[i]].corners);
+  }
+}
+
+uint64 ViewSelector::coveredCells(std::vector<cv::Point2f> const& corners) const
+{
+  uint64 cells = 0;
+  for (size_t i = 0; i < corners.size(); ++i)
+  {
+    int const gx = std::min(std::max(cvFloor(corners[i].x * settings_.grid_cols / image_size_.width), 0),
+                            settings_.grid_cols - 1);
+    int const gy = std::min(std::max(cvFloor(corners[i].y * settings_.grid_rows / image_size_.height), 0),
+                            settings_.grid_rows - 1);
+    cells |= static_cast<uint64>(1) << (gy * settings_.grid_cols + gx);
+  }
+  return cells;
+}
+
+int ViewSelector::centreCell(std::vector<cv::Point2f> const& corners) const
+{
+  cv::Point2f centre(0, 0);
+  for (size_t i = 0; i < corners.size(); ++i)
+    centre += corners[i];
+  centre *= 1.0f / corners.size();
+  int const gx = std::min(std::max(cvFloor(centre.x * settings_.grid_cols / image_size_.width), 0),
+                          settings_.grid_cols - 1);
+  int const gy = std::min(std::max(cvFloor(centre.y * settings_.grid_rows / image_size_.height), 0),
+                          settings_.grid_rows - 1);
+  return gy * settings_.grid_cols + gx;
+}
+
+int ViewSelector::poseBin(std::vector<cv::Point2f> const& corners) const
+{
+  int const w = board_size_.width;
+  int const h = board_size_.height;
+  cv::Point2f const& tl = corners[0];
+  cv::Point2f const& tr = corners[w - 1];
+  cv::Point2f const& bl = corners[(h - 1) * w];
+  cv::Point2f const& br = corners[h * w - 1];
+
+  // perspective shortens the far edge: compare opposite edges of the board
+  int const tilt_h = tilt_class(distance(tl, bl), distance(tr, br));
+  int const tilt_v = tilt_class(distance(tl, tr), distance(bl, br));
+
+  // quadrilateral area (shoelace) relative to the image
+  double const area = 0.5 * std::fabs((tl.x * tr.y - tr.x * tl.y) + (tr.x * br.y - br.x * tr.y)
+                                    + (br.x * bl.y - bl.x * br.y) + (bl.x * tl.y - tl.x * bl.y));
+  double const fraction = area / image_size_.area();
+  int const size_class = fraction < 0.1 ? 0 : (fraction < 0.3 ? 1 : 2);
+
+  return (tilt_h * 3 + tilt_v) * 3 + size_class;
+}
+
+}}
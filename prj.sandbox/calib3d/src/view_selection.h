@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+
+namespace rsdt { namespace calib3d {
+
+// mean distance between corresponding corners of two detections of the same board
+double mean_corner_displacement(std::vector<cv::Point2f> const& a, std::vector<cv::Point2f> const& b);
+
+
+struct ViewSelectionSettings
+{
+  int max_views;        // upper bound on the views passed to calibrateCamera
+  int max_candidates;   // beyond this, the most redundant board of the fullest bin is dropped
+  int grid_cols;        // the image is split into grid_cols x grid_rows regions (at most 64)
+  int grid_rows;        //   to measure how much of it the selected boards cover
+  double min_motion;    // mean corner displacement in pixels below which a board repeats one of its bin
+  double tilt_weight;   // value of a so far unseen pose bin, in newly covered regions
+
+  ViewSelectionSettings()
+  : max_views(30),
+    max_candidates(1000),
+    grid_cols(8),
+    grid_rows(6),
+    min_motion(5.0),
+    tilt_weight(4.0)
+  { }
+};
+
+
+// Collects the boards found in a long capture and picks a bounded, diverse
+// subset of them: greedily maximises coverage of image regions and the spread
+// over pose bins (tilt about both board axes and apparent board size).
+// Candidates are binned by pose bin and the region of the board centre; the
+// pool stays bounded by thinning the fullest of these bins.
+class ViewSelector
+{
+public:
+  ViewSelector(cv::Size const& image_size, cv::Size const& board_size,
+               ViewSelectionSettings const& settings = ViewSelectionSettings());
+
+  // corners of a board found in frame 'index'; frames are expected in increasing order
+  void add(int index, std::vector<cv::Point2f> const& corners);
+
+  size_t candidates() const { return candidates_.size(); }
+
+  // selected views, in frame order
+  void select(std::vector<int> & frame_indices, std::vector<std::vector<cv::Point2f> > & corners) const;
+
+private:
+  struct Candidate
+  {
+    int index;
+    std::vector<cv::Point2f> corners;
+    uint64 cells;  // bit per grid region touched by the board
+    int pose_bin;
+    int bin;       // pose bin and region of the board centre
+  };
+
+  uint64 coveredCells(std::vector<cv::Point2f> const& corners) const;
+  int poseBin(std::vector<cv::Point2f> const& corners) const;
+  int centreCell(std::vector<cv::Point2f> const& corners) const;
+  void dropRedundant();
+
+  cv::Size image_size_;
+  cv::Size board_size_;
+  ViewSelectionSettings settings_;
+  std::vector<Candidate> candidates_;  // in frame order
+  std::vector<int> bin_count_;
+};
+
+}}
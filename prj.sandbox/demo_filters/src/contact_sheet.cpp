@@ -0,0 +1,81 @@
+#include <stdexcept>
+#include <opencv2/opencv.hpp>
+#include "contact_sheet.h"
+
+
+static int const LABEL_HEIGHT = 24;
+static double const LABEL_FONT_SCALE = 0.6;
+
+
+ContactSheet::ContactSheet(cv::Size const& tile_size, int type, std::vector<std::string> const& names, int columns)
+: names_(names)
+{
+    CV_Assert(!names.empty() && columns > 0);
+    int const rows = (static_cast<int>(names.size()) + columns - 1) / columns;
+    int const cell_height = LABEL_HEIGHT + tile_size.height;
+    canvas_.create(rows * cell_height, columns * tile_size.width, type);
+
+    // only the labels and the unused cells are cleared; tiles are left for their writers
+    for (int i = 0; i < rows * columns; ++i)
+    {
+        cv::Point const origin((i % columns) * tile_size.width, (i / columns) * cell_height);
+        cv::Rect const label(origin, cv::Size(tile_size.width, LABEL_HEIGHT));
+        cv::Rect const tile(origin + cv::Point(0, LABEL_HEIGHT), tile_size);
+        canvas_(label).setTo(cv::Scalar::all(0));
+        if (i < static_cast<int>(names.size()))
+        {
+            cv::putText(canvas_, names[i], origin + cv::Point(4, LABEL_HEIGHT - 7),
+                        cv::FONT_HERSHEY_SIMPLEX, LABEL_FONT_SCALE, cv::Scalar::all(255));
+            rects_.push_back(tile);
+        }
+        else
+        {
+            canvas_(tile).setTo(cv::Scalar::all(0));
+        }
+    }
+}
+
+cv::Mat ContactSheet::tile(std::string const& name)
+{
+    for (size_t i = 0; i < names_.size(); ++i)
+        if (names_[i] == name)
+            return canvas_(rects_[i]);
+    throw std::runtime_error("No tile named " + name);
+}
+
+
+BackgroundImageWriter::~BackgroundImageWriter()
+{
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void BackgroundImageWriter::write(std::string const& path, cv::Mat const& image, std::vector<int> const& params)
+{
+    wait();
+    thread_ = boost::thread(&BackgroundImageWriter::run, this, path, image, params);
+}
+
+void BackgroundImageWriter::wait()
+{
+    if (thread_.joinable())
+        thread_.join();
+
+    std::string error;
+    error.swap(error_);
+    if (!error.empty())
+        throw std::runtime_error(error);
+}
+
+void BackgroundImageWriter::run(std::string const& path, cv::Mat const& image, std::vector<int> const& params)
+{
+    try
+    {
+        if (!cv::imwrite(path, image, params))
+            error_ = "Unable to write " + path;
+    }
+    catch (std::exception const& e)
+    {
+        error_ = path + ": " + e.what();
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+
+
+// One canvas with a labelled tile per image, laid out row-major in a fixed
+// number of columns. tile() returns a view into the canvas, so results
+// written there with the tile's size and type need no copy.
+class ContactSheet : private boost::noncopyable
+{
+public:
+    ContactSheet(cv::Size const& tile_size, int type, std::vector<std::string> const& names, int columns);
+
+    // canvas region of the named tile
+    cv::Mat tile(std::string const& name);
+
+    cv::Mat const& canvas() const { return canvas_; }
+
+private:
+    std::vector<std::string> names_;
+    std::vector<cv::Rect> rects_;
+    cv::Mat canvas_;
+};
+
+
+// Encodes images to files on a background thread, one at a time, so that the
+// caller can go on filtering the next input. An image passed to write() must
+// not be modified until the next write() or wait() returns.
+class BackgroundImageWriter : private boost::noncopyable
+{
+public:
+    BackgroundImageWriter() { }
+    ~BackgroundImageWriter();
+
+    // waits for the previous image, then starts encoding this one
+    void write(std::string const& path, cv::Mat const& image, std::vector<int> const& params = std::vector<int>());
+
+    // waits for the current image; throws if encoding it has failed
+    void wait();
+
+private:
+    void run(std::string const& path, cv::Mat const& image, std::vector<int> const& params);
+
+    boost::thread thread_;
+    std::string error_;  // of the last run, read after join
+};
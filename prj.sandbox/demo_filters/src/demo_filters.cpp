@@ -1,7 +1,12 @@
 #include <cstdio>
+#include <string>
+#include <vector>
 #include <stdexcept>
 #include <algorithm>
 #include <opencv2/opencv.hpp>
+#include <filters/filters.h>
+#include "contact_sheet.h"
+#include "filter_bench.h"
 
 
 using cv::Mat;
@@ -10,116 +15,82 @@ using cv::Size;
 
 static int const BLUR_APERTURE = 15;
 static double const BLUR_BILATERAL_SIGMA = 100;
-static bool SAVE_SIDE_BY_SIDE = true;
+static int const SHEET_COLUMNS = 7;
+static int const SHEET_PNG_COMPRESSION = 1;  // encoding time matters more than file size here
 
+static char const* const MORPH_OP_NAMES[] = { "dilate", "erode", "open", "close", "grad", "tophat", "blackhat" };
+static int const MORPH_SHAPES[] = { cv::MORPH_RECT, cv::MORPH_ELLIPSE, cv::MORPH_CROSS };
+static char const* const MORPH_SHAPE_NAMES[] = { "box", "circle", "cross" };
 
-static cv::Mat hstack(cv::Mat const& m1, cv::Mat const& m2)
-{
-  if (m1.empty())
-    return m2.clone();
-  if (m2.empty())
-    return m1.clone();
-
-  cv::Mat r(std::max(m1.rows, m2.rows), m1.cols + m2.cols, m1.type());
-  r = cv::Scalar(0);
-  cv::Mat d1 = r(cv::Rect(cv::Point(0, 0), m1.size()));
-  cv::Mat d2 = r(cv::Rect(cv::Point(m1.cols, 0), m2.size()));
-  m1.copyTo(d1);
-  m2.copyTo(d2);
-  return r;
-}
 
-static cv::Mat vstack(cv::Mat const& m1, cv::Mat const& m2)
+// tile names in sheet order: the source and non-morphological filters in the first row,
+// then one row of morphology per structuring element
+static std::vector<std::string> sheet_tile_names()
 {
-  if (m1.empty())
-    return m2.clone();
-  if (m2.empty())
-    return m1.clone();
-
-  cv::Mat r(m1.rows + m2.rows, std::max(m1.cols, m2.cols), m1.type());
-  r = cv::Scalar(0);
-  cv::Mat d1 = r(cv::Rect(cv::Point(0, 0), m1.size()));
-  cv::Mat d2 = r(cv::Rect(cv::Point(0, m1.rows), m2.size()));
-  m1.copyTo(d1);
-  m2.copyTo(d2);
-  return r;
+    char const* const first_row[] = { "src", "box", "median", "gauss", "bilateral", "bilateral_grid", "canny" };
+    std::vector<std::string> names(first_row, first_row + sizeof(first_row) / sizeof(first_row[0]));
+    for (int s = 0; s < 3; ++s)
+        for (int m = 0; m < 7; ++m)
+            names.push_back(std::string("morph_") + MORPH_OP_NAMES[m] + "_" + MORPH_SHAPE_NAMES[s]);
+    return names;
 }
 
 
-static void save_result(std::string const& name, cv::Mat const& src, cv::Mat const& dst)
+// every result is written directly into its tile: the tile views have the size and type
+// of src, so the filters' dst.create() keeps them
+static void render_morph_tiles(Mat const& src, ContactSheet & sheet, int strel_shape, std::string const& strel_name)
 {
-    cv::imwrite(name, SAVE_SIDE_BY_SIDE ? hstack(src, dst) : dst);
+    Mat const strel = cv::getStructuringElement(strel_shape, Size(BLUR_APERTURE, BLUR_APERTURE));
+    // the whole family from one dilation and one erosion plus their open/close passes
+    rsdt::filters::MorphBundle morph;
+    morph.dilated = sheet.tile("morph_dilate_" + strel_name);
+    morph.eroded = sheet.tile("morph_erode_" + strel_name);
+    morph.opened = sheet.tile("morph_open_" + strel_name);
+    morph.closed = sheet.tile("morph_close_" + strel_name);
+    morph.gradient = sheet.tile("morph_grad_" + strel_name);
+    morph.tophat = sheet.tile("morph_tophat_" + strel_name);
+    morph.blackhat = sheet.tile("morph_blackhat_" + strel_name);
+    rsdt::filters::morphology_bundle(src, strel, rsdt::filters::MORPH_OUT_ALL, morph);
 }
 
-
-static void save_morph_images(Mat const& src, int strel_shape, std::string const& strel_name)
+static void render_filter_tiles(Mat const& src, ContactSheet & sheet)
 {
-    Mat const strel = cv::getStructuringElement(strel_shape, Size(BLUR_APERTURE, BLUR_APERTURE));
-    Mat dst;
-    
-    cv::dilate(src, dst, strel);
-    save_result("morph_dilate_" + strel_name + ".png", src, dst);
+    Mat src_tile = sheet.tile("src");
+    src.copyTo(src_tile);
+
+    Mat box = sheet.tile("box");
+    cv::blur(src, box, Size(BLUR_APERTURE, BLUR_APERTURE));
 
-    cv::erode(src, dst, strel);
-    save_result("morph_erode_" + strel_name + ".png", src, dst);
+    Mat median = sheet.tile("median");
+    cv::medianBlur(src, median, BLUR_APERTURE);
 
-    cv::morphologyEx(src, dst, cv::MORPH_OPEN, strel);
-    save_result("morph_open_" + strel_name + ".png", src, dst);
+    Mat gauss = sheet.tile("gauss");
+    cv::GaussianBlur(src, gauss, Size(BLUR_APERTURE, BLUR_APERTURE), 0);
 
-    cv::morphologyEx(src, dst, cv::MORPH_CLOSE, strel);
-    save_result("morph_close_" + strel_name + ".png", src, dst);
+    for (int s = 0; s < 3; ++s)
+        render_morph_tiles(src, sheet, MORPH_SHAPES[s], MORPH_SHAPE_NAMES[s]);
 
-    cv::morphologyEx(src, dst, cv::MORPH_GRADIENT, strel);
-    save_result("morph_grad_" + strel_name + ".png", src, dst);
+    Mat bilateral = sheet.tile("bilateral");
+    cv::bilateralFilter(src, bilateral, BLUR_APERTURE, BLUR_BILATERAL_SIGMA, BLUR_BILATERAL_SIGMA);
 
-    cv::morphologyEx(src, dst, cv::MORPH_TOPHAT, strel);
-    save_result("morph_tophat_" + strel_name + ".png", src, dst);
+    Mat bilateral_grid = sheet.tile("bilateral_grid");
+    rsdt::filters::bilateral_grid(src, bilateral_grid, rsdt::filters::BilateralGridSettings(
+        BLUR_APERTURE / 4.0, BLUR_BILATERAL_SIGMA));
 
-    cv::morphologyEx(src, dst, cv::MORPH_BLACKHAT, strel);
-    save_result("morph_blackhat_" + strel_name + ".png", src, dst);
+    // edges of the gauss tile, which is the smoothing canny needs
+    Mat canny = sheet.tile("canny");
+    cv::Canny(gauss, canny, 20, 80);
 }
 
-static void save_filtered_images(Mat const& src)
+// <dir>/<name>.<ext> -> <name>_filters.png in the working directory
+static std::string sheet_path(std::string const& input_path)
 {
-    save_result("src.png", src, src);
-
-    { // such blocks '{}' are to ensure deallocation of filtered images to preserve memory
-      // and also to enable reuse of the name 'dst'
-        Mat dst;
-        cv::blur(src, dst, Size(BLUR_APERTURE, BLUR_APERTURE));
-        save_result("box.png", src, dst);
-    }
-
-    {
-        Mat dst;
-        cv::medianBlur(src, dst, BLUR_APERTURE);
-        save_result("median.png", src, dst);
-    }
-
-    {
-        Mat dst;
-        cv::GaussianBlur(src, dst, Size(BLUR_APERTURE, BLUR_APERTURE), 0);
-        save_result("gauss.png", src, dst);
-    }
-
-    save_morph_images(src, cv::MORPH_RECT, "box");
-    save_morph_images(src, cv::MORPH_ELLIPSE, "circle");
-    save_morph_images(src, cv::MORPH_CROSS, "cross");
-
-    {
-        Mat dst;
-        cv::bilateralFilter(src, dst, BLUR_APERTURE, BLUR_BILATERAL_SIGMA, BLUR_BILATERAL_SIGMA);
-        save_result("bilateral.png", src, dst);
-    }
-
-    {
-        Mat smooth;
-        cv::GaussianBlur(src, smooth, Size(BLUR_APERTURE, BLUR_APERTURE), 0);
-        
-        Mat dst;
-        cv::Canny(smooth, dst, 20, 80);
-        save_result("canny.png", src, dst);
-    }
+    size_t const slash = input_path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? input_path : input_path.substr(slash + 1);
+    size_t const dot = name.rfind('.');
+    if (dot != std::string::npos && dot > 0)
+        name.erase(dot);
+    return name + "_filters.png";
 }
 
 
@@ -127,12 +98,37 @@ int main(int argc, char const** argv)
 {
     try
     {
-        if (argc != 2)
-            throw std::runtime_error("Bad usage: must have input image as sole arg");
-        std::string const input_image_path = argv[1];
-        Mat const input_image = cv::imread(input_image_path, CV_LOAD_IMAGE_GRAYSCALE);
-
-        save_filtered_images(input_image);
+        bool const bench = argc == 3 && std::string(argv[1]) == "--bench";
+        if (argc < 2 || (std::string(argv[1]) == "--bench" && !bench))
+            throw std::runtime_error("Bad usage: must have input images as args, or --bench and input image");
+
+        if (bench)
+        {
+            Mat const input_image = cv::imread(argv[2], CV_LOAD_IMAGE_COLOR);
+            if (input_image.empty())
+                throw std::runtime_error(std::string("Unable to read ") + argv[2]);
+            run_filter_benchmark(input_image);
+            return 0;
+        }
+
+        // the sheet of one input is encoded while the next one is filtered
+        std::vector<std::string> const tile_names = sheet_tile_names();
+        std::vector<int> params;
+        params.push_back(CV_IMWRITE_PNG_COMPRESSION);
+        params.push_back(SHEET_PNG_COMPRESSION);
+        BackgroundImageWriter writer;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string const input_image_path = argv[i];
+            Mat const input_image = cv::imread(input_image_path, CV_LOAD_IMAGE_GRAYSCALE);
+            if (input_image.empty())
+                throw std::runtime_error("Unable to read " + input_image_path);
+
+            ContactSheet sheet(input_image.size(), input_image.type(), tile_names, SHEET_COLUMNS);
+            render_filter_tiles(input_image, sheet);
+            writer.write(sheet_path(input_image_path), sheet.canvas(), params);
+        }
+        writer.wait();
 
         return 0;
     }
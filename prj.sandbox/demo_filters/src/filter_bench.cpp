@@ -0,0 +1,261 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <opencv2/opencv.hpp>
+#include <filters/filters.h>
+#include "filter_bench.h"
+
+
+using cv::Mat;
+using cv::Size;
+
+
+// same parameters as the image-saving mode of demo_filters
+static int const BENCH_APERTURE = 15;
+static double const BENCH_BILATERAL_SIGMA = 100;
+static double const BENCH_MIN_SECONDS = 0.2;
+// median radii and image size of the radius sweep
+static int const MEDIAN_SWEEP_RADII[] = { 1, 2, 3, 5, 7, 10, 15, 20, 25, 30, 40, 50 };
+static Size const MEDIAN_SWEEP_SIZE(1280, 960);
+// sigmas and grid resolutions of the bilateral sweep; the exact filter gets d = 4 sigma_space + 1
+static double const BILATERAL_SWEEP_SIGMA_SPACE[] = { 2, 4, 8 };
+static double const BILATERAL_SWEEP_SIGMA_RANGE[] = { 10, 30, 100 };
+static double const BILATERAL_SWEEP_CELLS[] = { 1, 2 };
+static Size const BILATERAL_SWEEP_SIZE(640, 480);
+
+
+enum OpKind
+{
+  OP_BOX,
+  OP_MEDIAN,
+  OP_GAUSS,
+  OP_MORPH,
+  OP_BILATERAL,
+  OP_CANNY
+};
+
+struct BenchOp
+{
+  std::string name;
+  OpKind kind;
+  int morph_op;
+  Mat strel;
+  int ksize;
+  // cv::bilateralFilter takes ksize as d
+  double sigma_space;
+  double sigma_range;
+  rsdt::filters::BilateralGridSettings grid;
+
+  BenchOp(std::string const& n, OpKind k, int op = 0, Mat const& s = Mat())
+  : name(n),
+    kind(k),
+    morph_op(op),
+    strel(s),
+    ksize(BENCH_APERTURE),
+    sigma_space(BENCH_BILATERAL_SIGMA),
+    sigma_range(BENCH_BILATERAL_SIGMA),
+    grid(BENCH_APERTURE / 4.0, BENCH_BILATERAL_SIGMA)
+  { }
+
+  bool has_rsdt() const { return kind != OP_CANNY; }
+};
+
+
+static void run_opencv(BenchOp const& op, Mat const& src, Mat & dst)
+{
+  Size const ksize(BENCH_APERTURE, BENCH_APERTURE);
+  switch (op.kind)
+  {
+  case OP_BOX:
+    cv::blur(src, dst, ksize);
+    break;
+  case OP_MEDIAN:
+    cv::medianBlur(src, dst, op.ksize);
+    break;
+  case OP_GAUSS:
+    cv::GaussianBlur(src, dst, ksize, 0);
+    break;
+  case OP_MORPH:
+    cv::morphologyEx(src, dst, op.morph_op, op.strel);
+    break;
+  case OP_BILATERAL:
+    cv::bilateralFilter(src, dst, op.ksize, op.sigma_range, op.sigma_space);
+    break;
+  case OP_CANNY:
+    {
+      Mat smooth;
+      cv::GaussianBlur(src, smooth, ksize, 0);
+      cv::Canny(smooth, dst, 20, 80);
+    }
+    break;
+  }
+}
+
+static void run_rsdt(BenchOp const& op, Mat const& src, Mat & dst)
+{
+  Size const ksize(BENCH_APERTURE, BENCH_APERTURE);
+  switch (op.kind)
+  {
+  case OP_BOX:
+    rsdt::filters::box_blur(src, dst, ksize);
+    break;
+  case OP_MEDIAN:
+    rsdt::filters::median_blur(src, dst, op.ksize);
+    break;
+  case OP_GAUSS:
+    rsdt::filters::gaussian_blur(src, dst, ksize, 0);
+    break;
+  case OP_MORPH:
+    rsdt::filters::morphology(src, dst, op.morph_op, op.strel);
+    break;
+  case OP_BILATERAL:
+    rsdt::filters::bilateral_grid(src, dst, op.grid);
+    break;
+  default:
+    CV_Error(CV_StsBadArg, "no in-project implementation");
+  }
+}
+
+typedef void (*RunFn)(BenchOp const& op, Mat const& src, Mat & dst);
+
+// best time of one call in seconds, over enough repetitions to fill BENCH_MIN_SECONDS
+static double time_op(RunFn fn, BenchOp const& op, Mat const& src, Mat & dst)
+{
+  double best = 1e30;
+  double total = 0;
+  for (int rep = 0; rep < 3 || total < BENCH_MIN_SECONDS; ++rep)
+  {
+    int64 const t0 = cv::getTickCount();
+    fn(op, src, dst);
+    double const t = (cv::getTickCount() - t0) / cv::getTickFrequency();
+    best = std::min(best, t);
+    total += t;
+  }
+  return best;
+}
+
+
+static std::vector<BenchOp> bench_ops()
+{
+  std::vector<BenchOp> ops;
+  ops.push_back(BenchOp("box", OP_BOX));
+  ops.push_back(BenchOp("median", OP_MEDIAN));
+  ops.push_back(BenchOp("gauss", OP_GAUSS));
+
+  int const shapes[] = { cv::MORPH_RECT, cv::MORPH_ELLIPSE, cv::MORPH_CROSS };
+  char const* const shape_names[] = { "box", "circle", "cross" };
+  int const morph_ops[] = { cv::MORPH_DILATE, cv::MORPH_ERODE, cv::MORPH_OPEN, cv::MORPH_CLOSE,
+                            cv::MORPH_GRADIENT, cv::MORPH_TOPHAT, cv::MORPH_BLACKHAT };
+  char const* const morph_names[] = { "dilate", "erode", "open", "close", "grad", "tophat", "blackhat" };
+  for (int s = 0; s < 3; ++s)
+  {
+    Mat const strel = cv::getStructuringElement(shapes[s], Size(BENCH_APERTURE, BENCH_APERTURE));
+    for (int m = 0; m < 7; ++m)
+      ops.push_back(BenchOp(std::string("morph_") + morph_names[m] + "_" + shape_names[s],
+                            OP_MORPH, morph_ops[m], strel));
+  }
+
+  ops.push_back(BenchOp("bilateral", OP_BILATERAL));
+  ops.push_back(BenchOp("canny", OP_CANNY));
+  return ops;
+}
+
+
+// the in-project median should stay flat in the radius
+static void run_median_sweep(Mat const& src)
+{
+  Mat img;
+  cv::resize(src, img, MEDIAN_SWEEP_SIZE, 0, 0, cv::INTER_AREA);
+  double const mpix = img.total() / 1e6;
+  printf("\nmedian radius sweep at %dx%d\n", img.cols, img.rows);
+  printf("%8s %12s %12s %8s %8s\n", "radius", "opencv MP/s", "rsdt MP/s", "speedup", "maxdiff");
+  for (size_t i = 0; i < sizeof(MEDIAN_SWEEP_RADII) / sizeof(MEDIAN_SWEEP_RADII[0]); ++i)
+  {
+    BenchOp op("median", OP_MEDIAN);
+    op.ksize = 2 * MEDIAN_SWEEP_RADII[i] + 1;
+    Mat ref, dst;
+    double const t_cv = time_op(run_opencv, op, img, ref);
+    double const t_rsdt = time_op(run_rsdt, op, img, dst);
+    printf("%8d %12.1f %12.1f %8.2f %8.0f\n", MEDIAN_SWEEP_RADII[i],
+           mpix / t_cv, mpix / t_rsdt, t_cv / t_rsdt, cv::norm(ref, dst, cv::NORM_INF));
+  }
+}
+
+
+// speed of the bilateral grid against cv::bilateralFilter and its PSNR against it as the exact
+// result; for colour, OpenCV weighs the L1 colour distance while the grid uses the grey level
+static void run_bilateral_sweep(Mat const& src)
+{
+  Mat img;
+  cv::resize(src, img, BILATERAL_SWEEP_SIZE, 0, 0, cv::INTER_AREA);
+  double const mpix = img.total() / 1e6;
+  printf("\nbilateral sweep at %dx%d, %s\n", img.cols, img.rows, img.channels() == 3 ? "colour" : "grey");
+  printf("%8s %8s %6s %12s %12s %8s %8s\n", "s_space", "s_range", "cells", "opencv MP/s", "grid MP/s", "speedup", "PSNR");
+  for (size_t i = 0; i < sizeof(BILATERAL_SWEEP_SIGMA_SPACE) / sizeof(BILATERAL_SWEEP_SIGMA_SPACE[0]); ++i)
+  {
+    double const sigma_space = BILATERAL_SWEEP_SIGMA_SPACE[i];
+    for (size_t j = 0; j < sizeof(BILATERAL_SWEEP_SIGMA_RANGE) / sizeof(BILATERAL_SWEEP_SIGMA_RANGE[0]); ++j)
+    {
+      double const sigma_range = BILATERAL_SWEEP_SIGMA_RANGE[j];
+      BenchOp op("bilateral", OP_BILATERAL);
+      op.ksize = 4 * cvRound(sigma_space) + 1;
+      op.sigma_space = sigma_space;
+      op.sigma_range = sigma_range;
+      Mat exact;
+      double const t_cv = time_op(run_opencv, op, img, exact);
+      for (size_t k = 0; k < sizeof(BILATERAL_SWEEP_CELLS) / sizeof(BILATERAL_SWEEP_CELLS[0]); ++k)
+      {
+        op.grid = rsdt::filters::BilateralGridSettings(sigma_space, sigma_range, BILATERAL_SWEEP_CELLS[k]);
+        Mat dst;
+        double const t_grid = time_op(run_rsdt, op, img, dst);
+        printf("%8.0f %8.0f %6.0f %12.1f %12.1f %8.2f %8.1f\n", sigma_space, sigma_range, BILATERAL_SWEEP_CELLS[k],
+               mpix / t_cv, mpix / t_grid, t_cv / t_grid, cv::PSNR(exact, dst));
+      }
+    }
+  }
+}
+
+
+void run_filter_benchmark(Mat const& input)
+{
+  CV_Assert(input.type() == CV_8UC1 || input.type() == CV_8UC3);
+  Mat src;
+  if (input.channels() == 3)
+    cv::cvtColor(input, src, CV_BGR2GRAY);
+  else
+    src = input;
+
+  Size const sizes[] = { Size(640, 480), Size(1280, 960), Size(2560, 1920) };
+  std::vector<BenchOp> const ops = bench_ops();
+
+  printf("%-22s %10s %12s %12s %8s %8s\n", "operation", "size", "opencv MP/s", "rsdt MP/s", "speedup", "maxdiff");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+  {
+    Mat img;
+    cv::resize(src, img, sizes[s], 0, 0, cv::INTER_AREA);
+    double const mpix = img.total() / 1e6;
+    char size_str[32];
+    sprintf(size_str, "%dx%d", img.cols, img.rows);
+
+    for (size_t i = 0; i < ops.size(); ++i)
+    {
+      BenchOp const& op = ops[i];
+      Mat ref;
+      double const t_cv = time_op(run_opencv, op, img, ref);
+      if (!op.has_rsdt())
+      {
+        printf("%-22s %10s %12.1f %12s %8s %8s\n", op.name.c_str(), size_str, mpix / t_cv, "-", "-", "-");
+        continue;
+      }
+      Mat dst;
+      double const t_rsdt = time_op(run_rsdt, op, img, dst);
+      printf("%-22s %10s %12.1f %12.1f %8.2f %8.0f\n", op.name.c_str(), size_str,
+             mpix / t_cv, mpix / t_rsdt, t_cv / t_rsdt, cv::norm(ref, dst, cv::NORM_INF));
+    }
+  }
+  run_median_sweep(src);
+  run_bilateral_sweep(src);
+  if (input.channels() == 3)
+    run_bilateral_sweep(input);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+
+// times every demo_filters operation in OpenCV and in rsdt::filters on
+// rescaled grey copies of src (8-bit grey or BGR) and prints MPix/s per operation
+// and size, followed by a median sweep over radii 1..50 and a bilateral sweep over
+// sigmas with the PSNR of the bilateral grid (grey, and colour for a BGR src)
+void run_filter_benchmark(cv::Mat const& src);
@@ -18,8 +18,7 @@ double find_optimal_angle(cv::Mat const& src, Settings const& settings, DebugIma
                settings.optangle_prescale_factor, 
                settings.optangle_prescale_factor, 
                cv::INTER_AREA);
-    cv::Mat morph_grad = morph_filter(src_scaled, 1, 1, cv::MORPH_DILATE)
-                       - morph_filter(src_scaled, 1, 1, cv::MORPH_ERODE);
+    cv::Mat morph_grad = morph_bundle(src_scaled, 1, 1, filters::MORPH_OUT_GRADIENT).gradient;
     w.write("optangle_morph_grad", morph_grad);
 
     double best_angle = 0.0;
@@ -47,6 +46,18 @@ double find_optimal_angle(cv::Mat const& src, Settings const& settings, DebugIma
 }
 
 
+cv::Mat remove_noise(cv::Mat const& grey, Settings const& settings, DebugImageWriter & w)
+{
+    if (settings.noise_median_wing <= 0)
+        return grey;
+
+    cv::Mat denoised;
+    filters::median_blur(grey, denoised, 2 * settings.noise_median_wing + 1);
+    w.write("denoised", denoised);
+    return denoised;
+}
+
+
 cv::Mat remove_background(cv::Mat const& grey, Settings const& settings, DebugImageWriter & w)
 {
     cv::Mat background = morph_filter(grey, settings.bg_morph_wing, settings.bg_morph_wing, 
@@ -81,8 +92,10 @@ cv::Mat downscale(cv::Mat const& src, Settings const& settings, DebugImageWriter
         return src;
 
     int const morph_w = static_cast<int>(0.5 / factor);
-    cv::Mat src_dilated = morph_filter(src, morph_w, morph_w, cv::MORPH_DILATE);
-    cv::Mat src_eroded = morph_filter(src, morph_w, morph_w, cv::MORPH_ERODE);
+    filters::MorphBundle const src_morph = morph_bundle(src, morph_w, morph_w,
+                                                       filters::MORPH_OUT_DILATE | filters::MORPH_OUT_ERODE);
+    cv::Mat const& src_dilated = src_morph.dilated;
+    cv::Mat const& src_eroded = src_morph.eroded;
 
     cv::Mat ds;
     cv::resize(src, ds, cv::Size(), factor, factor, cv::INTER_AREA);
@@ -10,6 +10,7 @@ namespace rsdt { namespace docproc {
 
 struct Settings
 {
+    int noise_median_wing;  // median filter before background removal, 0 = off
     int bg_morph_wing;
     int fg_morph_wing;
     int fg_smooth_wing;
@@ -21,7 +22,8 @@ struct Settings
     double optangle_angle_step;
 
     Settings()
-    : bg_morph_wing(10),
+    : noise_median_wing(0),
+      bg_morph_wing(10),
       fg_morph_wing(50),
       fg_smooth_wing(50),
       fg_min_val(70),
@@ -37,6 +39,8 @@ class DebugImageWriter;
 
 double find_optimal_angle(cv::Mat const& src, Settings const& settings, DebugImageWriter & w);
 
+cv::Mat remove_noise(cv::Mat const& grey, Settings const& settings, DebugImageWriter & w);
+
 cv::Mat remove_background(cv::Mat const& grey, Settings const& settings, DebugImageWriter & w);
 
 cv::Mat downscale(cv::Mat const& src, Settings const& settings, DebugImageWriter & w);
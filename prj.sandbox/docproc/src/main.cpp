@@ -14,7 +14,8 @@ static cv::Mat enhance_image(cv::Mat const& src, Settings const& settings, Debug
     cv::Mat grey;
     cv::cvtColor(src, grey, CV_RGB2GRAY);
 
-    cv::Mat enhanced = remove_background(grey, settings, w);
+    cv::Mat denoised = remove_noise(grey, settings, w);
+    cv::Mat enhanced = remove_background(denoised, settings, w);
     w.write("enhanced", enhanced);
 
     double const angle = find_optimal_angle(enhanced, settings, w);
@@ -12,10 +12,21 @@ cv::Mat morph_filter(cv::Mat const& src, int wx, int wy, int operation)
 {
     cv::Mat const strel = cv::getStructuringElement(cv::MORPH_RECT, size_for_wing(wx, wy));
     cv::Mat dst;
-    cv::morphologyEx(src, dst, operation, strel);
+    if (src.type() == CV_8UC1)
+        filters::morphology(src, dst, operation, strel);
+    else
+        cv::morphologyEx(src, dst, operation, strel);
     return dst;   
 }
 
+filters::MorphBundle morph_bundle(cv::Mat const& src, int wx, int wy, int outputs)
+{
+    cv::Mat const strel = cv::getStructuringElement(cv::MORPH_RECT, size_for_wing(wx, wy));
+    filters::MorphBundle bundle;
+    filters::morphology_bundle(src, strel, outputs, bundle);
+    return bundle;
+}
+
 cv::Mat rotate_around_center(cv::Mat const& src, double angle)
 {
     cv::Mat rotated;
@@ -2,6 +2,7 @@
 #include <cstdio>
 #include <opencv2/opencv.hpp>
 #include <boost/noncopyable.hpp>
+#include <filters/filters.h>
 
 
 namespace rsdt { namespace docproc {
@@ -41,6 +42,10 @@ cv::Size size_for_wing(int wx, int wy);
 
 cv::Mat morph_filter(cv::Mat const& src, int wx, int wy, int operation);
 
+// several morph_filter results at once, see rsdt::filters::morphology_bundle;
+// outputs is a combination of rsdt::filters::MORPH_OUT_*
+filters::MorphBundle morph_bundle(cv::Mat const& src, int wx, int wy, int outputs);
+
 cv::Mat rotate_around_center(cv::Mat const& src, double angle);
 
 }}
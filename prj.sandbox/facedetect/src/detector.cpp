@@ -0,0 +1,194 @@
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include "detector.h"
+
+
+namespace rsdt { namespace facedetect {
+
+static cv::CascadeClassifier g_cascade;
+
+
+static cv::CascadeClassifier & cascade()
+{
+    if (g_cascade.empty() && !g_cascade.load("../data/haarcascade_frontalface_alt.xml"))
+        throw std::runtime_error("Unable to load cascade");
+    return g_cascade;
+}
+
+void detectFaces(std::vector<cv::Rect> & result, cv::Mat const& grey)
+{
+    cascade().detectMultiScale(grey, result);
+}
+
+
+void PlainDetector::detect(std::vector<cv::Rect> & result, cv::Mat const& grey)
+{
+    detectFaces(result, grey);
+}
+
+
+static cv::Rect inflate(cv::Rect const& r, int pad)
+{
+    return cv::Rect(r.x - pad, r.y - pad, r.width + 2 * pad, r.height + 2 * pad);
+}
+
+static bool intersectsAny(cv::Rect const& r, std::vector<cv::Rect> const& rects)
+{
+    for (size_t i = 0; i < rects.size(); ++i)
+        if ((r & rects[i]).area() > 0)
+            return true;
+    return false;
+}
+
+static void mergeOverlapping(std::vector<cv::Rect> & rects)
+{
+    bool merged = true;
+    while (merged)
+    {
+        merged = false;
+        for (size_t i = 0; i < rects.size() && !merged; ++i)
+            for (size_t j = i + 1; j < rects.size() && !merged; ++j)
+                if ((rects[i] & rects[j]).area() > 0)
+                {
+                    rects[i] |= rects[j];
+                    rects.erase(rects.begin() + j);
+                    merged = true;
+                }
+    }
+}
+
+
+MotionGatedDetector::MotionGatedDetector(MotionGateSettings const& settings)
+: settings_(settings),
+  frames_since_full_(0),
+  frames_total_(0),
+  frames_skipped_(0),
+  frames_roi_(0)
+{ }
+
+void MotionGatedDetector::detect(std::vector<cv::Rect> & result, cv::Mat const& grey)
+{
+    ++frames_total_;
+    cv::Mat small;
+    cv::resize(grey, small, cv::Size(), settings_.downscale_factor, settings_.downscale_factor,
+               cv::INTER_AREA);
+
+    bool const refresh = settings_.full_refresh_interval > 0
+                      && frames_since_full_ >= settings_.full_refresh_interval;
+    if (ref_small_.empty() || ref_small_.size() != small.size() || refresh)
+    {
+        detectFull(grey, small);
+        result = faces_;
+        return;
+    }
+    ++frames_since_full_;
+
+    cv::Mat mask;
+    cv::absdiff(small, ref_small_, mask);
+    cv::threshold(mask, mask, settings_.pixel_threshold, 255, cv::THRESH_BINARY);
+    if (cv::countNonZero(mask) < settings_.min_changed_fraction * mask.total())
+    {
+        // the reference is kept, so slow drift accumulates until it is detected
+        ++frames_skipped_;
+        result = faces_;
+        return;
+    }
+
+    std::vector<cv::Rect> rois;
+    changedRegions(rois, mask, grey.size());
+
+    double roi_area = 0;
+    for (size_t i = 0; i < rois.size(); ++i)
+        roi_area += rois[i].area();
+    if (roi_area > settings_.max_roi_fraction * grey.total())
+    {
+        detectFull(grey, small);
+        result = faces_;
+        return;
+    }
+
+    std::vector<cv::Rect> faces;
+    for (size_t i = 0; i < faces_.size(); ++i)
+        if (!intersectsAny(faces_[i], rois))
+            faces.push_back(faces_[i]);
+
+    std::vector<cv::Rect> found;
+    for (size_t i = 0; i < rois.size(); ++i)
+    {
+        detectFaces(found, grey(rois[i]));
+        for (size_t j = 0; j < found.size(); ++j)
+            faces.push_back(found[j] + rois[i].tl());
+    }
+
+    ++frames_roi_;
+    faces_.swap(faces);
+    ref_small_ = small;
+    result = faces_;
+}
+
+void MotionGatedDetector::printStats() const
+{
+    printf("Motion gate: %d frames, %d skipped, %d detected in changed regions, %d full\n",
+           frames_total_, frames_skipped_, frames_roi_,
+           frames_total_ - frames_skipped_ - frames_roi_);
+}
+
+void MotionGatedDetector::detectFull(cv::Mat const& grey, cv::Mat const& small)
+{
+    detectFaces(faces_, grey);
+    ref_small_ = small;
+    frames_since_full_ = 0;
+}
+
+// full-resolution bounding boxes of connected changed areas of mask,
+// grown by a margin and by the previous faces they touch, with overlaps merged
+void MotionGatedDetector::changedRegions(std::vector<cv::Rect> & rois,
+                                         cv::Mat const& mask,
+                                         cv::Size const& frame_size) const
+{
+    cv::Mat blobs;
+    cv::dilate(mask, blobs, cv::Mat(), cv::Point(-1, -1), 2);
+    std::vector<std::vector<cv::Point> > contours;
+    cv::findContours(blobs, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+
+    cv::Rect const frame(cv::Point(0, 0), frame_size);
+    double const inv_scale = 1.0 / settings_.downscale_factor;
+    rois.clear();
+    for (size_t i = 0; i < contours.size(); ++i)
+    {
+        cv::Rect const b = cv::boundingRect(contours[i]);
+        cv::Rect r(cvFloor(b.x * inv_scale), cvFloor(b.y * inv_scale),
+                   cvCeil(b.width * inv_scale), cvCeil(b.height * inv_scale));
+        // a face is larger than the part of it that moved (e.g. blinking eyes)
+        int const pad = std::max(r.width, r.height) / 2 + settings_.roi_margin;
+        rois.push_back(inflate(r, pad) & frame);
+    }
+
+    for (size_t i = 0; i < faces_.size(); ++i)
+        for (size_t j = 0; j < rois.size(); ++j)
+            if ((faces_[i] & rois[j]).area() > 0)
+                rois[j] = (rois[j] | inflate(faces_[i], settings_.roi_margin)) & frame;
+
+    mergeOverlapping(rois);
+}
+
+
+std::vector<std::string> detectorModes()
+{
+    std::vector<std::string> modes;
+    modes.push_back("plain");
+    modes.push_back("motion-gated");
+    return modes;
+}
+
+cv::Ptr<FaceDetector> createDetector(std::string const& mode)
+{
+    if (mode == "plain")
+        return cv::Ptr<FaceDetector>(new PlainDetector());
+    if (mode == "motion-gated")
+        return cv::Ptr<FaceDetector>(new MotionGatedDetector());
+    throw std::runtime_error("Unknown detector mode: " + mode);
+}
+
+}}
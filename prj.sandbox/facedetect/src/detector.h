@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+
+namespace rsdt { namespace facedetect {
+
+// run OpenCV face detector on grey, store detections to result
+void detectFaces(std::vector<cv::Rect> & result, cv::Mat const& grey);
+
+
+// common interface of the detection modes (see createDetector)
+class FaceDetector
+{
+public:
+    virtual ~FaceDetector() { }
+
+    virtual void detect(std::vector<cv::Rect> & result, cv::Mat const& grey) = 0;
+
+    virtual void printStats() const { }
+};
+
+
+// runs detectFaces on every frame
+class PlainDetector : public FaceDetector
+{
+public:
+    virtual void detect(std::vector<cv::Rect> & result, cv::Mat const& grey);
+};
+
+
+// parameters of the frame-difference stage in front of detectFaces
+struct MotionGateSettings
+{
+    double downscale_factor;      // scale of the grey frame used for differencing
+    int pixel_threshold;          // min abs difference of a downscaled pixel to count as changed
+    double min_changed_fraction;  // below this fraction of changed pixels previous faces are reused
+    double max_roi_fraction;      // if changed regions cover more of the frame, detect on all of it
+    int roi_margin;               // padding of changed regions, in full-resolution pixels
+    int full_refresh_interval;    // force full-frame detection every N frames, 0 to disable
+
+    MotionGateSettings()
+    : downscale_factor(0.25),
+      pixel_threshold(25),
+      min_changed_fraction(0.002),
+      max_roi_fraction(0.5),
+      roi_margin(16),
+      full_refresh_interval(100)
+    { }
+};
+
+// Runs detectFaces only where the frame has changed since the last detection.
+// Static frames reuse previous faces; otherwise detection is restricted to
+// bounding boxes of changed regions (plus the faces they touch).
+class MotionGatedDetector : public FaceDetector
+{
+public:
+    explicit MotionGatedDetector(MotionGateSettings const& settings = MotionGateSettings());
+
+    virtual void detect(std::vector<cv::Rect> & result, cv::Mat const& grey);
+
+    virtual void printStats() const;
+
+private:
+    void detectFull(cv::Mat const& grey, cv::Mat const& small);
+
+    void changedRegions(std::vector<cv::Rect> & rois, cv::Mat const& mask, cv::Size const& frame_size) const;
+
+    MotionGateSettings settings_;
+    cv::Mat ref_small_;  // downscaled grey frame of the last detection
+    std::vector<cv::Rect> faces_;
+    int frames_since_full_;
+    int frames_total_;
+    int frames_skipped_;
+    int frames_roi_;
+};
+
+
+// names accepted by createDetector, in the order facebench reports them
+std::vector<std::string> detectorModes();
+
+// "plain" or "motion-gated"; throws std::runtime_error on an unknown mode
+cv::Ptr<FaceDetector> createDetector(std::string const& mode);
+
+}}
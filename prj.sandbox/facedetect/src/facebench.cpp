@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <map>
+#include <opencv2/opencv.hpp>
+#include "detector.h"
+
+
+using rsdt::facedetect::FaceDetector;
+using rsdt::facedetect::createDetector;
+using rsdt::facedetect::detectorModes;
+
+typedef std::map<int, std::vector<cv::Rect> > GroundTruth;
+
+static double const MATCH_IOU = 0.5;
+
+
+// ground truth file: one box per line, "frame x y w h" with 0-based frame index;
+// empty lines and lines starting with '#' are ignored, frames without boxes have no faces
+static GroundTruth loadGroundTruth(std::string const& path)
+{
+    FILE * f = fopen(path.c_str(), "r");
+    if (!f)
+        throw std::runtime_error("Unable to open ground truth " + path);
+
+    GroundTruth gt;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        ++line_no;
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+        int frame = 0;
+        cv::Rect r;
+        if (sscanf(line, "%d %d %d %d %d", &frame, &r.x, &r.y, &r.width, &r.height) != 5)
+        {
+            fclose(f);
+            throw std::runtime_error("Bad ground truth line " + cv::format("%d", line_no) + " in " + path);
+        }
+        gt[frame].push_back(r);
+    }
+    fclose(f);
+    return gt;
+}
+
+static double iou(cv::Rect const& a, cv::Rect const& b)
+{
+    double const inter = (a & b).area();
+    double const uni = a.area() + b.area() - inter;
+    return uni > 0 ? inter / uni : 0.0;
+}
+
+// greedy one-to-one matching by decreasing IoU; returns the number of true positives
+static int countMatches(std::vector<cv::Rect> const& found, std::vector<cv::Rect> const& truth)
+{
+    std::vector<std::pair<double, std::pair<size_t, size_t> > > pairs;
+    for (size_t i = 0; i < found.size(); ++i)
+        for (size_t j = 0; j < truth.size(); ++j)
+        {
+            double const v = iou(found[i], truth[j]);
+            if (v >= MATCH_IOU)
+                pairs.push_back(std::make_pair(v, std::make_pair(i, j)));
+        }
+    std::sort(pairs.rbegin(), pairs.rend());
+
+    std::vector<bool> found_used(found.size(), false);
+    std::vector<bool> truth_used(truth.size(), false);
+    int matches = 0;
+    for (size_t k = 0; k < pairs.size(); ++k)
+    {
+        size_t const i = pairs[k].second.first;
+        size_t const j = pairs[k].second.second;
+        if (found_used[i] || truth_used[j])
+            continue;
+        found_used[i] = truth_used[j] = true;
+        ++matches;
+    }
+    return matches;
+}
+
+
+struct ModeReport
+{
+    std::string mode;
+    int frames;
+    int true_pos;
+    int false_pos;
+    int false_neg;
+    double total_ms;             // grey conversion + detection over all frames
+    double detect_ms;            // detection only
+    std::vector<double> latency_ms;  // per frame, grey conversion + detection
+
+    ModeReport()
+    : frames(0),
+      true_pos(0),
+      false_pos(0),
+      false_neg(0),
+      total_ms(0),
+      detect_ms(0)
+    { }
+
+    double precision() const { return true_pos + false_pos > 0 ? double(true_pos) / (true_pos + false_pos) : 1.0; }
+    double recall() const { return true_pos + false_neg > 0 ? double(true_pos) / (true_pos + false_neg) : 1.0; }
+
+    // latency_ms must be sorted
+    double percentile(double p) const
+    {
+        if (latency_ms.empty())
+            return 0;
+        size_t const idx = std::min(latency_ms.size() - 1, static_cast<size_t>(p * latency_ms.size()));
+        return latency_ms[idx];
+    }
+};
+
+
+// decoding is not timed; the source is reopened for every mode so each starts from frame 0
+static ModeReport runMode(std::string const& mode, std::string const& source, GroundTruth const& gt)
+{
+    cv::VideoCapture cap(source);
+    if (!cap.isOpened())
+        throw std::runtime_error("Unable to open VideoCapture for " + source);
+
+    ModeReport report;
+    report.mode = mode;
+    cv::Ptr<FaceDetector> detector = createDetector(mode);
+    double const ms_per_tick = 1000.0 / cv::getTickFrequency();
+    std::vector<cv::Rect> const no_faces;
+    cv::Mat frame;
+    cv::Mat grey;
+    std::vector<cv::Rect> faces;
+    while (cap.read(frame))
+    {
+        int64 const t0 = cv::getTickCount();
+        cv::cvtColor(frame, grey, CV_RGB2GRAY);
+        int64 const t1 = cv::getTickCount();
+        detector->detect(faces, grey);
+        int64 const t2 = cv::getTickCount();
+
+        report.latency_ms.push_back((t2 - t0) * ms_per_tick);
+        report.total_ms += (t2 - t0) * ms_per_tick;
+        report.detect_ms += (t2 - t1) * ms_per_tick;
+
+        GroundTruth::const_iterator it = gt.find(report.frames);
+        std::vector<cv::Rect> const& truth = it != gt.end() ? it->second : no_faces;
+        int const tp = countMatches(faces, truth);
+        report.true_pos += tp;
+        report.false_pos += static_cast<int>(faces.size()) - tp;
+        report.false_neg += static_cast<int>(truth.size()) - tp;
+        ++report.frames;
+    }
+    std::sort(report.latency_ms.begin(), report.latency_ms.end());
+    return report;
+}
+
+
+int main(int argc, char const** argv)
+{
+    try
+    {
+        if (argc < 3)
+            throw std::runtime_error("Bad command line; usage: ./facebench video-or-image-pattern ground-truth.txt [mode ...]");
+        std::string const source = argv[1];
+        GroundTruth const gt = loadGroundTruth(argv[2]);
+        std::vector<std::string> modes(argv + 3, argv + argc);
+        if (modes.empty())
+            modes = detectorModes();
+
+        std::vector<ModeReport> reports;
+        for (size_t i = 0; i < modes.size(); ++i)
+        {
+            printf("Running %s\n", modes[i].c_str());
+            reports.push_back(runMode(modes[i], source, gt));
+        }
+
+        printf("%-14s %7s %9s %7s %8s %9s %8s %8s %8s\n",
+               "mode", "frames", "precision", "recall", "fps", "detect_ms", "p50_ms", "p90_ms", "p99_ms");
+        for (size_t i = 0; i < reports.size(); ++i)
+        {
+            ModeReport const& r = reports[i];
+            if (r.frames == 0)
+                throw std::runtime_error("No frames read from " + source);
+            printf("%-14s %7d %9.3f %7.3f %8.1f %9.2f %8.2f %8.2f %8.2f\n",
+                   r.mode.c_str(), r.frames, r.precision(), r.recall(),
+                   r.total_ms > 0 ? 1000.0 * r.frames / r.total_ms : 0.0,
+                   r.detect_ms / r.frames,
+                   r.percentile(0.5), r.percentile(0.9), r.percentile(0.99));
+        }
+        return 0;
+    }
+    catch (std::exception const& e)
+    {
+        fprintf(stderr, "Exception: %s\n", e.what());
+        return 1;
+    }
+}
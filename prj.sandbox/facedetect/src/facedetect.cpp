@@ -1,50 +1,80 @@
 #include <cstdio>
+#include <cstring>
 #include <stdexcept>
+#include <algorithm>
 #include <opencv2/opencv.hpp>
+#include "detector.h"
 
-// used by extractFace
-static int const STANDARD_FACE_WIDTH = 200;
-
-static cv::CascadeClassifier g_cascade;
 
+using rsdt::facedetect::FaceDetector;
+using rsdt::facedetect::createDetector;
 
-// run OpenCV face detector on img, store detections to result
-static void detectFaces(std::vector<cv::Rect> & result, cv::Mat const& img)
-{
-    if (g_cascade.empty() && !g_cascade.load("../data/haarcascade_frontalface_alt.xml"))
-        throw std::runtime_error("Unable to load cascade");
-
-    cv::Mat grey;
-    cv::cvtColor(img, grey, CV_RGB2GRAY);
-    g_cascade.detectMultiScale(grey, result);
-}
+// size of a face slot in FaceBatch
+static int const STANDARD_FACE_WIDTH = 200;
+static int const STANDARD_FACE_HEIGHT = 200;
 
-// return a new image obtained by drawing supplied rectangles (faces) on img
-// img must not be modified
-static cv::Mat drawFaces(cv::Mat const& img, std::vector<cv::Rect> const& faces)
+// draw supplied rectangles (faces) on canvas in place
+static void drawFaces(cv::Mat & canvas, std::vector<cv::Rect> const& faces)
 {
-    cv::Mat canvas = img.clone();
     for (size_t i = 0; i < faces.size(); ++i)
         cv::rectangle(canvas, faces[i], cv::Scalar(0, 255, 0), 2);
-    return canvas;
 }
 
-// return an image with witdth exactly equal to STANDARD_FACE_WIDTH
-// obtained by cropping and scaling the given rect (face) of the img 
-static cv::Mat extractFace(cv::Mat const& img, cv::Rect const& face)
+// All faces of a frame cropped and scaled to STANDARD_FACE_WIDTH x STANDARD_FACE_HEIGHT,
+// stored back to back in one continuous N x H x W buffer that is reused across frames.
+// Each face is resized straight from its ROI of the frame into its slot.
+class FaceBatch
 {
-    if (face.area() == 0)
-        return cv::Mat();
-    cv::Mat result;
-    double const scaleFactor = static_cast<double>(STANDARD_FACE_WIDTH) / face.width;
-    cv::resize(img(face), result, cv::Size(), scaleFactor, scaleFactor);
-    return result;
-}
+public:
+    FaceBatch()
+    : count_(0)
+    { }
+
+    void assign(cv::Mat const& img, std::vector<cv::Rect> const& faces)
+    {
+        int const n = static_cast<int>(faces.size());
+        if (buffer_.empty() || buffer_.type() != img.type() || buffer_.rows < n * STANDARD_FACE_HEIGHT)
+        {
+            int const capacity = std::max(n, 2 * buffer_.rows / STANDARD_FACE_HEIGHT);
+            buffer_.create(std::max(capacity, 1) * STANDARD_FACE_HEIGHT, STANDARD_FACE_WIDTH, img.type());
+        }
+
+        count_ = n;
+        cv::Rect const frame(cv::Point(0, 0), img.size());
+        for (int i = 0; i < n; ++i)
+        {
+            cv::Mat slot = face(i);
+            cv::Rect const r = faces[i] & frame;
+            if (r.area() == 0)
+                slot = cv::Scalar::all(0);
+            else
+                cv::resize(img(r), slot, slot.size());
+        }
+    }
 
-static cv::Rect selectFace(std::vector<cv::Rect> const& faces)
+    int size() const { return count_; }
+
+    cv::Mat face(int i) const
+    {
+        return buffer_.rowRange(i * STANDARD_FACE_HEIGHT, (i + 1) * STANDARD_FACE_HEIGHT);
+    }
+
+    // all faces as a single continuous (N * H) x W image
+    cv::Mat tensor() const
+    {
+        return buffer_.rowRange(0, count_ * STANDARD_FACE_HEIGHT);
+    }
+
+private:
+    cv::Mat buffer_;
+    int count_;
+};
+
+// index of the widest face, -1 if there are none
+static int selectFace(std::vector<cv::Rect> const& faces)
 {
     if (faces.empty())
-        return cv::Rect();
+        return -1;
     int maxwidth = 0;
     size_t argmax = 0;
     for (size_t i = 0; i < faces.size(); ++i)
@@ -55,7 +85,7 @@ static cv::Rect selectFace(std::vector<cv::Rect> const& faces)
             argmax = i;
         }
     }
-    return faces[argmax];
+    return static_cast<int>(argmax);
 }
 
 
@@ -65,38 +95,67 @@ int main(int argc, char const** argv)
     The program should open the video source (camera if no arguments,
     video file if 1 argument), run OpenCV face detector, and display two windows:
         - input image with marked face rectangles (use drawFaces)
-        - cropped and resized face image (use extractFace), blank if no faces are found, something else if more than one found
+        - cropped and resized face image (use FaceBatch), blank if no faces are found, something else if more than one found
 
     For face detection, see cv::CascadeClassifier::detectMultiScale: http://docs.opencv.org/modules/objdetect/doc/cascade_classification.html#cascadeclassifier-detectmultiscale
     */
 
     try
     {
+        // --no-motion-gate runs the detector on every frame
+        bool motion_gate = true;
+        char const* source = 0;
+        for (int i = 1; i < argc; ++i)
+        {
+            if (strcmp(argv[i], "--no-motion-gate") == 0)
+                motion_gate = false;
+            else
+                source = argv[i];
+        }
+
         cv::VideoCapture cap;
-        if (argc == 1)
+        if (!source)
             cap.open(0);
         else
-            cap.open(argv[1]);
+            cap.open(source);
         if (!cap.isOpened())
             throw std::runtime_error("Unable to open VideoCapture");
 
+        cv::Ptr<FaceDetector> detector = createDetector(motion_gate ? "motion-gated" : "plain");
+        FaceBatch face_batch;
+        int64 detect_ticks = 0;
+        int frames = 0;
         while (true)
         {
             cv::Mat frame;
             if (!cap.read(frame))
                 break;
 
+            cv::Mat grey;
+            cv::cvtColor(frame, grey, CV_RGB2GRAY);
+
             std::vector<cv::Rect> faces;
-            detectFaces(faces, frame);
-            cv::imshow("facedetect", drawFaces(frame, faces));
-            cv::Rect face = selectFace(faces);
-            cv::Mat extracted = extractFace(frame, face);
-            if (!extracted.empty())
-                cv::imshow("face", extracted);
+            int64 const t0 = cv::getTickCount();
+            detector->detect(faces, grey);
+            detect_ticks += cv::getTickCount() - t0;
+            ++frames;
+
+            // faces are cropped before the overlay is drawn on the same frame
+            face_batch.assign(frame, faces);
+            drawFaces(frame, faces);
+            cv::imshow("facedetect", frame);
+            int const face = selectFace(faces);
+            if (face >= 0)
+                cv::imshow("face", face_batch.face(face));
             
             if ((cv::waitKey(20) & 0xFF) == 27)
                 break;
         }
+
+        if (frames > 0)
+            printf("Detection: %.2f ms per frame over %d frames\n",
+                   1000.0 * detect_ticks / cv::getTickFrequency() / frames, frames);
+        detector->printStats();
         return 0;
     }
     catch (std::exception const& e)
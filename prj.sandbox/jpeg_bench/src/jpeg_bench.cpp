@@ -0,0 +1,156 @@
+// Encode benchmark for the in-tree libjpeg: every input JPEG is decoded to RGB once,
+// then compressed to memory at each benchmark quality with the default settings
+// (2x2 chroma subsampling, JDCT_ISLOW) and the best time is reported.
+// Inputs are decoded in place from a file mapping, and all encodes share one
+// jpeg_buffer_dest buffer, as a server loop would.
+//
+//   jpeg_bench testdata/calib3d/*.jpg testdata/docproc/*.jpg
+//
+// Run it again with JSIMD_FORCENONE=1 in the environment to time the plain C code;
+// the compressed sizes must not change.
+
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <libjpeg/jpeglib.h>
+
+
+static int const BENCH_QUALITIES[] = { 75, 95 };
+static double const BENCH_MIN_SECONDS = 0.2;
+
+
+struct RgbImage
+{
+  std::string name;
+  JDIMENSION width;
+  JDIMENSION height;
+  std::vector<JSAMPLE> pixels;
+};
+
+
+static RgbImage read_rgb(std::string const& path)
+{
+  jpeg_file_map map;
+  if (!jpeg_map_file(&map, path.c_str()))
+    throw std::runtime_error("Unable to map " + path);
+
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, map.data, map.size);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&cinfo);
+
+  RgbImage img;
+  img.name = path.substr(path.find_last_of("/\\") + 1);
+  img.width = cinfo.output_width;
+  img.height = cinfo.output_height;
+  img.pixels.resize(static_cast<size_t>(img.width) * img.height * 3);
+  while (cinfo.output_scanline < cinfo.output_height)
+  {
+    JSAMPROW row = &img.pixels[static_cast<size_t>(cinfo.output_scanline) * img.width * 3];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  jpeg_unmap_file(&map);
+  return img;
+}
+
+
+// compressed size in bytes
+static unsigned long encode(RgbImage const& img, int quality, std::vector<JSAMPROW> & rows,
+                            jpeg_out_buffer & out)
+{
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  jpeg_buffer_dest(&cinfo, &out);
+  cinfo.image_width = img.width;
+  cinfo.image_height = img.height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  jpeg_write_scanlines(&cinfo, &rows[0], img.height);
+  jpeg_finish_compress(&cinfo);
+  jpeg_destroy_compress(&cinfo);
+  return static_cast<unsigned long>(out.size);
+}
+
+
+// best time of one encode in seconds, over enough repetitions to fill BENCH_MIN_SECONDS
+static double time_encode(RgbImage const& img, int quality, jpeg_out_buffer & out,
+                          unsigned long & out_size)
+{
+  std::vector<JSAMPROW> rows(img.height);
+  for (JDIMENSION y = 0; y < img.height; ++y)
+    rows[y] = const_cast<JSAMPLE*>(&img.pixels[static_cast<size_t>(y) * img.width * 3]);
+
+  double best = 1e30;
+  double total = 0;
+  for (int rep = 0; rep < 3 || total < BENCH_MIN_SECONDS; ++rep)
+  {
+    std::clock_t const t0 = std::clock();
+    out_size = encode(img, quality, rows, out);
+    double const t = static_cast<double>(std::clock() - t0) / CLOCKS_PER_SEC;
+    best = std::min(best, t);
+    total += t;
+  }
+  return best;
+}
+
+
+int main(int argc, char const** argv)
+{
+  try
+  {
+    if (argc < 2)
+      throw std::runtime_error("Bad usage: must have input JPEG images as args");
+
+    std::vector<RgbImage> images;
+    for (int i = 1; i < argc; ++i)
+      images.push_back(read_rgb(argv[i]));
+
+    size_t const num_qualities = sizeof(BENCH_QUALITIES) / sizeof(BENCH_QUALITIES[0]);
+    std::vector<double> total_mpix(num_qualities, 0), total_seconds(num_qualities, 0);
+    jpeg_out_buffer out = { NULL, 0, 0 };
+    printf("%-16s %11s", "image", "size");
+    for (size_t q = 0; q < num_qualities; ++q)
+      printf("   q%d MP/s    bytes", BENCH_QUALITIES[q]);
+    printf("\n");
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+      RgbImage const& img = images[i];
+      double const mpix = static_cast<double>(img.width) * img.height / 1e6;
+      printf("%-16s %5ux%-5u", img.name.c_str(), img.width, img.height);
+      for (size_t q = 0; q < num_qualities; ++q)
+      {
+        unsigned long out_size = 0;
+        double const t = time_encode(img, BENCH_QUALITIES[q], out, out_size);
+        total_mpix[q] += mpix;
+        total_seconds[q] += t;
+        printf(" %10.1f %8lu", mpix / t, out_size);
+      }
+      printf("\n");
+    }
+    printf("%-16s %11s", "total", "");
+    for (size_t q = 0; q < num_qualities; ++q)
+      printf(" %10.1f %8s", total_mpix[q] / total_seconds[q], "");
+    printf("\n");
+    jpeg_free_out_buffer(&out);
+  }
+  catch (std::exception const& e)
+  {
+    fprintf(stderr, "Exception: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
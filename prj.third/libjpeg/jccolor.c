@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -20,6 +21,7 @@ typedef struct {
 
   /* Private state for RGB->YCC conversion */
   INT32 * rgb_ycc_tab;		/* => table for RGB to YCbCr conversion */
+  jsimd_rgb_ycc_row_ptr simd_row; /* SIMD kernel for leading pixels, or NULL */
 } my_color_converter;
 
 typedef my_color_converter * my_cconvert_ptr;
@@ -145,7 +147,12 @@ rgb_ycc_convert (j_compress_ptr cinfo,
     outptr1 = output_buf[1][output_row];
     outptr2 = output_buf[2][output_row];
     output_row++;
-    for (col = 0; col < num_cols; col++) {
+    col = 0;
+    if (cconvert->simd_row != NULL) {
+      col = (*cconvert->simd_row) (inptr, outptr0, outptr1, outptr2, num_cols);
+      inptr += col * RGB_PIXELSIZE;
+    }
+    for (; col < num_cols; col++) {
       r = GETJSAMPLE(inptr[RGB_RED]);
       g = GETJSAMPLE(inptr[RGB_GREEN]);
       b = GETJSAMPLE(inptr[RGB_BLUE]);
@@ -422,6 +429,7 @@ jinit_color_converter (j_compress_ptr cinfo)
     if (cinfo->in_color_space == JCS_RGB) {
       cconvert->pub.start_pass = rgb_ycc_start;
       cconvert->pub.color_convert = rgb_ycc_convert;
+      cconvert->simd_row = jsimd_rgb_ycc_method();
     } else if (cinfo->in_color_space == JCS_YCbCr)
       cconvert->pub.color_convert = null_convert;
     else
@@ -0,0 +1,255 @@
+/*
+ * jccolsimd.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SIMD row kernels for RGB->YCbCr conversion
+ * (jccolor.c, SSSE3 and NEON) and for 2h2v downsampling (jcsample.c,
+ * SSE2 and NEON).  See jsimd.h for their contract.
+ *
+ * The rgb_ycc_start tables hold FIX(k) * i plus constant terms, so the C
+ * code computes, for 0 <= R,G,B <= MAXJSAMPLE,
+ *	Y  = (FIX(0.29900) * R + FIX(0.58700) * G + FIX(0.11400) * B
+ *	      + ONE_HALF) >> 16
+ *	Cb = (- FIX(0.16874) * R - FIX(0.33126) * G + FIX(0.50000) * B
+ *	      + CBCR_OFFSET + ONE_HALF-1) >> 16
+ *	Cr = (FIX(0.50000) * R - FIX(0.41869) * G - FIX(0.08131) * B
+ *	      + CBCR_OFFSET + ONE_HALF-1) >> 16
+ * in exact integer arithmetic.  FIX(0.58700) and FIX(0.50000) do not fit
+ * 16 bits signed: G is multiplied by FIX(0.58700) - 2**16 and G << 16
+ * added, and FIX(0.50000) * x is x << 15.  The rest is 16x16->32 bit
+ * multiply-adds, so the kernels reproduce the tables exactly.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jsimd.h"
+
+#if defined(JSIMD_SSSE3_SUPPORTED) || defined(JSIMD_NEON_SUPPORTED)
+
+#define SCALEBITS	16
+#define CBCR_OFFSET	((INT32) CENTERJSAMPLE << SCALEBITS)
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define FIX(x)		((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+#define K_R_Y	((int) FIX(0.29900))				/*  19595 */
+#define K_G_Y	((int) (FIX(0.58700) - (1L << SCALEBITS)))	/* -27066 */
+#define K_B_Y	((int) FIX(0.11400))				/*   7471 */
+#define K_R_CB	((int) (- FIX(0.16874)))			/* -11059 */
+#define K_G_CB	((int) (- FIX(0.33126)))			/* -21709 */
+#define K_G_CR	((int) (- FIX(0.41869)))			/* -27439 */
+#define K_B_CR	((int) (- FIX(0.08131)))			/*  -5329 */
+
+#endif
+
+
+#ifdef JSIMD_SSSE3_SUPPORTED
+
+#include <tmmintrin.h>
+
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#define SSSE3_TARGET  __attribute__((target("ssse3")))
+#else
+#define SSSE3_TARGET
+#endif
+
+/* Byte i of channel c of 16 interleaved 3-byte pixels, taken from the k-th
+ * 16-byte block of the input (0x80 yields zero if it lies in another block).
+ */
+#define UNPACK3_INDEX(k,c,i) \
+  ((char) ((3 * (i) + (c)) / 16 == (k) ? (3 * (i) + (c)) % 16 : 0x80))
+#define UNPACK3_MASK(k,c) \
+  _mm_setr_epi8(UNPACK3_INDEX(k,c,0), UNPACK3_INDEX(k,c,1), \
+		UNPACK3_INDEX(k,c,2), UNPACK3_INDEX(k,c,3), \
+		UNPACK3_INDEX(k,c,4), UNPACK3_INDEX(k,c,5), \
+		UNPACK3_INDEX(k,c,6), UNPACK3_INDEX(k,c,7), \
+		UNPACK3_INDEX(k,c,8), UNPACK3_INDEX(k,c,9), \
+		UNPACK3_INDEX(k,c,10), UNPACK3_INDEX(k,c,11), \
+		UNPACK3_INDEX(k,c,12), UNPACK3_INDEX(k,c,13), \
+		UNPACK3_INDEX(k,c,14), UNPACK3_INDEX(k,c,15))
+
+
+/* Y, Cb and Cr of the 8 pixels in the 16-bit vectors r, g, b. */
+
+SSSE3_TARGET LOCAL(void)
+rgb_ycc_8_ssse3 (__m128i r, __m128i g, __m128i b,
+		 __m128i * y, __m128i * cb, __m128i * cr)
+{
+  __m128i rg_lo = _mm_unpacklo_epi16(r, g);
+  __m128i rg_hi = _mm_unpackhi_epi16(r, g);
+  __m128i bg_lo = _mm_unpacklo_epi16(b, g);
+  __m128i bg_hi = _mm_unpackhi_epi16(b, g);
+  __m128i gb_lo = _mm_unpacklo_epi16(g, b);
+  __m128i gb_hi = _mm_unpackhi_epi16(g, b);
+  __m128i k_rg_y = _mm_set1_epi32((int) (((unsigned int) K_G_Y << 16) | (K_R_Y & 0xFFFF)));
+  __m128i k_b_y = _mm_set1_epi32(K_B_Y);	/* (B, G) pairs times (K_B_Y, 0) */
+  __m128i k_rg_cb = _mm_set1_epi32((int) (((unsigned int) K_G_CB << 16) | (K_R_CB & 0xFFFF)));
+  __m128i k_gb_cr = _mm_set1_epi32((int) (((unsigned int) K_B_CR << 16) | (K_G_CR & 0xFFFF)));
+  __m128i half = _mm_set1_epi32(ONE_HALF);
+  __m128i offset = _mm_set1_epi32(CBCR_OFFSET + ONE_HALF-1);
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo, hi;
+
+  /* Y: G << 16 is added after the shift, as G */
+  lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, k_rg_y),
+				   _mm_madd_epi16(bg_lo, k_b_y)), half);
+  hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, k_rg_y),
+				   _mm_madd_epi16(bg_hi, k_b_y)), half);
+  *y = _mm_add_epi16(_mm_packs_epi32(_mm_srai_epi32(lo, SCALEBITS),
+				     _mm_srai_epi32(hi, SCALEBITS)), g);
+
+  /* Cb */
+  lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, k_rg_cb), offset),
+		     _mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 15));
+  hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, k_rg_cb), offset),
+		     _mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 15));
+  *cb = _mm_packs_epi32(_mm_srai_epi32(lo, SCALEBITS),
+			_mm_srai_epi32(hi, SCALEBITS));
+
+  /* Cr */
+  lo = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(gb_lo, k_gb_cr), offset),
+		     _mm_slli_epi32(_mm_unpacklo_epi16(r, zero), 15));
+  hi = _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(gb_hi, k_gb_cr), offset),
+		     _mm_slli_epi32(_mm_unpackhi_epi16(r, zero), 15));
+  *cr = _mm_packs_epi32(_mm_srai_epi32(lo, SCALEBITS),
+			_mm_srai_epi32(hi, SCALEBITS));
+}
+
+
+SSSE3_TARGET GLOBAL(JDIMENSION)
+jsimd_rgb_ycc_row_ssse3 (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+			 JSAMPROW outptr2, JDIMENSION num_cols)
+{
+  __m128i zero = _mm_setzero_si128();
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    __m128i in0 = _mm_loadu_si128((const __m128i *) inptr);
+    __m128i in1 = _mm_loadu_si128((const __m128i *) (inptr + 16));
+    __m128i in2 = _mm_loadu_si128((const __m128i *) (inptr + 32));
+    __m128i y_lo, y_hi, cb_lo, cb_hi, cr_lo, cr_hi;
+    __m128i ch[3];
+    int c;
+
+    for (c = 0; c < 3; c++)
+      ch[c] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in0, UNPACK3_MASK(0,c)),
+					_mm_shuffle_epi8(in1, UNPACK3_MASK(1,c))),
+			   _mm_shuffle_epi8(in2, UNPACK3_MASK(2,c)));
+    rgb_ycc_8_ssse3(_mm_unpacklo_epi8(ch[0], zero), _mm_unpacklo_epi8(ch[1], zero),
+		    _mm_unpacklo_epi8(ch[2], zero), &y_lo, &cb_lo, &cr_lo);
+    rgb_ycc_8_ssse3(_mm_unpackhi_epi8(ch[0], zero), _mm_unpackhi_epi8(ch[1], zero),
+		    _mm_unpackhi_epi8(ch[2], zero), &y_hi, &cb_hi, &cr_hi);
+    _mm_storeu_si128((__m128i *) (outptr0 + col), _mm_packus_epi16(y_lo, y_hi));
+    _mm_storeu_si128((__m128i *) (outptr1 + col), _mm_packus_epi16(cb_lo, cb_hi));
+    _mm_storeu_si128((__m128i *) (outptr2 + col), _mm_packus_epi16(cr_lo, cr_hi));
+    inptr += 48;
+  }
+  return col;
+}
+
+#endif /* JSIMD_SSSE3_SUPPORTED */
+
+
+#ifdef JSIMD_SSE2_SUPPORTED
+
+#include <emmintrin.h>
+
+GLOBAL(JDIMENSION)
+jsimd_h2v2_downsample_row_sse2 (JSAMPROW inptr0, JSAMPROW inptr1,
+				JSAMPROW outptr, JDIMENSION output_cols)
+{
+  __m128i mask = _mm_set1_epi16(0xFF);
+  __m128i bias = _mm_set1_epi32(0x00020001); /* 1,2,1,2,... as in C */
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= output_cols; col += 16) {
+    __m128i sum[2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      __m128i a = _mm_loadu_si128((const __m128i *) (inptr0 + 2 * col + 16 * h));
+      __m128i b = _mm_loadu_si128((const __m128i *) (inptr1 + 2 * col + 16 * h));
+
+      sum[h] = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+			     _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
+      sum[h] = _mm_srli_epi16(_mm_add_epi16(sum[h], bias), 2);
+    }
+    _mm_storeu_si128((__m128i *) (outptr + col), _mm_packus_epi16(sum[0], sum[1]));
+  }
+  return col;
+}
+
+#endif /* JSIMD_SSE2_SUPPORTED */
+
+
+#ifdef JSIMD_NEON_SUPPORTED
+
+#include <arm_neon.h>
+
+/* Y, Cb or Cr of 8 pixels: start + k0 * x0 + k1 * x1, descaled.  The sum
+ * is never negative, so it can be narrowed as unsigned.
+ */
+#define RGB_YCC_NEON(start, x0, k0, x1, k1) \
+  vshrn_n_u32(vreinterpretq_u32_s32(vmlal_n_s16(vmlal_n_s16(start, x0, k0), x1, k1)), \
+	      SCALEBITS)
+
+GLOBAL(JDIMENSION)
+jsimd_rgb_ycc_row_neon (JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+			JSAMPROW outptr2, JDIMENSION num_cols)
+{
+  JDIMENSION col;
+
+  for (col = 0; col + 8 <= num_cols; col += 8) {
+    uint8x8x3_t px = vld3_u8(inptr);
+    int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(px.val[0]));
+    int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(px.val[1]));
+    int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(px.val[2]));
+    int32x4_t y_lo, y_hi, cb_lo, cb_hi, cr_lo, cr_hi;
+    int32x4_t half = vdupq_n_s32(ONE_HALF);
+    int32x4_t offset = vdupq_n_s32(CBCR_OFFSET + ONE_HALF-1);
+
+    /* Y: FIX(0.58700) * G = (G << 16) + K_G_Y * G */
+    y_lo = vmlal_n_s16(vaddq_s32(half, vshll_n_s16(vget_low_s16(g), 16)),
+		       vget_low_s16(b), K_B_Y);
+    y_hi = vmlal_n_s16(vaddq_s32(half, vshll_n_s16(vget_high_s16(g), 16)),
+		       vget_high_s16(b), K_B_Y);
+    cb_lo = vaddq_s32(offset, vshll_n_s16(vget_low_s16(b), 15));
+    cb_hi = vaddq_s32(offset, vshll_n_s16(vget_high_s16(b), 15));
+    cr_lo = vaddq_s32(offset, vshll_n_s16(vget_low_s16(r), 15));
+    cr_hi = vaddq_s32(offset, vshll_n_s16(vget_high_s16(r), 15));
+
+    vst1_u8(outptr0 + col, vmovn_u16(vcombine_u16(
+      RGB_YCC_NEON(y_lo, vget_low_s16(r), K_R_Y, vget_low_s16(g), K_G_Y),
+      RGB_YCC_NEON(y_hi, vget_high_s16(r), K_R_Y, vget_high_s16(g), K_G_Y))));
+    vst1_u8(outptr1 + col, vmovn_u16(vcombine_u16(
+      RGB_YCC_NEON(cb_lo, vget_low_s16(r), K_R_CB, vget_low_s16(g), K_G_CB),
+      RGB_YCC_NEON(cb_hi, vget_high_s16(r), K_R_CB, vget_high_s16(g), K_G_CB))));
+    vst1_u8(outptr2 + col, vmovn_u16(vcombine_u16(
+      RGB_YCC_NEON(cr_lo, vget_low_s16(g), K_G_CR, vget_low_s16(b), K_B_CR),
+      RGB_YCC_NEON(cr_hi, vget_high_s16(g), K_G_CR, vget_high_s16(b), K_B_CR))));
+    inptr += 24;
+  }
+  return col;
+}
+
+
+GLOBAL(JDIMENSION)
+jsimd_h2v2_downsample_row_neon (JSAMPROW inptr0, JSAMPROW inptr1,
+				JSAMPROW outptr, JDIMENSION output_cols)
+{
+  static const uint16_t bias_values[8] = { 1, 2, 1, 2, 1, 2, 1, 2 };
+  uint16x8_t bias = vld1q_u16(bias_values);	/* as in C */
+  JDIMENSION col;
+
+  for (col = 0; col + 8 <= output_cols; col += 8) {
+    uint16x8_t sum = vpaddlq_u8(vld1q_u8(inptr0 + 2 * col));
+
+    sum = vpadalq_u8(sum, vld1q_u8(inptr1 + 2 * col));
+    vst1_u8(outptr + col, vshrn_n_u16(vaddq_u16(sum, bias), 2));
+  }
+  return col;
+}
+
+#endif /* JSIMD_NEON_SUPPORTED */
@@ -31,6 +31,9 @@ typedef struct {
    */
   DCTELEM * divisors[NUM_QUANT_TBLS];
 
+  /* SIMD quantization routine, or NULL to use the loop in forward_DCT */
+  quantize_method_ptr quantize;
+
 #ifdef DCT_FLOAT_SUPPORTED
   /* Same as above for the floating-point case. */
   float_DCT_method_ptr do_float_dct[MAX_COMPONENTS];
@@ -82,6 +85,9 @@ forward_DCT (j_compress_ptr cinfo, jpeg_component_info * compptr,
     (*do_dct) (workspace, sample_data, start_col);
 
     /* Quantize/descale the coefficients, and store into coef_blocks[] */
+    if (fdct->quantize != NULL)
+      (*fdct->quantize) (coef_blocks[bi], divisors, workspace);
+    else
     { register DCTELEM temp, qval;
       register int i;
       register JCOEFPTR output_ptr = coef_blocks[bi];
@@ -320,7 +326,9 @@ start_pass_fdctmgr (j_compress_ptr cinfo)
       switch (cinfo->dct_method) {
 #ifdef DCT_ISLOW_SUPPORTED
       case JDCT_ISLOW:
-	fdct->do_dct[ci] = jpeg_fdct_islow;
+	fdct->do_dct[ci] = jsimd_fdct_islow_method(); /* same output, faster */
+	if (fdct->do_dct[ci] == NULL)
+	  fdct->do_dct[ci] = jpeg_fdct_islow;
 	method = JDCT_ISLOW;
 	break;
 #endif
@@ -471,6 +479,7 @@ jinit_forward_dct (j_compress_ptr cinfo)
 				SIZEOF(my_fdct_controller));
   cinfo->fdct = (struct jpeg_forward_dct *) fdct;
   fdct->pub.start_pass = start_pass_fdctmgr;
+  fdct->quantize = jsimd_quantize_method();
 
   /* Mark divisor tables unallocated */
   for (i = 0; i < NUM_QUANT_TBLS; i++) {
@@ -0,0 +1,449 @@
+/*
+ * jcmtenc.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains multi-threaded compression with restart markers.
+ * Restart intervals are coded independently, so jpeg_write_image_mt
+ * splits the image into bands of iMCU rows that begin at restart
+ * boundaries and compresses the bands concurrently, color conversion,
+ * downsampling, DCT, quantization and Huffman coding included.
+ *
+ * Every band is compressed by a compression object of its own, with the
+ * application's parameters and tables, into a memory buffer.  The band's
+ * entropy-coded data, after its headers and before its EOI, has its RSTn
+ * markers renumbered to their place in the image; the application's
+ * object writes the headers and then the bands, in order, separated by
+ * the RSTn markers between them.  The datastream is the same, byte for
+ * byte, as sequential compression with the same restart interval writes.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jmemsys.h"
+#include "jthread.h"
+#include <setjmp.h>
+
+
+#define BANDS_PER_THREAD  2	/* a little slack for uneven bands */
+#define BAND_BUF_SIZE  65536	/* initial size of a band's output buffer */
+
+#define M_RST0  0xd0
+
+
+/* A band of the input image, and the compressed data of it */
+
+typedef struct {
+  JDIMENSION first_row;		/* input rows of the band */
+  JDIMENSION num_rows;
+  int first_interval;		/* index of its first restart interval */
+
+  JOCTET FAR * buffer;		/* band datastream, from jpeg_get_large */
+  size_t buffer_size;
+  size_t data_start;		/* its entropy-coded data */
+  size_t data_end;
+
+  /* Outcome, reported to the application's error manager afterwards */
+  boolean failed;
+  long num_warnings;
+  struct jpeg_error_mgr error;	/* msg_code and msg_parm of the error, or
+				 * of the first warning */
+} band_info;
+
+
+/* Multi-threaded compression state, shared by the band tasks */
+
+typedef struct {
+  j_compress_ptr cinfo;		/* the application's object; read only */
+  JSAMPARRAY scanlines;		/* input row pointers */
+  int num_bands;
+  band_info * bands;
+} mt_encoder;
+
+
+/* Error manager of a band compressor: errors and warnings are recorded for
+ * the application's error manager, which is called from its own thread.
+ */
+
+typedef struct {
+  struct jpeg_error_mgr pub;	/* "public" fields */
+  jmp_buf setjmp_buffer;	/* for return to caller */
+  band_info * band;
+} band_error_mgr;
+
+typedef band_error_mgr * band_error_ptr;
+
+
+METHODDEF(void)
+band_error_exit (j_common_ptr cinfo)
+{
+  band_error_ptr err = (band_error_ptr) cinfo->err;
+
+  err->band->failed = TRUE;
+  err->band->error = err->pub;
+  longjmp(err->setjmp_buffer, 1);
+}
+
+
+METHODDEF(void)
+band_emit_message (j_common_ptr cinfo, int msg_level)
+{
+  band_error_ptr err = (band_error_ptr) cinfo->err;
+
+  if (msg_level < 0) {
+    if (err->pub.num_warnings == 0)
+      err->band->error = err->pub;
+    err->pub.num_warnings++;
+  }
+}
+
+
+/* Data destination of a band compressor: a buffer that doubles as needed.
+ * It outlives the compression object; the application's object frees it.
+ */
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  band_info * band;
+} band_dest_mgr;
+
+typedef band_dest_mgr * band_dest_ptr;
+
+
+METHODDEF(void)
+init_band_destination (j_compress_ptr cinfo)
+{
+  band_dest_ptr dest = (band_dest_ptr) cinfo->dest;
+  band_info * band = dest->band;
+
+  band->buffer = (JOCTET FAR *) jpeg_get_large((j_common_ptr) cinfo,
+					       BAND_BUF_SIZE * SIZEOF(JOCTET));
+  if (band->buffer == NULL)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+  band->buffer_size = BAND_BUF_SIZE;
+  dest->pub.next_output_byte = band->buffer;
+  dest->pub.free_in_buffer = band->buffer_size;
+}
+
+
+METHODDEF(boolean)
+empty_band_buffer (j_compress_ptr cinfo)
+{
+  band_dest_ptr dest = (band_dest_ptr) cinfo->dest;
+  band_info * band = dest->band;
+  JOCTET FAR * buffer;
+
+  buffer = (JOCTET FAR *) jpeg_get_large((j_common_ptr) cinfo,
+					 band->buffer_size * 2 * SIZEOF(JOCTET));
+  if (buffer == NULL)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+  MEMCOPY(buffer, band->buffer, band->buffer_size * SIZEOF(JOCTET));
+  jpeg_free_large((j_common_ptr) cinfo, (void FAR *) band->buffer,
+		  band->buffer_size * SIZEOF(JOCTET));
+  band->buffer = buffer;
+
+  dest->pub.next_output_byte = buffer + band->buffer_size;
+  dest->pub.free_in_buffer = band->buffer_size;
+  band->buffer_size *= 2;
+  return TRUE;
+}
+
+
+METHODDEF(void)
+term_band_destination (j_compress_ptr cinfo)
+{
+  /* no work necessary here */
+}
+
+
+/*
+ * Compress one band; the body of a jthread_run task.
+ */
+
+METHODDEF(void)
+encode_band (void * arg, int bandno)
+{
+  mt_encoder * mt = (mt_encoder *) arg;
+  j_compress_ptr cinfo = mt->cinfo;
+  band_info * band = &mt->bands[bandno];
+  struct jpeg_compress_struct winfo;
+  band_error_mgr jerr;
+  band_dest_mgr dest;
+  JOCTET FAR * p;
+  int i, restart_num;
+
+  winfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = band_error_exit;
+  jerr.pub.emit_message = band_emit_message;
+  jerr.band = band;
+  winfo.mem = NULL;
+  if (setjmp(jerr.setjmp_buffer)) {
+    jpeg_destroy_compress(&winfo);
+    return;
+  }
+  jpeg_create_compress(&winfo);
+
+  winfo.image_width = cinfo->image_width;
+  winfo.image_height = band->num_rows;
+  winfo.input_components = cinfo->input_components;
+  winfo.in_color_space = cinfo->in_color_space;
+  jpeg_set_defaults(&winfo);
+
+  /* Same compression parameters and tables as the application's object */
+  jpeg_set_colorspace(&winfo, cinfo->jpeg_color_space);
+  MEMCOPY(winfo.comp_info, cinfo->comp_info,
+	  cinfo->num_components * SIZEOF(jpeg_component_info));
+  for (i = 0; i < NUM_QUANT_TBLS; i++) {
+    if (cinfo->quant_tbl_ptrs[i] != NULL) {
+      if (winfo.quant_tbl_ptrs[i] == NULL)
+	winfo.quant_tbl_ptrs[i] = jpeg_alloc_quant_table((j_common_ptr) &winfo);
+      MEMCOPY(winfo.quant_tbl_ptrs[i], cinfo->quant_tbl_ptrs[i],
+	      SIZEOF(JQUANT_TBL));
+    }
+  }
+  for (i = 0; i < NUM_HUFF_TBLS; i++) {
+    if (cinfo->dc_huff_tbl_ptrs[i] != NULL) {
+      if (winfo.dc_huff_tbl_ptrs[i] == NULL)
+	winfo.dc_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr) &winfo);
+      MEMCOPY(winfo.dc_huff_tbl_ptrs[i], cinfo->dc_huff_tbl_ptrs[i],
+	      SIZEOF(JHUFF_TBL));
+    }
+    if (cinfo->ac_huff_tbl_ptrs[i] != NULL) {
+      if (winfo.ac_huff_tbl_ptrs[i] == NULL)
+	winfo.ac_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr) &winfo);
+      MEMCOPY(winfo.ac_huff_tbl_ptrs[i], cinfo->ac_huff_tbl_ptrs[i],
+	      SIZEOF(JHUFF_TBL));
+    }
+  }
+  winfo.input_gamma = cinfo->input_gamma;
+  winfo.scale_num = cinfo->scale_num;
+  winfo.scale_denom = cinfo->scale_denom;
+  winfo.data_precision = cinfo->data_precision;
+  winfo.CCIR601_sampling = cinfo->CCIR601_sampling;
+  winfo.do_fancy_downsampling = cinfo->do_fancy_downsampling;
+  winfo.dct_method = cinfo->dct_method;
+  winfo.restart_interval = cinfo->restart_interval;
+  winfo.write_JFIF_header = FALSE;
+  winfo.write_Adobe_marker = FALSE;
+  winfo.mem->max_memory_to_use = cinfo->mem->max_memory_to_use;
+
+  dest.pub.init_destination = init_band_destination;
+  dest.pub.empty_output_buffer = empty_band_buffer;
+  dest.pub.term_destination = term_band_destination;
+  dest.band = band;
+  winfo.dest = &dest.pub;
+
+  jpeg_start_compress(&winfo, FALSE);
+  /* Write the frame and scan headers now, to find where the data begins */
+  if (winfo.master->call_pass_startup)
+    (*winfo.master->pass_startup) (&winfo);
+  band->data_start = band->buffer_size - dest.pub.free_in_buffer;
+
+  while (winfo.next_scanline < winfo.image_height)
+    (void) jpeg_write_scanlines(&winfo, mt->scanlines + band->first_row +
+				winfo.next_scanline,
+				winfo.image_height - winfo.next_scanline);
+  jpeg_finish_compress(&winfo);
+  band->data_end = band->buffer_size - dest.pub.free_in_buffer - 2; /* EOI */
+
+  /* Renumber the RSTn markers; any other 0xFF is followed by a 0 */
+  restart_num = band->first_interval;
+  for (p = band->buffer + band->data_start;
+       p < band->buffer + band->data_end; p++) {
+    if (GETJOCTET(*p) == 0xFF && GETJOCTET(p[1]) != 0) {
+      p[1] = (JOCTET) (M_RST0 + (restart_num & 7));
+      restart_num++;
+      p++;
+    }
+  }
+
+  band->num_warnings = jerr.pub.num_warnings;
+  jpeg_destroy_compress(&winfo);
+}
+
+
+/*
+ * Write bytes to the application's data destination, which must not
+ * suspend.
+ */
+
+LOCAL(void)
+emit_bytes (j_compress_ptr cinfo, const JOCTET FAR * data, size_t length)
+{
+  struct jpeg_destination_mgr * dest = cinfo->dest;
+  size_t count;
+
+  while (length > 0) {
+    if (dest->free_in_buffer == 0) {
+      if (! (*dest->empty_output_buffer) (cinfo))
+	ERREXIT(cinfo, JERR_CANT_SUSPEND);
+    }
+    count = MIN(length, dest->free_in_buffer);
+    MEMCOPY(dest->next_output_byte, data, count * SIZEOF(JOCTET));
+    dest->next_output_byte += count;
+    dest->free_in_buffer -= count;
+    data += count;
+    length -= count;
+  }
+}
+
+
+/*
+ * Can the image be compressed in bands?  The application's object must be
+ * about to take the first row of a single-scan Huffman-coded image, without
+ * entropy optimization or input smoothing.  (Arithmetic coding would need
+ * its coder state ended in the application's object.)
+ */
+
+LOCAL(boolean)
+use_bands (j_compress_ptr cinfo)
+{
+  return cinfo->next_scanline == 0 && cinfo->master->call_pass_startup &&
+	 cinfo->scan_info == NULL && ! cinfo->arith_code &&
+	 ! cinfo->optimize_coding && ! cinfo->downsample->need_context_rows ?
+	 TRUE : FALSE;
+}
+
+
+/*
+ * Compress the image in bands on num_threads threads.
+ */
+
+LOCAL(void)
+encode_in_bands (j_compress_ptr cinfo, JSAMPARRAY scanlines,
+		 int num_threads)
+{
+  mt_encoder mt;
+  band_info * band;
+  JDIMENSION rows_per_iMCU, total_rows, r0, r1;
+  long mcus_per_iMCU, step, a, b, t;
+  int num_steps, failed = -1, i;
+  JOCTET marker[2];
+
+  mt.cinfo = cinfo;
+  mt.scanlines = scanlines;
+
+  mcus_per_iMCU = (long) cinfo->MCUs_per_row;
+  if (cinfo->comps_in_scan == 1)
+    mcus_per_iMCU *= cinfo->cur_comp_info[0]->v_samp_factor;
+  total_rows = cinfo->total_iMCU_rows;
+
+  /* Without a restart interval, make one per band */
+  if (cinfo->restart_interval == 0) {
+    t = ((long) total_rows + num_threads * BANDS_PER_THREAD - 1) /
+	(num_threads * BANDS_PER_THREAD);
+    t = MIN(t, 65535L / mcus_per_iMCU);
+    cinfo->restart_interval = (unsigned int) (t * mcus_per_iMCU);
+  }
+  /* Frame and scan headers, DRI included */
+  (*cinfo->master->pass_startup) (cinfo);
+
+  /* iMCU rows that begin a restart interval are multiples of step */
+  a = (long) cinfo->restart_interval;
+  b = mcus_per_iMCU;
+  while (b != 0) {		/* a = gcd(restart_interval, mcus_per_iMCU) */
+    t = a % b; a = b; b = t;
+  }
+  step = (long) cinfo->restart_interval / a;
+  num_steps = (int) ((total_rows + step - 1) / step);
+  rows_per_iMCU = (JDIMENSION)
+    (cinfo->max_v_samp_factor * cinfo->min_DCT_v_scaled_size);
+
+  mt.num_bands = num_threads * BANDS_PER_THREAD;
+  if (mt.num_bands > num_steps)
+    mt.num_bands = num_steps;
+  mt.bands = (band_info *) (*cinfo->mem->alloc_small)
+    ((j_common_ptr) cinfo, JPOOL_IMAGE, mt.num_bands * SIZEOF(band_info));
+  MEMZERO(mt.bands, mt.num_bands * SIZEOF(band_info));
+
+  for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+    r0 = (JDIMENSION) (step * ((long) i * num_steps / mt.num_bands));
+    r1 = (JDIMENSION) (step * ((long) (i + 1) * num_steps / mt.num_bands));
+    if (r1 > total_rows)
+      r1 = total_rows;
+    band->first_row = r0 * rows_per_iMCU;
+    band->num_rows = MIN(r1 * rows_per_iMCU, cinfo->image_height) -
+		     band->first_row;
+    band->first_interval = (int) ((long) r0 * mcus_per_iMCU /
+				  cinfo->restart_interval);
+  }
+
+  jthread_run(num_threads, mt.num_bands, encode_band, (void *) &mt);
+
+  /* Report warnings, then write the bands unless one failed */
+  for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+    if (band->failed) {
+      if (failed < 0)
+	failed = i;
+    } else if (band->num_warnings > 0) {
+      cinfo->err->msg_code = band->error.msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &band->error.msg_parm,
+	      SIZEOF(cinfo->err->msg_parm));
+      (*cinfo->err->emit_message) ((j_common_ptr) cinfo, -1);
+      cinfo->err->num_warnings += band->num_warnings - 1;
+    }
+  }
+  if (failed < 0) {
+    for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+      emit_bytes(cinfo, band->buffer + band->data_start,
+		 band->data_end - band->data_start);
+      if (i < mt.num_bands - 1) {
+	marker[0] = (JOCTET) 0xFF;
+	marker[1] = (JOCTET) (M_RST0 + ((band[1].first_interval - 1) & 7));
+	emit_bytes(cinfo, marker, 2);
+      }
+    }
+  }
+  for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+    if (band->buffer != NULL)
+      jpeg_free_large((j_common_ptr) cinfo, (void FAR *) band->buffer,
+		      band->buffer_size * SIZEOF(JOCTET));
+  }
+  if (failed >= 0) {
+    band = &mt.bands[failed];
+    cinfo->err->msg_code = band->error.msg_code;
+    MEMCOPY(&cinfo->err->msg_parm, &band->error.msg_parm,
+	    SIZEOF(cinfo->err->msg_parm));
+    (*cinfo->err->error_exit) ((j_common_ptr) cinfo);
+  }
+
+  cinfo->next_scanline = cinfo->image_height;
+}
+
+
+/*
+ * Write all remaining scanlines, on up to num_threads threads.
+ * scanlines[] has a pointer for every input row of the image.
+ *
+ * Single-scan Huffman-coded images are compressed in bands (see above)
+ * when num_threads > 1; if no restart interval was set, one is chosen,
+ * which jpeg_write_image_mt then writes in the DRI marker.  Anything else
+ * is written with jpeg_write_scanlines on the calling thread.  The data
+ * destination must not suspend.  Returns the number of scanlines written.
+ */
+
+GLOBAL(JDIMENSION)
+jpeg_write_image_mt (j_compress_ptr cinfo, JSAMPARRAY scanlines,
+		     int num_threads)
+{
+  JDIMENSION start_scanline = cinfo->next_scanline;
+
+  if (cinfo->global_state != CSTATE_SCANNING)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  if (num_threads > 1 && use_bands(cinfo))
+    encode_in_bands(cinfo, scanlines, num_threads);
+  else {
+    while (cinfo->next_scanline < cinfo->image_height) {
+      if (jpeg_write_scanlines(cinfo, scanlines + cinfo->next_scanline,
+			       cinfo->image_height -
+			       cinfo->next_scanline) == 0)
+	ERREXIT(cinfo, JERR_CANT_SUSPEND);
+    }
+  }
+
+  return cinfo->next_scanline - start_scanline;
+}
@@ -48,6 +48,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Pointer to routine to downsample a single component */
@@ -71,6 +72,9 @@ typedef struct {
    */
   UINT8 h_expand[MAX_COMPONENTS];
   UINT8 v_expand[MAX_COMPONENTS];
+
+  /* SIMD kernel for the leading samples of h2v2_downsample, or NULL */
+  jsimd_downsample_row_ptr h2v2_simd;
 } my_downsampler;
 
 typedef my_downsampler * my_downsample_ptr;
@@ -261,6 +265,7 @@ METHODDEF(void)
 h2v2_downsample (j_compress_ptr cinfo, jpeg_component_info * compptr,
 		 JSAMPARRAY input_data, JSAMPARRAY output_data)
 {
+  my_downsample_ptr downsample = (my_downsample_ptr) cinfo->downsample;
   int inrow, outrow;
   JDIMENSION outcol;
   JDIMENSION output_cols = compptr->width_in_blocks * compptr->DCT_h_scaled_size;
@@ -280,7 +285,13 @@ h2v2_downsample (j_compress_ptr cinfo, jpeg_component_info * compptr,
     inptr0 = input_data[inrow];
     inptr1 = input_data[inrow+1];
     bias = 1;			/* bias = 1,2,1,2,... for successive samples */
-    for (outcol = 0; outcol < output_cols; outcol++) {
+    outcol = 0;
+    if (downsample->h2v2_simd != NULL) {
+      outcol = (*downsample->h2v2_simd) (inptr0, inptr1, outptr, output_cols);
+      outptr += outcol;
+      inptr0 += 2 * outcol; inptr1 += 2 * outcol;
+    }
+    for (; outcol < output_cols; outcol++) {
       *outptr++ = (JSAMPLE) ((GETJSAMPLE(*inptr0) + GETJSAMPLE(inptr0[1]) +
 			      GETJSAMPLE(*inptr1) + GETJSAMPLE(inptr1[1])
 			      + bias) >> 2);
@@ -490,6 +501,7 @@ jinit_downsampler (j_compress_ptr cinfo)
   downsample->pub.start_pass = start_pass_downsample;
   downsample->pub.downsample = sep_downsample;
   downsample->pub.need_context_rows = FALSE;
+  downsample->h2v2_simd = jsimd_h2v2_downsample_method();
 
   if (cinfo->CCIR601_sampling)
     ERREXIT(cinfo, JERR_CCIR601_NOTIMPL);
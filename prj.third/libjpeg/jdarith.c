@@ -748,6 +748,7 @@ jinit_arith_decoder (j_decompress_ptr cinfo)
 				SIZEOF(arith_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *) entropy;
   entropy->pub.start_pass = start_pass;
+  entropy->pub.skip_mcus = NULL; /* skipped MCUs must be fully decoded */
 
   /* Mark tables unallocated */
   for (i = 0; i < NUM_ARITH_TBLS; i++) {
@@ -7,7 +7,8 @@
  * For conditions of distribution and use, see the accompanying README file.
  *
  * This file contains compression data destination routines for the case of
- * emitting JPEG data to memory or to a file (or any stdio stream).
+ * emitting JPEG data to memory or to a file (or any stdio stream),
+ * including a caller-owned buffer that is reused from image to image.
  * While these routines are sufficient for most applications,
  * some will want to use a different destination manager.
  * IMPORTANT: we assume that fwrite() will correctly transcribe an array of
@@ -22,6 +23,7 @@
 
 #ifndef HAVE_STDLIB_H		/* <stdlib.h> should declare malloc(),free() */
 extern void * malloc JPP((size_t size));
+extern void * realloc JPP((void *ptr, size_t size));
 extern void free JPP((void *ptr));
 #endif
 
@@ -55,6 +57,17 @@ typedef struct {
 typedef my_mem_destination_mgr * my_mem_dest_ptr;
 
 
+/* Expanded data destination object for a reusable output buffer */
+
+typedef struct {
+  struct jpeg_destination_mgr pub; /* public fields */
+
+  struct jpeg_out_buffer * outbuf; /* caller's buffer, kept across images */
+} my_buffer_destination_mgr;
+
+typedef my_buffer_destination_mgr * my_buffer_dest_ptr;
+
+
 /*
  * Initialize destination --- called by jpeg_start_compress
  * before any data is actually written.
@@ -80,6 +93,59 @@ init_mem_destination (j_compress_ptr cinfo)
   /* no work necessary here */
 }
 
+/*
+ * Rough upper bound of the compressed size, used to size the buffer of
+ * jpeg_buffer_dest before the first image: four bits per (downsampled)
+ * sample is rarely exceeded below quality 95, plus room for the tables.
+ * Sampling factors are final here, but the component dimensions are not
+ * computed yet, so work from the image size.
+ */
+
+LOCAL(size_t)
+estimate_output_size (j_compress_ptr cinfo)
+{
+  int ci, max_h = 1, max_v = 1;
+  double samples = 0.0;
+  jpeg_component_info * compptr;
+
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    if (max_h < compptr->h_samp_factor) max_h = compptr->h_samp_factor;
+    if (max_v < compptr->v_samp_factor) max_v = compptr->v_samp_factor;
+  }
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++)
+    samples += (double) cinfo->image_width * compptr->h_samp_factor / max_h *
+	       (double) cinfo->image_height * compptr->v_samp_factor / max_v;
+  return (size_t) (samples / 2) + 2048;
+}
+
+METHODDEF(void)
+init_buffer_destination (j_compress_ptr cinfo)
+{
+  my_buffer_dest_ptr dest = (my_buffer_dest_ptr) cinfo->dest;
+  struct jpeg_out_buffer * outbuf = dest->outbuf;
+  size_t needed;
+
+  /* The buffer only ever grows, so after the first few images of a series
+   * the estimate is met and nothing is allocated per image.
+   */
+  needed = estimate_output_size(cinfo);
+  if (outbuf->capacity < needed) {
+    /* nothing worth keeping in it, so don't let realloc copy it */
+    free(outbuf->data);
+    outbuf->capacity = 0;
+    outbuf->data = (JOCTET *) malloc(needed);
+    if (outbuf->data == NULL)
+      ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+    outbuf->capacity = needed;
+  }
+  outbuf->size = 0;
+
+  dest->pub.next_output_byte = outbuf->data;
+  dest->pub.free_in_buffer = outbuf->capacity;
+}
+
 
 /*
  * Empty the output buffer --- called whenever buffer fills up.
@@ -150,6 +216,34 @@ empty_mem_output_buffer (j_compress_ptr cinfo)
 }
 
 
+METHODDEF(boolean)
+empty_buffer_output_buffer (j_compress_ptr cinfo)
+{
+  my_buffer_dest_ptr dest = (my_buffer_dest_ptr) cinfo->dest;
+  struct jpeg_out_buffer * outbuf = dest->outbuf;
+  size_t used = outbuf->capacity;
+  size_t nextsize = used * 2;
+  JOCTET * nextbuffer;
+
+  /* The estimate was too low: double the buffer, keeping what's in it.
+   * On failure the old storage is still owned by outbuf.
+   */
+  if (nextsize <= used)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+  nextbuffer = (JOCTET *) realloc(outbuf->data, nextsize);
+  if (nextbuffer == NULL)
+    ERREXIT1(cinfo, JERR_OUT_OF_MEMORY, 10);
+
+  outbuf->data = nextbuffer;
+  outbuf->capacity = nextsize;
+
+  dest->pub.next_output_byte = nextbuffer + used;
+  dest->pub.free_in_buffer = nextsize - used;
+
+  return TRUE;
+}
+
+
 /*
  * Terminate destination --- called by jpeg_finish_compress
  * after all data has been written.  Usually needs to flush buffer.
@@ -185,6 +279,14 @@ term_mem_destination (j_compress_ptr cinfo)
   *dest->outsize = dest->bufsize - dest->pub.free_in_buffer;
 }
 
+METHODDEF(void)
+term_buffer_destination (j_compress_ptr cinfo)
+{
+  my_buffer_dest_ptr dest = (my_buffer_dest_ptr) cinfo->dest;
+
+  dest->outbuf->size = dest->outbuf->capacity - dest->pub.free_in_buffer;
+}
+
 
 /*
  * Prepare for output to a stdio stream.
@@ -265,3 +367,56 @@ jpeg_mem_dest (j_compress_ptr cinfo,
   dest->pub.next_output_byte = dest->buffer = *outbuffer;
   dest->pub.free_in_buffer = dest->bufsize = *outsize;
 }
+
+
+/*
+ * Prepare for output to a reusable buffer.
+ * The compressed data is written straight into outbuf->data, which is
+ * sized from an estimate at jpeg_start_compress and doubled when the
+ * estimate falls short; its length is in outbuf->size after
+ * jpeg_finish_compress.  Unlike jpeg_mem_dest, the storage stays with
+ * outbuf from one image to the next and is only ever grown, so encoding a
+ * series of images allocates nothing once the buffer is large enough.
+ * Zero-initialize outbuf before its first use and release it with
+ * jpeg_free_out_buffer.  outbuf->data is only valid until the next image
+ * is started with the same buffer.
+ */
+
+GLOBAL(void)
+jpeg_buffer_dest (j_compress_ptr cinfo, struct jpeg_out_buffer * outbuf)
+{
+  my_buffer_dest_ptr dest;
+
+  if (outbuf == NULL)		/* sanity check */
+    ERREXIT(cinfo, JERR_BUFFER_SIZE);
+
+  /* The destination object is made permanent so that multiple JPEG images
+   * can be written to the same buffer without re-executing jpeg_buffer_dest.
+   */
+  if (cinfo->dest == NULL) {	/* first time for this JPEG object? */
+    cinfo->dest = (struct jpeg_destination_mgr *)
+      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_PERMANENT,
+				  SIZEOF(my_buffer_destination_mgr));
+  }
+
+  dest = (my_buffer_dest_ptr) cinfo->dest;
+  dest->pub.init_destination = init_buffer_destination;
+  dest->pub.empty_output_buffer = empty_buffer_output_buffer;
+  dest->pub.term_destination = term_buffer_destination;
+  dest->outbuf = outbuf;
+}
+
+
+/*
+ * Release the storage of a buffer used with jpeg_buffer_dest.
+ * The buffer is left empty and may be used again.
+ */
+
+GLOBAL(void)
+jpeg_free_out_buffer (struct jpeg_out_buffer * outbuf)
+{
+  free(outbuf->data);
+  outbuf->data = NULL;
+  outbuf->size = 0;
+  outbuf->capacity = 0;
+}
@@ -7,7 +7,8 @@
  * For conditions of distribution and use, see the accompanying README file.
  *
  * This file contains decompression data source routines for the case of
- * reading JPEG data from memory or from a file (or any stdio stream).
+ * reading JPEG data from memory or from a file (or any stdio stream),
+ * and a helper that maps a whole file into memory for jpeg_mem_src.
  * While these routines are sufficient for most applications,
  * some will want to use a different source manager.
  * IMPORTANT: we assume that fread() will correctly transcribe an array of
@@ -16,6 +17,16 @@
  */
 
 /* this is not a core library module, so it doesn't define JPEG_INTERNALS */
+#ifdef _WIN32
+#include <windows.h>		/* first: jmorecfg.h must see basetsd.h's INT32 */
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jerror.h"
@@ -121,7 +132,8 @@ fill_input_buffer (j_decompress_ptr cinfo)
 METHODDEF(boolean)
 fill_mem_input_buffer (j_decompress_ptr cinfo)
 {
-  static JOCTET mybuffer[4];
+  /* Read-only, so that objects decoding on different threads can share it */
+  static const JOCTET fake_eoi[2] = { (JOCTET) 0xFF, (JOCTET) JPEG_EOI };
 
   /* The whole JPEG data is expected to reside in the supplied memory
    * buffer, so any request for more data beyond the given buffer size
@@ -129,10 +141,7 @@ fill_mem_input_buffer (j_decompress_ptr cinfo)
    */
   WARNMS(cinfo, JWRN_JPEG_EOF);
   /* Insert a fake EOI marker */
-  mybuffer[0] = (JOCTET) 0xFF;
-  mybuffer[1] = (JOCTET) JPEG_EOI;
-
-  cinfo->src->next_input_byte = mybuffer;
+  cinfo->src->next_input_byte = fake_eoi;
   cinfo->src->bytes_in_buffer = 2;
 
   return TRUE;
@@ -242,6 +251,9 @@ jpeg_stdio_src (j_decompress_ptr cinfo, FILE * infile)
 /*
  * Prepare for input from a supplied memory buffer.
  * The buffer must contain the whole JPEG data.
+ * The data is decoded in place and never copied, so the buffer (a file
+ * mapped by jpeg_map_file, for instance) must stay valid until decompression
+ * is finished.  The library does not write to it.
  */
 
 GLOBAL(void)
@@ -272,3 +284,90 @@ jpeg_mem_src (j_decompress_ptr cinfo,
   src->bytes_in_buffer = (size_t) insize;
   src->next_input_byte = (JOCTET *) inbuffer;
 }
+
+
+/*
+ * Map a whole file read-only into memory, to be decoded in place with
+ * jpeg_mem_src (map->data, map->size).  The pages are read on demand by
+ * the OS, so no input buffer is filled and no data is copied.
+ * Returns FALSE if the file can't be opened or mapped (an empty file
+ * can't be mapped either); the caller may then fall back to stdio.
+ * The mapping does not depend on any JPEG object and may be shared by
+ * several of them; release it with jpeg_unmap_file.
+ */
+
+GLOBAL(boolean)
+jpeg_map_file (struct jpeg_file_map * map, const char * filename)
+{
+#ifdef _WIN32
+  HANDLE file, mapping;
+  LARGE_INTEGER size;
+  void * view = NULL;
+
+  map->data = NULL;
+  map->size = 0;
+  file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		     OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return FALSE;
+  if (GetFileSizeEx(file, &size) && size.QuadPart > 0 &&
+      (LONGLONG) (unsigned long) size.QuadPart == size.QuadPart &&
+      (LONGLONG) (SIZE_T) size.QuadPart == size.QuadPart) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);	/* the view keeps the mapping alive */
+    }
+  }
+  CloseHandle(file);
+  if (view == NULL)
+    return FALSE;
+  map->data = (unsigned char *) view;
+  map->size = (unsigned long) size.QuadPart;
+  return TRUE;
+#else
+  int fd;
+  struct stat st;
+  void * view = MAP_FAILED;
+
+  map->data = NULL;
+  map->size = 0;
+  fd = open(filename, O_RDONLY);
+  if (fd < 0)
+    return FALSE;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+      (off_t) (unsigned long) st.st_size == st.st_size &&
+      (off_t) (size_t) st.st_size == st.st_size)
+    view = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);			/* the mapping keeps the file alive */
+  if (view == MAP_FAILED)
+    return FALSE;
+#ifdef MADV_SEQUENTIAL
+  /* the decoder reads front to back: ask for aggressive read-ahead */
+  (void) madvise(view, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+  map->data = (unsigned char *) view;
+  map->size = (unsigned long) st.st_size;
+  return TRUE;
+#endif
+}
+
+
+/*
+ * Release a mapping made by jpeg_map_file.  Safe to call on a map whose
+ * jpeg_map_file call failed, and to call twice.
+ */
+
+GLOBAL(void)
+jpeg_unmap_file (struct jpeg_file_map * map)
+{
+  if (map->data != NULL) {
+#ifdef _WIN32
+    UnmapViewOfFile(map->data);
+#else
+    munmap(map->data, (size_t) map->size);
+#endif
+  }
+  map->data = NULL;
+  map->size = 0;
+}
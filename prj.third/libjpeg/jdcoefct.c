@@ -36,6 +36,13 @@ typedef struct {
 
   /* The output side's location is represented by cinfo->output_iMCU_row. */
 
+  /* The region of interest set by jpeg_crop_output, in iMCU columns and rows,
+   * and its columns in MCUs of the current scan.
+   */
+  JDIMENSION first_iMCU_col, last_iMCU_col;
+  JDIMENSION first_iMCU_row, last_iMCU_row;
+  JDIMENSION first_MCU_col, last_MCU_col;
+
   /* In single-pass modes, it's sufficient to buffer just one MCU.
    * We allocate a workspace of D_MAX_BLOCKS_IN_MCU coefficient blocks,
    * and let the entropy decoder write into that workspace each time.
@@ -64,6 +71,8 @@ typedef my_coef_controller * my_coef_ptr;
 /* Forward declarations */
 METHODDEF(int) decompress_onepass
 	JPP((j_decompress_ptr cinfo, JSAMPIMAGE output_buf));
+METHODDEF(int) decompress_onepass_crop
+	JPP((j_decompress_ptr cinfo, JSAMPIMAGE output_buf));
 #ifdef D_MULTISCAN_FILES_SUPPORTED
 METHODDEF(int) decompress_data
 	JPP((j_decompress_ptr cinfo, JSAMPIMAGE output_buf));
@@ -106,6 +115,21 @@ start_iMCU_row (j_decompress_ptr cinfo)
 METHODDEF(void)
 start_input_pass (j_decompress_ptr cinfo)
 {
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  jpeg_component_info *compptr;
+
+  /* In a noninterleaved scan, an iMCU column has h_samp_factor MCUs */
+  if (cinfo->comps_in_scan > 1) {
+    coef->first_MCU_col = coef->first_iMCU_col;
+    coef->last_MCU_col = coef->last_iMCU_col;
+  } else {
+    compptr = cinfo->cur_comp_info[0];
+    coef->first_MCU_col = coef->first_iMCU_col * compptr->h_samp_factor;
+    coef->last_MCU_col = (coef->last_iMCU_col + 1) * compptr->h_samp_factor - 1;
+    if (coef->last_MCU_col >= cinfo->MCUs_per_row)
+      coef->last_MCU_col = cinfo->MCUs_per_row - 1;
+  }
+
   cinfo->input_iMCU_row = 0;
   start_iMCU_row(cinfo);
 }
@@ -118,9 +142,9 @@ start_input_pass (j_decompress_ptr cinfo)
 METHODDEF(void)
 start_output_pass (j_decompress_ptr cinfo)
 {
-#ifdef BLOCK_SMOOTHING_SUPPORTED
   my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
 
+#ifdef BLOCK_SMOOTHING_SUPPORTED
   /* If multipass, check to see whether to use block smoothing on this pass */
   if (coef->pub.coef_arrays != NULL) {
     if (cinfo->do_block_smoothing && smoothing_ok(cinfo))
@@ -129,7 +153,60 @@ start_output_pass (j_decompress_ptr cinfo)
       coef->pub.decompress_data = decompress_data;
   }
 #endif
-  cinfo->output_iMCU_row = 0;
+  cinfo->output_iMCU_row = coef->first_iMCU_row;
+}
+
+
+/*
+ * Do the IDCT thing for the MCU just decoded into MCU_buffer, which is at
+ * MCU_col_num of MCU row yoffset and goes to start_col onwards (in MCUs)
+ * in output_buf.
+ * We skip dummy blocks at the right and bottom edges (but blkn gets
+ * incremented past them!).  Note the inner loop relies on having
+ * allocated the MCU_buffer[] blocks sequentially.
+ */
+
+LOCAL(void)
+decompress_MCU (j_decompress_ptr cinfo, JSAMPIMAGE output_buf,
+		int yoffset, JDIMENSION MCU_col_num, JDIMENSION start_col)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION last_MCU_col = cinfo->MCUs_per_row - 1;
+  JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
+  int blkn, ci, xindex, yindex, useful_width;
+  JSAMPARRAY output_ptr;
+  JDIMENSION output_col;
+  jpeg_component_info *compptr;
+  inverse_DCT_method_ptr inverse_DCT;
+
+  blkn = 0;			/* index of current DCT block within MCU */
+  for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
+    compptr = cinfo->cur_comp_info[ci];
+    /* Don't bother to IDCT an uninteresting component. */
+    if (! compptr->component_needed) {
+      blkn += compptr->MCU_blocks;
+      continue;
+    }
+    inverse_DCT = cinfo->idct->inverse_DCT[compptr->component_index];
+    useful_width = (MCU_col_num < last_MCU_col) ? compptr->MCU_width
+						: compptr->last_col_width;
+    output_ptr = output_buf[compptr->component_index] +
+      yoffset * compptr->DCT_v_scaled_size;
+    for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
+      if (cinfo->input_iMCU_row < last_iMCU_row ||
+	  yoffset+yindex < compptr->last_row_height) {
+	output_col = start_col * compptr->MCU_sample_width;
+	for (xindex = 0; xindex < useful_width; xindex++) {
+	  (*inverse_DCT) (cinfo, compptr,
+			  (JCOEFPTR) coef->MCU_buffer[blkn+xindex],
+			  output_ptr, output_col);
+	  output_col += compptr->DCT_h_scaled_size;
+	}
+      }
+      blkn += compptr->MCU_width;
+      output_ptr += compptr->DCT_v_scaled_size;
+    }
+  }
 }
 
 
@@ -149,12 +226,7 @@ decompress_onepass (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
   my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
   JDIMENSION MCU_col_num;	/* index of current MCU within row */
   JDIMENSION last_MCU_col = cinfo->MCUs_per_row - 1;
-  JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
-  int blkn, ci, xindex, yindex, yoffset, useful_width;
-  JSAMPARRAY output_ptr;
-  JDIMENSION start_col, output_col;
-  jpeg_component_info *compptr;
-  inverse_DCT_method_ptr inverse_DCT;
+  int yoffset;
 
   /* Loop to process as much as one whole iMCU row */
   for (yoffset = coef->MCU_vert_offset; yoffset < coef->MCU_rows_per_iMCU_row;
@@ -170,40 +242,8 @@ decompress_onepass (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 	coef->MCU_ctr = MCU_col_num;
 	return JPEG_SUSPENDED;
       }
-      /* Determine where data should go in output_buf and do the IDCT thing.
-       * We skip dummy blocks at the right and bottom edges (but blkn gets
-       * incremented past them!).  Note the inner loop relies on having
-       * allocated the MCU_buffer[] blocks sequentially.
-       */
-      blkn = 0;			/* index of current DCT block within MCU */
-      for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
-	compptr = cinfo->cur_comp_info[ci];
-	/* Don't bother to IDCT an uninteresting component. */
-	if (! compptr->component_needed) {
-	  blkn += compptr->MCU_blocks;
-	  continue;
-	}
-	inverse_DCT = cinfo->idct->inverse_DCT[compptr->component_index];
-	useful_width = (MCU_col_num < last_MCU_col) ? compptr->MCU_width
-						    : compptr->last_col_width;
-	output_ptr = output_buf[compptr->component_index] +
-	  yoffset * compptr->DCT_v_scaled_size;
-	start_col = MCU_col_num * compptr->MCU_sample_width;
-	for (yindex = 0; yindex < compptr->MCU_height; yindex++) {
-	  if (cinfo->input_iMCU_row < last_iMCU_row ||
-	      yoffset+yindex < compptr->last_row_height) {
-	    output_col = start_col;
-	    for (xindex = 0; xindex < useful_width; xindex++) {
-	      (*inverse_DCT) (cinfo, compptr,
-			      (JCOEFPTR) coef->MCU_buffer[blkn+xindex],
-			      output_ptr, output_col);
-	      output_col += compptr->DCT_h_scaled_size;
-	    }
-	  }
-	  blkn += compptr->MCU_width;
-	  output_ptr += compptr->DCT_v_scaled_size;
-	}
-      }
+      /* Determine where data should go in output_buf and do the IDCT */
+      decompress_MCU(cinfo, output_buf, yoffset, MCU_col_num, MCU_col_num);
     }
     /* Completed an MCU row, but perhaps not an iMCU row */
     coef->MCU_ctr = 0;
@@ -220,6 +260,141 @@ decompress_onepass (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 }
 
 
+/*
+ * Skip count MCUs of a single-pass scan, which are outside the region of
+ * interest.  Returns the number skipped, which is less than count only if
+ * the data source requested suspension.
+ */
+
+LOCAL(JDIMENSION)
+skip_MCUs (j_decompress_ptr cinfo, JDIMENSION count)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION done;
+
+  if (cinfo->entropy->skip_mcus != NULL)
+    return (*cinfo->entropy->skip_mcus) (cinfo, count);
+  /* Else decode them in full, into a buffer nobody looks at */
+  for (done = 0; done < count; done++) {
+    if (! (*cinfo->entropy->decode_mcu) (cinfo, coef->MCU_buffer))
+      break;
+  }
+  return done;
+}
+
+
+/*
+ * Count the MCUs from the input position up to the next one in the region
+ * of interest, or up to the end of the scan if the region is done.
+ */
+
+LOCAL(JDIMENSION)
+MCUs_to_skip (j_decompress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION MCU_rows_per_iMCU, MCU_row, next_MCU;
+
+  /* Here we need the full count for an iMCU row, not what start_iMCU_row
+   * keeps for the current one.
+   */
+  MCU_rows_per_iMCU = (cinfo->comps_in_scan > 1) ? 1 :
+    (JDIMENSION) cinfo->cur_comp_info[0]->v_samp_factor;
+  MCU_row = cinfo->input_iMCU_row * MCU_rows_per_iMCU + coef->MCU_vert_offset;
+
+  if (cinfo->input_iMCU_row < coef->first_iMCU_row)
+    /* Above the region */
+    next_MCU = coef->first_iMCU_row * MCU_rows_per_iMCU * cinfo->MCUs_per_row +
+	       coef->first_MCU_col;
+  else if (coef->MCU_ctr < coef->first_MCU_col)
+    /* Left of the region */
+    next_MCU = MCU_row * cinfo->MCUs_per_row + coef->first_MCU_col;
+  else if (MCU_row + 1 < (coef->last_iMCU_row + 1) * MCU_rows_per_iMCU &&
+	   MCU_row + 1 < cinfo->MCU_rows_in_scan)
+    /* Right of the region, which goes on in the next MCU row */
+    next_MCU = (MCU_row + 1) * cinfo->MCUs_per_row + coef->first_MCU_col;
+  else
+    /* Past the end of the region */
+    next_MCU = cinfo->MCU_rows_in_scan * cinfo->MCUs_per_row;
+
+  return next_MCU - (MCU_row * cinfo->MCUs_per_row + coef->MCU_ctr);
+}
+
+
+/*
+ * Move the input side count MCUs on, across MCU rows and iMCU rows.
+ * Returns TRUE if that reached the end of the scan.
+ */
+
+LOCAL(boolean)
+advance_MCUs (j_decompress_ptr cinfo, JDIMENSION count)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION MCU_ctr = coef->MCU_ctr + count;
+
+  while (MCU_ctr >= cinfo->MCUs_per_row) {
+    MCU_ctr -= cinfo->MCUs_per_row;
+    if (++(coef->MCU_vert_offset) >= coef->MCU_rows_per_iMCU_row) {
+      if (++(cinfo->input_iMCU_row) >= cinfo->total_iMCU_rows) {
+	(*cinfo->inputctl->finish_input_pass) (cinfo);
+	return TRUE;
+      }
+      start_iMCU_row(cinfo);
+    }
+  }
+  coef->MCU_ctr = MCU_ctr;
+  return FALSE;
+}
+
+
+/*
+ * Variant of decompress_onepass for a region of interest.
+ * The MCUs of the region are decoded and IDCTed as usual, and the input
+ * side then skips on to the next one; the first call also skips all the
+ * iMCU rows above the region.  An iMCU row is complete after its last MCU
+ * in the region, so the MCUs right of the region are skipped at the start
+ * of the next call, together with those left of it in the next MCU row.
+ */
+
+METHODDEF(int)
+decompress_onepass_crop (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION count, done;
+  boolean row_done;
+
+  for (;;) {
+    if (cinfo->input_iMCU_row < coef->first_iMCU_row ||
+	coef->MCU_ctr < coef->first_MCU_col ||
+	coef->MCU_ctr > coef->last_MCU_col) {
+      count = MCUs_to_skip(cinfo);
+      done = skip_MCUs(cinfo, count);
+      if (advance_MCUs(cinfo, done))
+	return JPEG_SCAN_COMPLETED;
+      if (done < count)
+	return JPEG_SUSPENDED;
+      continue;
+    }
+    /* Try to fetch an MCU.  Entropy decoder expects buffer to be zeroed. */
+    jzero_far((void FAR *) coef->MCU_buffer[0],
+	      (size_t) (cinfo->blocks_in_MCU * SIZEOF(JBLOCK)));
+    if (! (*cinfo->entropy->decode_mcu) (cinfo, coef->MCU_buffer))
+      return JPEG_SUSPENDED;	/* the input position is still this MCU */
+    decompress_MCU(cinfo, output_buf, coef->MCU_vert_offset, coef->MCU_ctr,
+		   coef->MCU_ctr - coef->first_MCU_col);
+    row_done = (coef->MCU_ctr == coef->last_MCU_col &&
+		coef->MCU_vert_offset == coef->MCU_rows_per_iMCU_row - 1);
+    if (advance_MCUs(cinfo, (JDIMENSION) 1)) {
+      cinfo->output_iMCU_row++;
+      return JPEG_SCAN_COMPLETED;
+    }
+    if (row_done) {
+      cinfo->output_iMCU_row++;
+      return JPEG_ROW_COMPLETED;
+    }
+  }
+}
+
+
 /*
  * Dummy consume-input routine for single-pass operation.
  */
@@ -231,6 +406,28 @@ dummy_consume_data (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Consume-input routine for single-pass operation with a region of
+ * interest.  Once the region's last iMCU row has been output, this lets
+ * jpeg_finish_decompress skip the rest of the scan.
+ */
+
+METHODDEF(int)
+consume_rest_of_scan (j_decompress_ptr cinfo)
+{
+  my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
+  JDIMENSION count, done;
+
+  if (cinfo->output_iMCU_row <= coef->last_iMCU_row)
+    return JPEG_SUSPENDED;	/* output side is still using the scan */
+  count = MCUs_to_skip(cinfo);
+  done = skip_MCUs(cinfo, count);
+  if (advance_MCUs(cinfo, done))
+    return JPEG_SCAN_COMPLETED;
+  return JPEG_SUSPENDED;
+}
+
+
 #ifdef D_MULTISCAN_FILES_SUPPORTED
 
 /*
@@ -316,7 +513,7 @@ decompress_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 {
   my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
   JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
-  JDIMENSION block_num;
+  JDIMENSION block_num, first_block, end_block;
   int ci, block_row, block_rows;
   JBLOCKARRAY buffer;
   JBLOCKROW buffer_ptr;
@@ -352,13 +549,18 @@ decompress_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
       block_rows = (int) (compptr->height_in_blocks % compptr->v_samp_factor);
       if (block_rows == 0) block_rows = compptr->v_samp_factor;
     }
+    /* Columns of blocks in the region of interest */
+    first_block = coef->first_iMCU_col * compptr->h_samp_factor;
+    end_block = (coef->last_iMCU_col + 1) * compptr->h_samp_factor;
+    if (end_block > compptr->width_in_blocks)
+      end_block = compptr->width_in_blocks;
     inverse_DCT = cinfo->idct->inverse_DCT[ci];
     output_ptr = output_buf[ci];
     /* Loop over all DCT blocks to be processed. */
     for (block_row = 0; block_row < block_rows; block_row++) {
-      buffer_ptr = buffer[block_row];
+      buffer_ptr = buffer[block_row] + first_block;
       output_col = 0;
-      for (block_num = 0; block_num < compptr->width_in_blocks; block_num++) {
+      for (block_num = first_block; block_num < end_block; block_num++) {
 	(*inverse_DCT) (cinfo, compptr, (JCOEFPTR) buffer_ptr,
 			output_ptr, output_col);
 	buffer_ptr++;
@@ -462,7 +664,7 @@ decompress_smooth_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 {
   my_coef_ptr coef = (my_coef_ptr) cinfo->coef;
   JDIMENSION last_iMCU_row = cinfo->total_iMCU_rows - 1;
-  JDIMENSION block_num, last_block_column;
+  JDIMENSION block_num, last_block_column, first_block, end_block;
   int ci, block_row, block_rows, access_rows;
   JBLOCKARRAY buffer;
   JBLOCKROW buffer_ptr, prev_block_row, next_block_row;
@@ -537,6 +739,12 @@ decompress_smooth_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
     Q20 = quanttbl->quantval[Q20_POS];
     Q11 = quanttbl->quantval[Q11_POS];
     Q02 = quanttbl->quantval[Q02_POS];
+    /* Columns of blocks in the region of interest */
+    first_block = coef->first_iMCU_col * compptr->h_samp_factor;
+    end_block = (coef->last_iMCU_col + 1) * compptr->h_samp_factor;
+    if (end_block > compptr->width_in_blocks)
+      end_block = compptr->width_in_blocks;
+    last_block_column = compptr->width_in_blocks - 1;
     inverse_DCT = cinfo->idct->inverse_DCT[ci];
     output_ptr = output_buf[ci];
     /* Loop over all DCT blocks to be processed. */
@@ -550,15 +758,23 @@ decompress_smooth_data (j_decompress_ptr cinfo, JSAMPIMAGE output_buf)
 	next_block_row = buffer_ptr;
       else
 	next_block_row = buffer[block_row+1];
+      buffer_ptr += first_block;
+      prev_block_row += first_block;
+      next_block_row += first_block;
       /* We fetch the surrounding DC values using a sliding-register approach.
        * Initialize all nine here so as to do the right thing on narrow pics.
        */
       DC1 = DC2 = DC3 = (int) prev_block_row[0][0];
       DC4 = DC5 = DC6 = (int) buffer_ptr[0][0];
       DC7 = DC8 = DC9 = (int) next_block_row[0][0];
+      if (first_block > 0) {
+	/* A region of interest has its left neighbors in the image */
+	DC1 = (int) prev_block_row[-1][0];
+	DC4 = (int) buffer_ptr[-1][0];
+	DC7 = (int) next_block_row[-1][0];
+      }
       output_col = 0;
-      last_block_column = compptr->width_in_blocks - 1;
-      for (block_num = 0; block_num <= last_block_column; block_num++) {
+      for (block_num = first_block; block_num < end_block; block_num++) {
 	/* Fetch current DCT block into workspace so we can modify it. */
 	jcopy_block_row(buffer_ptr, (JBLOCKROW) workspace, (JDIMENSION) 1);
 	/* Update DC values */
@@ -687,6 +903,27 @@ jinit_d_coef_controller (j_decompress_ptr cinfo, boolean need_full_buffer)
   coef->coef_bits_latch = NULL;
 #endif
 
+  /* Locate the region of interest, if any, on the iMCU grid */
+  if (cinfo->crop_width != 0) {
+    JDIMENSION iMCU_width = (JDIMENSION)
+      (cinfo->max_h_samp_factor * cinfo->min_DCT_h_scaled_size);
+    JDIMENSION iMCU_height = (JDIMENSION)
+      (cinfo->max_v_samp_factor * cinfo->min_DCT_v_scaled_size);
+
+    coef->first_iMCU_col = cinfo->crop_x / iMCU_width;
+    coef->last_iMCU_col = (cinfo->crop_x + cinfo->crop_width - 1) / iMCU_width;
+    coef->first_iMCU_row = cinfo->crop_y / iMCU_height;
+    coef->last_iMCU_row = (cinfo->crop_y + cinfo->crop_height - 1) /
+			  iMCU_height;
+  } else {
+    coef->first_iMCU_col = 0;
+    coef->last_iMCU_col = (JDIMENSION)
+      jdiv_round_up((long) cinfo->image_width,
+		    (long) (cinfo->max_h_samp_factor * cinfo->block_size)) - 1;
+    coef->first_iMCU_row = 0;
+    coef->last_iMCU_row = cinfo->total_iMCU_rows - 1;
+  }
+
   /* Create the coefficient buffer. */
   if (need_full_buffer) {
 #ifdef D_MULTISCAN_FILES_SUPPORTED
@@ -729,8 +966,13 @@ jinit_d_coef_controller (j_decompress_ptr cinfo, boolean need_full_buffer)
     for (i = 0; i < D_MAX_BLOCKS_IN_MCU; i++) {
       coef->MCU_buffer[i] = buffer + i;
     }
-    coef->pub.consume_data = dummy_consume_data;
-    coef->pub.decompress_data = decompress_onepass;
+    if (cinfo->crop_width != 0) {
+      coef->pub.consume_data = consume_rest_of_scan;
+      coef->pub.decompress_data = decompress_onepass_crop;
+    } else {
+      coef->pub.consume_data = dummy_consume_data;
+      coef->pub.decompress_data = decompress_onepass;
+    }
     coef->pub.coef_arrays = NULL; /* flag for no virtual arrays */
   }
 }
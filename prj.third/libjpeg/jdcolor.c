@@ -11,6 +11,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 
 /* Private subobject */
@@ -23,6 +24,12 @@ typedef struct {
   int * Cb_b_tab;		/* => table for Cb to B conversion */
   INT32 * Cr_g_tab;		/* => table for Cr to G conversion */
   INT32 * Cb_g_tab;		/* => table for Cb to G conversion */
+  jsimd_ycc_row_ptr simd_row;	/* SIMD kernel for leading pixels, or NULL */
+
+  /* Pixel layout of JCS_RGB, JCS_EXT_BGR and JCS_EXT_BGRA output */
+  int red, green, blue;		/* offsets of the colour samples */
+  int alpha;			/* offset of the MAXJSAMPLE filler, or -1 */
+  int pixelsize;
 } my_color_deconverter;
 
 typedef my_color_deconverter * my_cconvert_ptr;
@@ -133,6 +140,8 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
   register int * Cbbtab = cconvert->Cb_b_tab;
   register INT32 * Crgtab = cconvert->Cr_g_tab;
   register INT32 * Cbgtab = cconvert->Cb_g_tab;
+  int red = cconvert->red, green = cconvert->green, blue = cconvert->blue;
+  int alpha = cconvert->alpha, pixelsize = cconvert->pixelsize;
   SHIFT_TEMPS
 
   while (--num_rows >= 0) {
@@ -141,17 +150,25 @@ ycc_rgb_convert (j_decompress_ptr cinfo,
     inptr2 = input_buf[2][input_row];
     input_row++;
     outptr = *output_buf++;
-    for (col = 0; col < num_cols; col++) {
+    col = 0;
+    if (cconvert->simd_row != NULL) {
+      col = (*cconvert->simd_row) (inptr0, inptr1, inptr2, outptr, num_cols,
+				   cinfo->out_color_space);
+      outptr += col * pixelsize;
+    }
+    for (; col < num_cols; col++) {
       y  = GETJSAMPLE(inptr0[col]);
       cb = GETJSAMPLE(inptr1[col]);
       cr = GETJSAMPLE(inptr2[col]);
       /* Range-limiting is essential due to noise introduced by DCT losses. */
-      outptr[RGB_RED] =   range_limit[y + Crrtab[cr]];
-      outptr[RGB_GREEN] = range_limit[y +
+      outptr[red] =   range_limit[y + Crrtab[cr]];
+      outptr[green] = range_limit[y +
 			      ((int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr],
 						 SCALEBITS))];
-      outptr[RGB_BLUE] =  range_limit[y + Cbbtab[cb]];
-      outptr += RGB_PIXELSIZE;
+      outptr[blue] =  range_limit[y + Cbbtab[cb]];
+      if (alpha >= 0)
+	outptr[alpha] = MAXJSAMPLE;
+      outptr += pixelsize;
     }
   }
 }
@@ -218,17 +235,57 @@ gray_rgb_convert (j_decompress_ptr cinfo,
 		  JSAMPIMAGE input_buf, JDIMENSION input_row,
 		  JSAMPARRAY output_buf, int num_rows)
 {
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
   register JSAMPROW inptr, outptr;
   register JDIMENSION col;
   JDIMENSION num_cols = cinfo->output_width;
+  int red = cconvert->red, green = cconvert->green, blue = cconvert->blue;
+  int alpha = cconvert->alpha, pixelsize = cconvert->pixelsize;
 
   while (--num_rows >= 0) {
     inptr = input_buf[0][input_row++];
     outptr = *output_buf++;
     for (col = 0; col < num_cols; col++) {
       /* We can dispense with GETJSAMPLE() here */
-      outptr[RGB_RED] = outptr[RGB_GREEN] = outptr[RGB_BLUE] = inptr[col];
-      outptr += RGB_PIXELSIZE;
+      outptr[red] = outptr[green] = outptr[blue] = inptr[col];
+      if (alpha >= 0)
+	outptr[alpha] = MAXJSAMPLE;
+      outptr += pixelsize;
+    }
+  }
+}
+
+
+/*
+ * Reorder RGB to another layout of the RGB colorspace.
+ */
+
+METHODDEF(void)
+rgb_rgb_convert (j_decompress_ptr cinfo,
+		 JSAMPIMAGE input_buf, JDIMENSION input_row,
+		 JSAMPARRAY output_buf, int num_rows)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+  register JSAMPROW inptr0, inptr1, inptr2, outptr;
+  register JDIMENSION col;
+  JDIMENSION num_cols = cinfo->output_width;
+  int red = cconvert->red, green = cconvert->green, blue = cconvert->blue;
+  int alpha = cconvert->alpha, pixelsize = cconvert->pixelsize;
+
+  while (--num_rows >= 0) {
+    inptr0 = input_buf[0][input_row];
+    inptr1 = input_buf[1][input_row];
+    inptr2 = input_buf[2][input_row];
+    input_row++;
+    outptr = *output_buf++;
+    for (col = 0; col < num_cols; col++) {
+      /* We can dispense with GETJSAMPLE() here */
+      outptr[red] = inptr0[col];
+      outptr[green] = inptr1[col];
+      outptr[blue] = inptr2[col];
+      if (alpha >= 0)
+	outptr[alpha] = MAXJSAMPLE;
+      outptr += pixelsize;
     }
   }
 }
@@ -296,6 +353,35 @@ start_pass_dcolor (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Set up the pixel layout for RGB-family output.
+ */
+
+LOCAL(void)
+set_rgb_layout (j_decompress_ptr cinfo)
+{
+  my_cconvert_ptr cconvert = (my_cconvert_ptr) cinfo->cconvert;
+
+  switch (cinfo->out_color_space) {
+  case JCS_EXT_BGR:
+  case JCS_EXT_BGRA:
+    cconvert->red = 2;
+    cconvert->green = 1;
+    cconvert->blue = 0;
+    cconvert->alpha = cinfo->out_color_space == JCS_EXT_BGRA ? 3 : -1;
+    cconvert->pixelsize = cinfo->out_color_space == JCS_EXT_BGRA ? 4 : 3;
+    break;
+  default:
+    cconvert->red = RGB_RED;
+    cconvert->green = RGB_GREEN;
+    cconvert->blue = RGB_BLUE;
+    cconvert->alpha = -1;	/* extra samples of RGB_PIXELSIZE are left alone */
+    cconvert->pixelsize = RGB_PIXELSIZE;
+    break;
+  }
+}
+
+
 /*
  * Module initialization routine for output colorspace conversion.
  */
@@ -311,6 +397,7 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
 				SIZEOF(my_color_deconverter));
   cinfo->cconvert = (struct jpeg_color_deconverter *) cconvert;
   cconvert->pub.start_pass = start_pass_dcolor;
+  cconvert->simd_row = NULL;
 
   /* Make sure num_components agrees with jpeg_color_space */
   switch (cinfo->jpeg_color_space) {
@@ -356,14 +443,22 @@ jinit_color_deconverter (j_decompress_ptr cinfo)
     break;
 
   case JCS_RGB:
-    cinfo->out_color_components = RGB_PIXELSIZE;
+  case JCS_EXT_BGR:
+  case JCS_EXT_BGRA:
+    set_rgb_layout(cinfo);
+    cinfo->out_color_components = cconvert->pixelsize;
     if (cinfo->jpeg_color_space == JCS_YCbCr) {
       cconvert->pub.color_convert = ycc_rgb_convert;
+      cconvert->simd_row = jsimd_ycc_rgb_method(cinfo->out_color_space);
       build_ycc_rgb_table(cinfo);
     } else if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
       cconvert->pub.color_convert = gray_rgb_convert;
-    } else if (cinfo->jpeg_color_space == JCS_RGB && RGB_PIXELSIZE == 3) {
-      cconvert->pub.color_convert = null_convert;
+    } else if (cinfo->jpeg_color_space == JCS_RGB) {
+      if (cinfo->out_color_space == JCS_RGB && RGB_PIXELSIZE == 3 &&
+	  RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2)
+	cconvert->pub.color_convert = null_convert;
+      else
+	cconvert->pub.color_convert = rgb_rgb_convert;
     } else
       ERREXIT(cinfo, JERR_CONVERSION_NOTIMPL);
     break;
@@ -0,0 +1,325 @@
+/*
+ * jdcolsimd.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SSSE3 and NEON row kernels for YCbCr->RGB conversion
+ * (jdcolor.c) and for merged 2h upsampling with conversion (jdmerge.c).
+ * See jsimd.h for their contract.
+ *
+ * The C code computes, with x = Cb - CENTERJSAMPLE or Cr - CENTERJSAMPLE,
+ *	R = Y + ((FIX(1.40200) * Cr + ONE_HALF) >> 16)
+ *	G = Y + ((- FIX(0.34414) * Cb - FIX(0.71414) * Cr + ONE_HALF) >> 16)
+ *	B = Y + ((FIX(1.77200) * Cb + ONE_HALF) >> 16)
+ * clamped to 0..MAXJSAMPLE.  The constants do not fit 16 bits, so they are
+ * split into a multiple of 2**16 (added to the shifted result exactly) and
+ * a 16-bit remainder, e.g. FIX(1.40200) * Cr = 65536 * Cr + 26345 * Cr.
+ * The rest is 16x16->32 bit multiply-adds, as exact as the tables.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jsimd.h"
+
+#if defined(JSIMD_SSSE3_SUPPORTED) || defined(JSIMD_NEON_SUPPORTED)
+
+#define SCALEBITS	16
+#define ONE_HALF	((INT32) 1 << (SCALEBITS-1))
+#define FIX(x)		((INT32) ((x) * (1L<<SCALEBITS) + 0.5))
+
+/* 16-bit remainders of the constants, see above */
+#define K_CR_R	((int) (FIX(1.40200) - (1L << SCALEBITS)))	/*  26345 */
+#define K_CB_G	((int) (- FIX(0.34414)))			/* -22554 */
+#define K_CR_G	((int) ((1L << SCALEBITS) - FIX(0.71414)))	/*  18734 */
+#define K_CB_B	((int) (FIX(1.77200) - (2L << SCALEBITS)))	/* -14942 */
+
+#endif
+
+
+#ifdef JSIMD_SSSE3_SUPPORTED
+
+#include <tmmintrin.h>
+
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#define SSSE3_TARGET  __attribute__((target("ssse3")))
+#else
+#define SSSE3_TARGET
+#endif
+
+/* Byte i of the k-th 16-byte block of 16 interleaved 3-byte pixels: take
+ * byte p of the vector holding channel c, if that output byte is channel c
+ * of pixel p (0x80 yields zero otherwise).
+ */
+#define PACK3_INDEX(k,c,i) \
+  ((char) (((16 * (k) + (i)) % 3 == (c)) ? (16 * (k) + (i)) / 3 : 0x80))
+#define PACK3_MASK(k,c) \
+  _mm_setr_epi8(PACK3_INDEX(k,c,0), PACK3_INDEX(k,c,1), PACK3_INDEX(k,c,2), \
+		PACK3_INDEX(k,c,3), PACK3_INDEX(k,c,4), PACK3_INDEX(k,c,5), \
+		PACK3_INDEX(k,c,6), PACK3_INDEX(k,c,7), PACK3_INDEX(k,c,8), \
+		PACK3_INDEX(k,c,9), PACK3_INDEX(k,c,10), PACK3_INDEX(k,c,11), \
+		PACK3_INDEX(k,c,12), PACK3_INDEX(k,c,13), PACK3_INDEX(k,c,14), \
+		PACK3_INDEX(k,c,15))
+
+
+/* Store 16 pixels given as channel vectors, in output order c0, c1, c2
+ * (and a MAXJSAMPLE filler if pixelsize is 4).
+ */
+
+SSSE3_TARGET LOCAL(void)
+store_pixels_ssse3 (JSAMPROW outptr, __m128i c0, __m128i c1, __m128i c2,
+		    int pixelsize)
+{
+  if (pixelsize == 3) {
+#define PACK3(k) \
+    _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(c0, PACK3_MASK(k,0)), \
+			      _mm_shuffle_epi8(c1, PACK3_MASK(k,1))), \
+		 _mm_shuffle_epi8(c2, PACK3_MASK(k,2)))
+    _mm_storeu_si128((__m128i *) outptr, PACK3(0));
+    _mm_storeu_si128((__m128i *) (outptr + 16), PACK3(1));
+    _mm_storeu_si128((__m128i *) (outptr + 32), PACK3(2));
+#undef PACK3
+  } else {
+    __m128i filler = _mm_set1_epi8((char) MAXJSAMPLE);
+    __m128i c01_lo = _mm_unpacklo_epi8(c0, c1);
+    __m128i c01_hi = _mm_unpackhi_epi8(c0, c1);
+    __m128i c23_lo = _mm_unpacklo_epi8(c2, filler);
+    __m128i c23_hi = _mm_unpackhi_epi8(c2, filler);
+
+    _mm_storeu_si128((__m128i *) outptr, _mm_unpacklo_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) (outptr + 16), _mm_unpackhi_epi16(c01_lo, c23_lo));
+    _mm_storeu_si128((__m128i *) (outptr + 32), _mm_unpacklo_epi16(c01_hi, c23_hi));
+    _mm_storeu_si128((__m128i *) (outptr + 48), _mm_unpackhi_epi16(c01_hi, c23_hi));
+  }
+}
+
+
+/* Chroma terms of R, G and B (the values added to Y) for the 8 Cb/Cr
+ * samples in the low halves of cb and cr.
+ */
+
+SSSE3_TARGET LOCAL(void)
+chroma_terms_ssse3 (__m128i cb, __m128i cr,
+		    __m128i * rterm, __m128i * gterm, __m128i * bterm)
+{
+  __m128i zero = _mm_setzero_si128();
+  __m128i center = _mm_set1_epi16(CENTERJSAMPLE);
+  __m128i half = _mm_set1_epi32(ONE_HALF);
+  __m128i xb = _mm_sub_epi16(_mm_unpacklo_epi8(cb, zero), center);
+  __m128i xr = _mm_sub_epi16(_mm_unpacklo_epi8(cr, zero), center);
+  /* (Cb, Cr) pairs, times (kb, kr) pairs */
+  __m128i pairs_lo = _mm_unpacklo_epi16(xb, xr);
+  __m128i pairs_hi = _mm_unpackhi_epi16(xb, xr);
+  __m128i k_r = _mm_set1_epi32((int) ((unsigned int) K_CR_R << 16));
+  __m128i k_g = _mm_set1_epi32((int) (((unsigned int) K_CR_G << 16) | (K_CB_G & 0xFFFF)));
+  __m128i k_b = _mm_set1_epi32(K_CB_B & 0xFFFF);
+
+#define CHROMA_TERM(k) \
+  _mm_packs_epi32( \
+    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs_lo, k), half), SCALEBITS), \
+    _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(pairs_hi, k), half), SCALEBITS))
+
+  *rterm = _mm_add_epi16(CHROMA_TERM(k_r), xr);
+  *gterm = _mm_sub_epi16(CHROMA_TERM(k_g), xr);
+  *bterm = _mm_add_epi16(CHROMA_TERM(k_b), _mm_add_epi16(xb, xb));
+
+#undef CHROMA_TERM
+}
+
+
+/* Y plus term for 16 pixels, clamped to 0..MAXJSAMPLE */
+
+#define ADD_CLAMP(y_lo, y_hi, term_lo, term_hi) \
+  _mm_packus_epi16(_mm_add_epi16(y_lo, term_lo), _mm_add_epi16(y_hi, term_hi))
+
+
+SSSE3_TARGET GLOBAL(JDIMENSION)
+jsimd_ycc_rgb_row_ssse3 (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+			 JSAMPROW outptr, JDIMENSION num_cols,
+			 J_COLOR_SPACE out_color_space)
+{
+  int pixelsize = out_color_space == JCS_EXT_BGRA ? 4 : 3;
+  boolean bgr = out_color_space != JCS_RGB;
+  __m128i zero = _mm_setzero_si128();
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    __m128i y = _mm_loadu_si128((const __m128i *) (inptr0 + col));
+    __m128i cb = _mm_loadu_si128((const __m128i *) (inptr1 + col));
+    __m128i cr = _mm_loadu_si128((const __m128i *) (inptr2 + col));
+    __m128i y_lo = _mm_unpacklo_epi8(y, zero);
+    __m128i y_hi = _mm_unpackhi_epi8(y, zero);
+    __m128i r_lo, g_lo, b_lo, r_hi, g_hi, b_hi, r, g, b;
+
+    chroma_terms_ssse3(cb, cr, &r_lo, &g_lo, &b_lo);
+    chroma_terms_ssse3(_mm_srli_si128(cb, 8), _mm_srli_si128(cr, 8),
+		       &r_hi, &g_hi, &b_hi);
+    r = ADD_CLAMP(y_lo, y_hi, r_lo, r_hi);
+    g = ADD_CLAMP(y_lo, y_hi, g_lo, g_hi);
+    b = ADD_CLAMP(y_lo, y_hi, b_lo, b_hi);
+    if (bgr)
+      store_pixels_ssse3(outptr, b, g, r, pixelsize);
+    else
+      store_pixels_ssse3(outptr, r, g, b, pixelsize);
+    outptr += 16 * pixelsize;
+  }
+  return col;
+}
+
+
+SSSE3_TARGET GLOBAL(JDIMENSION)
+jsimd_h2_merged_row_ssse3 (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+			   JSAMPROW outptr, JDIMENSION num_cols,
+			   J_COLOR_SPACE out_color_space)
+{
+  int pixelsize = out_color_space == JCS_EXT_BGRA ? 4 : 3;
+  boolean bgr = out_color_space != JCS_RGB;
+  __m128i zero = _mm_setzero_si128();
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    __m128i y = _mm_loadu_si128((const __m128i *) (inptr0 + col));
+    __m128i cb = _mm_loadl_epi64((const __m128i *) (inptr1 + col / 2));
+    __m128i cr = _mm_loadl_epi64((const __m128i *) (inptr2 + col / 2));
+    __m128i y_lo = _mm_unpacklo_epi8(y, zero);
+    __m128i y_hi = _mm_unpackhi_epi8(y, zero);
+    __m128i rt, gt, bt, r, g, b;
+
+    /* each chroma term serves two neighbouring pixels */
+    chroma_terms_ssse3(cb, cr, &rt, &gt, &bt);
+    r = ADD_CLAMP(y_lo, y_hi, _mm_unpacklo_epi16(rt, rt), _mm_unpackhi_epi16(rt, rt));
+    g = ADD_CLAMP(y_lo, y_hi, _mm_unpacklo_epi16(gt, gt), _mm_unpackhi_epi16(gt, gt));
+    b = ADD_CLAMP(y_lo, y_hi, _mm_unpacklo_epi16(bt, bt), _mm_unpackhi_epi16(bt, bt));
+    if (bgr)
+      store_pixels_ssse3(outptr, b, g, r, pixelsize);
+    else
+      store_pixels_ssse3(outptr, r, g, b, pixelsize);
+    outptr += 16 * pixelsize;
+  }
+  return col;
+}
+
+#endif /* JSIMD_SSSE3_SUPPORTED */
+
+
+#ifdef JSIMD_NEON_SUPPORTED
+
+#include <arm_neon.h>
+
+/* Chroma terms of R, G and B for 8 Cb/Cr samples; vrshrn adds ONE_HALF
+ * before the shift, as the tables do.
+ */
+
+LOCAL(void)
+chroma_terms_neon (uint8x8_t cb, uint8x8_t cr,
+		   int16x8_t * rterm, int16x8_t * gterm, int16x8_t * bterm)
+{
+  int16x8_t center = vdupq_n_s16(CENTERJSAMPLE);
+  int16x8_t xb = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cb)), center);
+  int16x8_t xr = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(cr)), center);
+  int32x4_t r_lo = vmull_n_s16(vget_low_s16(xr), K_CR_R);
+  int32x4_t r_hi = vmull_n_s16(vget_high_s16(xr), K_CR_R);
+  int32x4_t g_lo = vmlal_n_s16(vmull_n_s16(vget_low_s16(xb), K_CB_G), vget_low_s16(xr), K_CR_G);
+  int32x4_t g_hi = vmlal_n_s16(vmull_n_s16(vget_high_s16(xb), K_CB_G), vget_high_s16(xr), K_CR_G);
+  int32x4_t b_lo = vmull_n_s16(vget_low_s16(xb), K_CB_B);
+  int32x4_t b_hi = vmull_n_s16(vget_high_s16(xb), K_CB_B);
+
+  *rterm = vaddq_s16(vcombine_s16(vrshrn_n_s32(r_lo, SCALEBITS), vrshrn_n_s32(r_hi, SCALEBITS)), xr);
+  *gterm = vsubq_s16(vcombine_s16(vrshrn_n_s32(g_lo, SCALEBITS), vrshrn_n_s32(g_hi, SCALEBITS)), xr);
+  *bterm = vaddq_s16(vcombine_s16(vrshrn_n_s32(b_lo, SCALEBITS), vrshrn_n_s32(b_hi, SCALEBITS)),
+		     vaddq_s16(xb, xb));
+}
+
+
+/* Store 8 pixels given as channel vectors in output order. */
+
+LOCAL(void)
+store_pixels_neon (JSAMPROW outptr, uint8x8_t c0, uint8x8_t c1, uint8x8_t c2,
+		   int pixelsize)
+{
+  if (pixelsize == 3) {
+    uint8x8x3_t px;
+    px.val[0] = c0;
+    px.val[1] = c1;
+    px.val[2] = c2;
+    vst3_u8(outptr, px);
+  } else {
+    uint8x8x4_t px;
+    px.val[0] = c0;
+    px.val[1] = c1;
+    px.val[2] = c2;
+    px.val[3] = vdup_n_u8(MAXJSAMPLE);
+    vst4_u8(outptr, px);
+  }
+}
+
+#define ADD_CLAMP_NEON(y, term) \
+  vqmovun_s16(vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), term))
+
+
+GLOBAL(JDIMENSION)
+jsimd_ycc_rgb_row_neon (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+			JSAMPROW outptr, JDIMENSION num_cols,
+			J_COLOR_SPACE out_color_space)
+{
+  int pixelsize = out_color_space == JCS_EXT_BGRA ? 4 : 3;
+  boolean bgr = out_color_space != JCS_RGB;
+  JDIMENSION col;
+
+  for (col = 0; col + 8 <= num_cols; col += 8) {
+    uint8x8_t y = vld1_u8(inptr0 + col);
+    int16x8_t rt, gt, bt;
+    uint8x8_t r, g, b;
+
+    chroma_terms_neon(vld1_u8(inptr1 + col), vld1_u8(inptr2 + col), &rt, &gt, &bt);
+    r = ADD_CLAMP_NEON(y, rt);
+    g = ADD_CLAMP_NEON(y, gt);
+    b = ADD_CLAMP_NEON(y, bt);
+    if (bgr)
+      store_pixels_neon(outptr, b, g, r, pixelsize);
+    else
+      store_pixels_neon(outptr, r, g, b, pixelsize);
+    outptr += 8 * pixelsize;
+  }
+  return col;
+}
+
+
+GLOBAL(JDIMENSION)
+jsimd_h2_merged_row_neon (JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+			  JSAMPROW outptr, JDIMENSION num_cols,
+			  J_COLOR_SPACE out_color_space)
+{
+  int pixelsize = out_color_space == JCS_EXT_BGRA ? 4 : 3;
+  boolean bgr = out_color_space != JCS_RGB;
+  JDIMENSION col;
+
+  for (col = 0; col + 16 <= num_cols; col += 16) {
+    uint8x16_t y = vld1q_u8(inptr0 + col);
+    int16x8_t rt, gt, bt;
+    int16x8x2_t r2, g2, b2;
+    int half;
+
+    chroma_terms_neon(vld1_u8(inptr1 + col / 2), vld1_u8(inptr2 + col / 2), &rt, &gt, &bt);
+    /* each chroma term serves two neighbouring pixels */
+    r2 = vzipq_s16(rt, rt);
+    g2 = vzipq_s16(gt, gt);
+    b2 = vzipq_s16(bt, bt);
+    for (half = 0; half < 2; half++) {
+      uint8x8_t yh = half ? vget_high_u8(y) : vget_low_u8(y);
+      uint8x8_t r = ADD_CLAMP_NEON(yh, r2.val[half]);
+      uint8x8_t g = ADD_CLAMP_NEON(yh, g2.val[half]);
+      uint8x8_t b = ADD_CLAMP_NEON(yh, b2.val[half]);
+
+      if (bgr)
+	store_pixels_neon(outptr, b, g, r, pixelsize);
+      else
+	store_pixels_neon(outptr, r, g, b, pixelsize);
+      outptr += 8 * pixelsize;
+    }
+  }
+  return col;
+}
+
+#endif /* JSIMD_NEON_SUPPORTED */
@@ -158,6 +158,14 @@ typedef FAST_FLOAT FLOAT_MULT_TYPE; /* preferred floating type */
 #define jpeg_idct_3x6		jRD3x8
 #define jpeg_idct_2x4		jRD2x4
 #define jpeg_idct_1x2		jRD1x2
+#define jsimd_fdct_islow_method	jSFDislowM
+#define jsimd_fdct_islow_sse2	jSFDislowS
+#define jsimd_fdct_islow_avx2	jSFDislowA
+#define jsimd_fdct_islow_neon	jSFDislowN
+#define jsimd_quantize_method	jSQuantM
+#define jsimd_quantize_sse2	jSQuantS
+#define jsimd_quantize_avx2	jSQuantA
+#define jsimd_quantize_neon	jSQuantN
 #endif /* NEED_SHORT_EXTERNAL_NAMES */
 
 /* Extern declarations for the forward and inverse DCT routines. */
@@ -334,6 +342,33 @@ EXTERN(void) jpeg_idct_1x2
     JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
 	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
 
+/* SIMD versions of jpeg_fdct_islow and of the quantization step of
+ * forward_DCT (jfdctsimd.c), and their run-time selectors (jsimd.c).
+ * The selectors return NULL when the CPU has no suitable SIMD routine.
+ * A quantizer divides the DCT outputs in workspace[] by divisors[] with
+ * rounding and stores the 64 results in coef_block, as forward_DCT does.
+ */
+
+typedef JMETHOD(void, quantize_method_ptr, (JCOEFPTR coef_block,
+					    DCTELEM * divisors,
+					    DCTELEM * workspace));
+
+EXTERN(forward_DCT_method_ptr) jsimd_fdct_islow_method JPP((void));
+EXTERN(quantize_method_ptr) jsimd_quantize_method JPP((void));
+
+EXTERN(void) jsimd_fdct_islow_sse2
+    JPP((DCTELEM * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+EXTERN(void) jsimd_fdct_islow_avx2
+    JPP((DCTELEM * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+EXTERN(void) jsimd_fdct_islow_neon
+    JPP((DCTELEM * data, JSAMPARRAY sample_data, JDIMENSION start_col));
+EXTERN(void) jsimd_quantize_sse2
+    JPP((JCOEFPTR coef_block, DCTELEM * divisors, DCTELEM * workspace));
+EXTERN(void) jsimd_quantize_avx2
+    JPP((JCOEFPTR coef_block, DCTELEM * divisors, DCTELEM * workspace));
+EXTERN(void) jsimd_quantize_neon
+    JPP((JCOEFPTR coef_block, DCTELEM * divisors, DCTELEM * workspace));
+
 
 /*
  * Macros for handling fixed-point arithmetic; these are used by many
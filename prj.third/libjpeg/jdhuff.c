@@ -25,6 +25,17 @@
 
 #define HUFF_LOOKAHEAD	8	/* # of bits of lookahead */
 
+/* On 64-bit machines the bit buffer is 64 bits wide, and sequential
+ * decode_mcu has a fast path (decode_mcu_fast) that refills it several
+ * bytes at a time and decodes most coefficients with a single table lookup.
+ */
+#if defined(_WIN64) || defined(__LP64__) || defined(_LP64)
+#define HUFF_FAST_DECODE
+#endif
+
+#define HUFF_FULL_LOOKAHEAD	10	/* # of bits of lookahead of look_full */
+#define FAST_VALUE_BIAS	(1<<HUFF_FULL_LOOKAHEAD) /* > any value in look_full */
+
 typedef struct {
   /* Basic tables: (element [0] of each array is unused) */
   INT32 maxcode[18];		/* largest code of length k (-1 if none) */
@@ -45,6 +56,17 @@ typedef struct {
    */
   int look_nbits[1<<HUFF_LOOKAHEAD]; /* # bits, or 0 if too long */
   UINT8 look_sym[1<<HUFF_LOOKAHEAD]; /* symbol, or unused */
+
+#ifdef HUFF_FAST_DECODE
+  /* Combined lookahead table of decode_mcu_fast, indexed by the next
+   * HUFF_FULL_LOOKAHEAD bits.  When the code and its s = symbol & 15 extra
+   * bits fit, an entry holds
+   *	(value + FAST_VALUE_BIAS) << 16 | symbol << 8 | code length + s
+   * with the extra bits already sign-extended into value; when only the
+   * code fits, it holds  symbol << 8 | code length;  otherwise it is 0.
+   */
+  int look_full[1<<HUFF_FULL_LOOKAHEAD];
+#endif
 } d_derived_tbl;
 
 
@@ -66,14 +88,23 @@ typedef struct {
  * necessary.
  */
 
+#ifdef HUFF_FAST_DECODE
+#ifdef _WIN64
+typedef unsigned __int64 bit_buf_type;	/* type of bit-extraction buffer */
+#else
+typedef unsigned long bit_buf_type;	/* type of bit-extraction buffer */
+#endif
+#define BIT_BUF_SIZE  64	/* size of buffer in bits */
+#else
 typedef INT32 bit_buf_type;	/* type of bit-extraction buffer */
 #define BIT_BUF_SIZE  32	/* size of buffer in bits */
+#endif
 
-/* If long is > 32 bits on your machine, and shifting/masking longs is
- * reasonably fast, making bit_buf_type be long and setting BIT_BUF_SIZE
- * appropriately should be a win.  Unfortunately we can't define the size
- * with something like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)
- * because not all machines measure sizeof in 8-bit bytes.
+/* A 64-bit buffer is used where HUFF_FAST_DECODE says the machine has
+ * 64-bit registers.  (Unfortunately we can't define the size with something
+ * like  #define BIT_BUF_SIZE (sizeof(bit_buf_type)*8)  because not all
+ * machines measure sizeof in 8-bit bytes.)  It is unsigned, so that bytes
+ * shifted in at the bottom may push old bits out at the top.
  */
 
 typedef struct {		/* Bitreading state saved across MCUs */
@@ -250,8 +281,16 @@ typedef struct {
   /* Pointers to derived tables to be used for each block within an MCU */
   d_derived_tbl * dc_cur_tbls[D_MAX_BLOCKS_IN_MCU];
   d_derived_tbl * ac_cur_tbls[D_MAX_BLOCKS_IN_MCU];
-  /* Whether we care about the DC and AC coefficient values for each block */
-  int coef_limit[D_MAX_BLOCKS_IN_MCU];
+  /* Whether we care about the DC and AC coefficient values for each block:
+   * coef_limit points to full_limit, or to dc_limit while skipping MCUs.
+   */
+  int * coef_limit;
+  int full_limit[D_MAX_BLOCKS_IN_MCU];
+  int dc_limit[D_MAX_BLOCKS_IN_MCU];
+
+  /* Following fields used only by skip_mcus */
+  boolean skip_to_restart;	/* discard data up to the next RSTn marker */
+  JBLOCKROW scratch[D_MAX_BLOCKS_IN_MCU]; /* where skipped MCUs go */
 } huff_entropy_decoder;
 
 typedef huff_entropy_decoder * huff_entropy_ptr;
@@ -424,6 +463,37 @@ jpeg_make_d_derived_tbl (j_decompress_ptr cinfo, boolean isDC, int tblno,
     }
   }
 
+#ifdef HUFF_FAST_DECODE
+  /* Compute the combined lookahead table the same way, additionally
+   * decoding the extra bits that follow the code when they fit as well.
+   */
+
+  MEMZERO(dtbl->look_full, SIZEOF(dtbl->look_full));
+
+  p = 0;
+  for (l = 1; l <= HUFF_FULL_LOOKAHEAD; l++) {
+    for (i = 1; i <= (int) htbl->bits[l]; i++, p++) {
+      int sym = htbl->huffval[p];
+      int s = sym & 15;		/* # of extra bits */
+      int extra, value;
+
+      lookbits = huffcode[p] << (HUFF_FULL_LOOKAHEAD-l);
+      for (ctr = 0; ctr < (1 << (HUFF_FULL_LOOKAHEAD-l)); ctr++) {
+	if (l + s <= HUFF_FULL_LOOKAHEAD) {
+	  /* Figure F.12: extend sign bit */
+	  extra = ctr >> (HUFF_FULL_LOOKAHEAD-l-s);
+	  value = 0;
+	  if (s)
+	    value = extra < (1 << (s-1)) ? extra - ((1 << s) - 1) : extra;
+	  dtbl->look_full[lookbits + ctr] =
+	    ((value + FAST_VALUE_BIAS) << 16) | (sym << 8) | (l + s);
+	} else
+	  dtbl->look_full[lookbits + ctr] = (sym << 8) | l;
+      }
+    }
+  }
+#endif
+
   /* Validate symbols as being reasonable.
    * For AC tables, we make no check, but accept all byte values 0..255.
    * For DC tables, we require the symbols to be in range 0..15.
@@ -632,16 +702,82 @@ jpeg_huff_decode (bitread_working_state * state,
  * Returns FALSE if must suspend.
  */
 
+/*
+ * Discard entropy-coded data up to the next marker, which is left in
+ * unread_marker, without decoding it.  Like next_marker, we commit our
+ * position only before an FF, so that a suspending data source can keep
+ * the FF and what follows.  Returns FALSE if must suspend.
+ */
+
+LOCAL(boolean)
+skip_to_marker (j_decompress_ptr cinfo)
+{
+  struct jpeg_source_mgr * src = cinfo->src;
+  const JOCTET * next_input_byte;
+  const JOCTET * ff;
+  size_t bytes_in_buffer;
+  int c;
+
+  while (cinfo->unread_marker == 0) {
+    if (src->bytes_in_buffer == 0) {
+      if (! (*src->fill_input_buffer) (cinfo))
+	return FALSE;
+    }
+    next_input_byte = src->next_input_byte;
+    bytes_in_buffer = src->bytes_in_buffer;
+    /* Everything up to the next FF is data */
+    ff = (const JOCTET *) memchr((const void *) next_input_byte, 0xFF,
+				 bytes_in_buffer);
+    if (ff == NULL) {
+      src->next_input_byte = next_input_byte + bytes_in_buffer;
+      src->bytes_in_buffer = 0;
+      continue;
+    }
+    bytes_in_buffer -= (size_t) (ff - next_input_byte);
+    src->next_input_byte = ff;
+    src->bytes_in_buffer = bytes_in_buffer;
+    /* Look past the FF and any fill FFs */
+    next_input_byte = ff + 1;
+    bytes_in_buffer--;
+    do {
+      if (bytes_in_buffer == 0) {
+	if (! (*src->fill_input_buffer) (cinfo))
+	  return FALSE;
+	next_input_byte = src->next_input_byte;
+	bytes_in_buffer = src->bytes_in_buffer;
+      }
+      bytes_in_buffer--;
+      c = GETJOCTET(*next_input_byte++);
+    } while (c == 0xFF);
+    src->next_input_byte = next_input_byte;
+    src->bytes_in_buffer = bytes_in_buffer;
+    if (c != 0)			/* else a stuffed FF/00, keep going */
+      cinfo->unread_marker = c;
+  }
+  return TRUE;
+}
+
+
 LOCAL(boolean)
 process_restart (j_decompress_ptr cinfo)
 {
   huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
   int ci;
 
-  /* Throw away any unused bits remaining in bit buffer; */
-  /* include any full bytes in next_marker's count of discarded bytes */
-  cinfo->marker->discarded_bytes += entropy->bitstate.bits_left / 8;
-  entropy->bitstate.bits_left = 0;
+  if (entropy->skip_to_restart) {
+    /* skip_mcus gave up the rest of this interval: its data isn't garbage,
+     * so don't count it as discarded.
+     */
+    entropy->bitstate.bits_left = 0;
+    if (! skip_to_marker(cinfo))
+      return FALSE;
+    entropy->skip_to_restart = FALSE;
+  } else {
+    /* Throw away any unused bits remaining in bit buffer; */
+    /* include any full bytes in next_marker's count of discarded bytes */
+    cinfo->marker->discarded_bytes += entropy->bitstate.bits_left / 8;
+    entropy->bitstate.bits_left = 0;
+  }
 
   /* Advance past the RSTn marker */
   if (! (*cinfo->marker->read_restart_marker) (cinfo))
@@ -1178,6 +1314,174 @@ decode_mcu_sub (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+#ifdef HUFF_FAST_DECODE
+
+/*
+ * Fast path of decode_mcu, for the bulk of the data segment.
+ *
+ * Before each symbol get_buffer is topped up to at least 32 bits, which is
+ * enough for any code with its extra bits, so the symbol can be decoded
+ * without further checks; look_full then usually yields the symbol and the
+ * coefficient value at once.  The buffer is refilled in one go when none
+ * of the next 8 bytes is 0xFF, and byte by byte, undoing the FF/00
+ * stuffing, otherwise.
+ *
+ * decode_mcu_fast never reads into a marker or calls the data source: it
+ * gives up and returns FALSE when fewer than 16 bytes are buffered or a
+ * marker is ahead, and decode_mcu then decodes the MCU all over again
+ * with the general code.  Permanent state is updated only on success;
+ * coefficients already stored get the same values again.
+ */
+
+#define BIT_BUF_BYTES_01  (((bit_buf_type) ~((bit_buf_type) 0)) / 0xFF)
+#define BIT_BUF_BYTES_80  (BIT_BUF_BYTES_01 << 7)
+
+#define FILL_BIT_BUFFER_FAST(state,failaction) \
+	{ if (bits_left < 32) {  \
+	    register const JOCTET * p = (state).next_input_byte;  \
+	    bit_buf_type w;  \
+	    if ((state).bytes_in_buffer < 16) { failaction; }  \
+	    MEMCOPY(&w, p, SIZEOF(w));  \
+	    if (((~w - BIT_BUF_BYTES_01) & w & BIT_BUF_BYTES_80) == 0) {  \
+	      /* no 0xFF among the next 8 bytes */  \
+	      do {  \
+		get_buffer = (get_buffer << 8) | GETJOCTET(*p++);  \
+		bits_left += 8;  \
+	      } while (bits_left <= BIT_BUF_SIZE - 8);  \
+	    } else {  \
+	      do {  \
+		register int c = GETJOCTET(*p++);  \
+		if (c == 0xFF) {  \
+		  if (GETJOCTET(*p) != 0) { failaction; }  \
+		  p++;  \
+		}  \
+		get_buffer = (get_buffer << 8) | c;  \
+		bits_left += 8;  \
+	      } while (bits_left <= BIT_BUF_SIZE - 8);  \
+	    }  \
+	    (state).bytes_in_buffer -= (size_t) (p - (state).next_input_byte);  \
+	    (state).next_input_byte = p; } }
+
+/* Decode a symbol and the value of its extra bits (0 if there are none).
+ * Needs at least 32 bits in get_buffer.  Codes longer than
+ * HUFF_FULL_LOOKAHEAD are decoded per Figure F.16 as in jpeg_huff_decode,
+ * but on a bad code we give up (failaction) and leave the warning to the
+ * general path, so that it is not issued twice.
+ */
+
+#define HUFF_DECODE_FAST(result,value,htbl,failaction) \
+{ register int entry, nb; \
+  entry = htbl->look_full[PEEK_BITS(HUFF_FULL_LOOKAHEAD)]; \
+  if (entry >= (1 << 16)) { \
+    DROP_BITS(entry & 0xFF); \
+    result = (entry >> 8) & 0xFF; \
+    value = (entry >> 16) - FAST_VALUE_BIAS; \
+  } else { \
+    if (entry != 0) { \
+      DROP_BITS(entry & 0xFF); \
+      result = entry >> 8; \
+    } else { \
+      register INT32 code; \
+      nb = HUFF_FULL_LOOKAHEAD; \
+      do { \
+	nb++; \
+	code = ((INT32) (get_buffer >> (bits_left - nb))) & \
+	       ((((INT32) 1) << nb) - 1); \
+      } while (code > htbl->maxcode[nb]); \
+      if (nb > 16) { failaction; } \
+      DROP_BITS(nb); \
+      result = htbl->pub->huffval[(int) (code + htbl->valoffset[nb])]; \
+    } \
+    value = 0; \
+    if ((nb = result & 15) != 0) { \
+      value = GET_BITS(nb); \
+      value = HUFF_EXTEND(value, nb); \
+    } \
+  } \
+}
+
+
+LOCAL(boolean)
+decode_mcu_fast (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  int blkn;
+  BITREAD_STATE_VARS;
+  savable_state state;
+
+  /* Load up working state */
+  BITREAD_LOAD_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(state, entropy->saved);
+
+  /* Outer loop handles each block in the MCU */
+
+  for (blkn = 0; blkn < cinfo->blocks_in_MCU; blkn++) {
+    JBLOCKROW block = MCU_data[blkn];
+    d_derived_tbl * htbl;
+    register int s, k, r, v;
+    int coef_limit, ci;
+
+    /* Section F.2.2.1: decode the DC coefficient difference */
+    htbl = entropy->dc_cur_tbls[blkn];
+    FILL_BIT_BUFFER_FAST(br_state, return FALSE);
+    HUFF_DECODE_FAST(s, v, htbl, return FALSE);
+
+    htbl = entropy->ac_cur_tbls[blkn];
+    k = 1;
+    coef_limit = entropy->coef_limit[blkn];
+    if (coef_limit) {
+      /* Convert DC difference to actual value, update last_dc_val */
+      ci = cinfo->MCU_membership[blkn];
+      v += state.last_dc_val[ci];
+      state.last_dc_val[ci] = v;
+      /* Output the DC coefficient */
+      (*block)[0] = (JCOEF) v;
+
+      /* Section F.2.2.2: decode the AC coefficients */
+      for (; k < coef_limit; k++) {
+	FILL_BIT_BUFFER_FAST(br_state, return FALSE);
+	HUFF_DECODE_FAST(s, v, htbl, return FALSE);
+
+	r = s >> 4;
+	if (s & 15) {
+	  k += r;
+	  (*block)[jpeg_natural_order[k]] = (JCOEF) v;
+	} else {
+	  if (r != 15)
+	    goto EndOfBlock;
+	  k += 15;
+	}
+      }
+    }
+
+    /* In this path we just discard the values */
+    for (; k < DCTSIZE2; k++) {
+      FILL_BIT_BUFFER_FAST(br_state, return FALSE);
+      HUFF_DECODE_FAST(s, v, htbl, return FALSE);
+
+      r = s >> 4;
+      if (s & 15) {
+	k += r;
+      } else {
+	if (r != 15)
+	  break;
+	k += 15;
+      }
+    }
+
+    EndOfBlock: ;
+  }
+
+  /* Completed MCU, so update state */
+  BITREAD_SAVE_STATE(cinfo,entropy->bitstate);
+  ASSIGN_STATE(entropy->saved, state);
+
+  return TRUE;
+}
+
+#endif /* HUFF_FAST_DECODE */
+
+
 /*
  * Decode one MCU's worth of Huffman-compressed coefficients,
  * full-size blocks.
@@ -1198,6 +1502,19 @@ decode_mcu (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 	return FALSE;
   }
 
+#ifdef HUFF_FAST_DECODE
+  /* Try the fast path unless we are already up against a marker; the last
+   * MCU of a restart interval runs into the RSTn marker, so skip it there.
+   */
+  if (! entropy->insufficient_data && cinfo->unread_marker == 0 &&
+      (cinfo->restart_interval == 0 || entropy->restarts_to_go > 1)) {
+    if (decode_mcu_fast(cinfo, MCU_data)) {
+      entropy->restarts_to_go--;
+      return TRUE;
+    }
+  }
+#endif
+
   /* If we've run out of data, just leave the MCU set to zeroes.
    * This way, we return uniform gray for the remainder of the segment.
    */
@@ -1302,6 +1619,47 @@ decode_mcu (j_decompress_ptr cinfo, JBLOCKROW *MCU_data)
 }
 
 
+/*
+ * Skip count MCUs of a sequential scan whose pixels aren't wanted, as for
+ * a cropped or skipped region.  The DC differences must still be decoded
+ * to keep the predictions right, but the AC coefficients are only read
+ * past: decode_mcu runs with a limit of one coefficient per block and
+ * writes into scratch blocks.  Where the rest of a restart interval and
+ * at least one more MCU are to be skipped, the interval isn't decoded at
+ * all; process_restart then scans for its RSTn marker.  (Keeping one
+ * more MCU to skip ensures that the marker is a restart marker, not the
+ * end of the scan.)
+ * Returns the number of MCUs skipped, which is less than count only if
+ * the data source requested suspension.
+ */
+
+METHODDEF(JDIMENSION)
+skip_mcus (j_decompress_ptr cinfo, JDIMENSION count)
+{
+  huff_entropy_ptr entropy = (huff_entropy_ptr) cinfo->entropy;
+  JDIMENSION done = 0;
+  boolean ok;
+
+  while (done < count) {
+    if (cinfo->restart_interval && entropy->restarts_to_go > 0 &&
+	! entropy->insufficient_data &&
+	(JDIMENSION) entropy->restarts_to_go < count - done) {
+      done += entropy->restarts_to_go;
+      entropy->restarts_to_go = 0;
+      entropy->skip_to_restart = TRUE;
+      continue;
+    }
+    entropy->coef_limit = entropy->dc_limit;
+    ok = (*entropy->pub.decode_mcu) (cinfo, entropy->scratch);
+    entropy->coef_limit = entropy->full_limit;
+    if (! ok)
+      break;
+    done++;
+  }
+  return done;
+}
+
+
 /*
  * Initialize for a Huffman-compressed scan.
  */
@@ -1417,6 +1775,8 @@ start_pass_huff_decoder (j_decompress_ptr cinfo)
       entropy->pub.decode_mcu = decode_mcu_sub;
     else
       entropy->pub.decode_mcu = decode_mcu;
+    entropy->pub.skip_mcus = skip_mcus;
+    entropy->coef_limit = entropy->full_limit;
 
     for (ci = 0; ci < cinfo->comps_in_scan; ci++) {
       compptr = cinfo->cur_comp_info[ci];
@@ -1488,6 +1848,8 @@ start_pass_huff_decoder (j_decompress_ptr cinfo)
       } else {
 	entropy->coef_limit[blkn] = 0;
       }
+      /* When skipping, only the DC predictions matter */
+      entropy->dc_limit[blkn] = entropy->coef_limit[blkn] ? 1 : 0;
     }
   }
 
@@ -1495,6 +1857,7 @@ start_pass_huff_decoder (j_decompress_ptr cinfo)
   entropy->bitstate.bits_left = 0;
   entropy->bitstate.get_buffer = 0; /* unnecessary, but keeps Purify quiet */
   entropy->insufficient_data = FALSE;
+  entropy->skip_to_restart = FALSE;
 
   /* Initialize restart counter */
   entropy->restarts_to_go = cinfo->restart_interval;
@@ -1516,6 +1879,8 @@ jinit_huff_decoder (j_decompress_ptr cinfo)
 				SIZEOF(huff_entropy_decoder));
   cinfo->entropy = (struct jpeg_entropy_decoder *) entropy;
   entropy->pub.start_pass = start_pass_huff_decoder;
+  entropy->pub.skip_mcus = NULL; /* until a sequential scan starts */
+  entropy->coef_limit = entropy->full_limit;
 
   if (cinfo->progressive_mode) {
     /* Create progression status table */
@@ -1537,5 +1902,11 @@ jinit_huff_decoder (j_decompress_ptr cinfo)
     for (i = 0; i < NUM_HUFF_TBLS; i++) {
       entropy->dc_derived_tbls[i] = entropy->ac_derived_tbls[i] = NULL;
     }
+    /* Skipped MCUs only ever set coefficient 0, so one block will do */
+    entropy->scratch[0] = (JBLOCKROW)
+      (*cinfo->mem->alloc_small) ((j_common_ptr) cinfo, JPOOL_IMAGE,
+				  SIZEOF(JBLOCK));
+    for (i = 1; i < D_MAX_BLOCKS_IN_MCU; i++)
+      entropy->scratch[i] = entropy->scratch[0];
   }
 }
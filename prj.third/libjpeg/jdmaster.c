@@ -49,9 +49,12 @@ use_merged_upsample (j_decompress_ptr cinfo)
   if (cinfo->do_fancy_upsampling || cinfo->CCIR601_sampling)
     return FALSE;
   /* jdmerge.c only supports YCC=>RGB color conversion */
-  if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3 ||
-      cinfo->out_color_space != JCS_RGB ||
-      cinfo->out_color_components != RGB_PIXELSIZE)
+  if (cinfo->jpeg_color_space != JCS_YCbCr || cinfo->num_components != 3)
+    return FALSE;
+  if ((cinfo->out_color_space != JCS_RGB ||
+       cinfo->out_color_components != RGB_PIXELSIZE) &&
+      cinfo->out_color_space != JCS_EXT_BGR &&
+      cinfo->out_color_space != JCS_EXT_BGRA)
     return FALSE;
   /* and it only handles 2h1v or 2h2v sampling ratios */
   if (cinfo->comp_info[0].h_samp_factor != 2 ||
@@ -151,6 +154,26 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
 
 #endif /* IDCT_SCALING_SUPPORTED */
 
+  /* Reduce the output to the region set by jpeg_crop_output, which must
+   * still fit the iMCU grid if the scaling was changed since.
+   */
+  if (cinfo->crop_width != 0) {
+    JDIMENSION iMCU_width = (JDIMENSION)
+      (cinfo->max_h_samp_factor * cinfo->min_DCT_h_scaled_size);
+    JDIMENSION iMCU_height = (JDIMENSION)
+      (cinfo->max_v_samp_factor * cinfo->min_DCT_v_scaled_size);
+
+    if (cinfo->crop_x % iMCU_width != 0 || cinfo->crop_y % iMCU_height != 0 ||
+	cinfo->crop_x >= cinfo->output_width ||
+	cinfo->crop_y >= cinfo->output_height ||
+	cinfo->crop_width > cinfo->output_width - cinfo->crop_x ||
+	cinfo->crop_height == 0 ||
+	cinfo->crop_height > cinfo->output_height - cinfo->crop_y)
+      ERREXIT(cinfo, JERR_BAD_CROP_SPEC);
+    cinfo->output_width = cinfo->crop_width;
+    cinfo->output_height = cinfo->crop_height;
+  }
+
   /* Report number of components in selected colorspace. */
   /* Probably this should be in the color conversion module... */
   switch (cinfo->out_color_space) {
@@ -163,10 +186,12 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
     break;
 #endif /* else share code with YCbCr */
   case JCS_YCbCr:
+  case JCS_EXT_BGR:
     cinfo->out_color_components = 3;
     break;
   case JCS_CMYK:
   case JCS_YCCK:
+  case JCS_EXT_BGRA:
     cinfo->out_color_components = 4;
     break;
   default:			/* else must be same colorspace as in file */
@@ -184,6 +209,52 @@ jpeg_calc_output_dimensions (j_decompress_ptr cinfo)
 }
 
 
+/*
+ * Set the region of the image to output (see jpeglib.h).  Its left and top
+ * edges are moved out to iMCU boundaries, so that the region's blocks can
+ * be decoded just as they are for the whole image, and its size is clipped
+ * to the image; the caller gets the final region back.
+ */
+
+GLOBAL(void)
+jpeg_crop_output (j_decompress_ptr cinfo, JDIMENSION * x, JDIMENSION * y,
+		  JDIMENSION * width, JDIMENSION * height)
+{
+  JDIMENSION iMCU_width, iMCU_height, align;
+
+  /* Start from the whole scaled image; this also checks the state */
+  cinfo->crop_width = cinfo->crop_height = 0;
+  jpeg_calc_output_dimensions(cinfo);
+
+  if (*width == 0 || *height == 0 ||
+      *x >= cinfo->output_width || *y >= cinfo->output_height)
+    ERREXIT(cinfo, JERR_BAD_CROP_SPEC);
+
+  iMCU_width = (JDIMENSION)
+    (cinfo->max_h_samp_factor * cinfo->min_DCT_h_scaled_size);
+  iMCU_height = (JDIMENSION)
+    (cinfo->max_v_samp_factor * cinfo->min_DCT_v_scaled_size);
+  align = *x % iMCU_width;
+  *x -= align;
+  if (*width > cinfo->output_width - *x - align)
+    *width = cinfo->output_width - *x;
+  else
+    *width += align;
+  align = *y % iMCU_height;
+  *y -= align;
+  if (*height > cinfo->output_height - *y - align)
+    *height = cinfo->output_height - *y;
+  else
+    *height += align;
+
+  cinfo->crop_x = *x;
+  cinfo->crop_y = *y;
+  cinfo->crop_width = *width;
+  cinfo->crop_height = *height;
+  jpeg_calc_output_dimensions(cinfo);
+}
+
+
 /*
  * Several decompression processes need to range-limit values to the range
  * 0..MAXJSAMPLE; the input value may fall somewhat outside this range
@@ -23,7 +23,7 @@
  * multiplications needed for color conversion.
  *
  * This file currently provides implementations for the following cases:
- *	YCbCr => RGB color conversion only.
+ *	YCbCr => RGB color conversion only (RGB, BGR or BGRA layout).
  *	Sampling ratios of 2h1v or 2h2v.
  *	No scaling needed at upsample time.
  *	Corner-aligned (non-CCIR601) sampling alignment.
@@ -35,6 +35,7 @@
 #define JPEG_INTERNALS
 #include "jinclude.h"
 #include "jpeglib.h"
+#include "jsimd.h"
 
 #ifdef UPSAMPLE_MERGING_SUPPORTED
 
@@ -54,6 +55,12 @@ typedef struct {
   int * Cb_b_tab;		/* => table for Cb to B conversion */
   INT32 * Cr_g_tab;		/* => table for Cr to G conversion */
   INT32 * Cb_g_tab;		/* => table for Cb to G conversion */
+  jsimd_ycc_row_ptr simd_row;	/* SIMD kernel for leading pixels, or NULL */
+
+  /* Pixel layout of JCS_RGB, JCS_EXT_BGR and JCS_EXT_BGRA output */
+  int red, green, blue;		/* offsets of the colour samples */
+  int alpha;			/* offset of the MAXJSAMPLE filler, or -1 */
+  int pixelsize;
 
   /* For 2:1 vertical sampling, we produce two output rows at a time.
    * We need a "spare" row buffer to hold the second output row if the
@@ -218,6 +225,17 @@ merged_1v_upsample (j_decompress_ptr cinfo,
  */
 
 
+/* Emit one pixel of the given Y and chroma terms, in the output layout. */
+
+#define EMIT_PIXEL(outptr, y) \
+  { outptr[red] =   range_limit[(y) + cred]; \
+    outptr[green] = range_limit[(y) + cgreen]; \
+    outptr[blue] =  range_limit[(y) + cblue]; \
+    if (alpha >= 0) \
+      outptr[alpha] = MAXJSAMPLE; \
+    outptr += pixelsize; }
+
+
 /*
  * Upsample and color convert for the case of 2:1 horizontal and 1:1 vertical.
  */
@@ -232,21 +250,33 @@ h2v1_merged_upsample (j_decompress_ptr cinfo,
   int cb, cr;
   register JSAMPROW outptr;
   JSAMPROW inptr0, inptr1, inptr2;
-  JDIMENSION col;
+  JDIMENSION col, done;
   /* copy these pointers into registers if possible */
   register JSAMPLE * range_limit = cinfo->sample_range_limit;
   int * Crrtab = upsample->Cr_r_tab;
   int * Cbbtab = upsample->Cb_b_tab;
   INT32 * Crgtab = upsample->Cr_g_tab;
   INT32 * Cbgtab = upsample->Cb_g_tab;
+  int red = upsample->red, green = upsample->green, blue = upsample->blue;
+  int alpha = upsample->alpha, pixelsize = upsample->pixelsize;
   SHIFT_TEMPS
 
   inptr0 = input_buf[0][in_row_group_ctr];
   inptr1 = input_buf[1][in_row_group_ctr];
   inptr2 = input_buf[2][in_row_group_ctr];
   outptr = output_buf[0];
+  /* The SIMD kernel does an even number of leading pixels */
+  done = 0;
+  if (upsample->simd_row != NULL) {
+    done = (*upsample->simd_row) (inptr0, inptr1, inptr2, outptr,
+				  cinfo->output_width, cinfo->out_color_space);
+    inptr0 += done;
+    inptr1 += done >> 1;
+    inptr2 += done >> 1;
+    outptr += done * pixelsize;
+  }
   /* Loop for each pair of output pixels */
-  for (col = cinfo->output_width >> 1; col > 0; col--) {
+  for (col = (cinfo->output_width - done) >> 1; col > 0; col--) {
     /* Do the chroma part of the calculation */
     cb = GETJSAMPLE(*inptr1++);
     cr = GETJSAMPLE(*inptr2++);
@@ -255,15 +285,9 @@ h2v1_merged_upsample (j_decompress_ptr cinfo,
     cblue = Cbbtab[cb];
     /* Fetch 2 Y values and emit 2 pixels */
     y  = GETJSAMPLE(*inptr0++);
-    outptr[RGB_RED] =   range_limit[y + cred];
-    outptr[RGB_GREEN] = range_limit[y + cgreen];
-    outptr[RGB_BLUE] =  range_limit[y + cblue];
-    outptr += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr, y);
     y  = GETJSAMPLE(*inptr0++);
-    outptr[RGB_RED] =   range_limit[y + cred];
-    outptr[RGB_GREEN] = range_limit[y + cgreen];
-    outptr[RGB_BLUE] =  range_limit[y + cblue];
-    outptr += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr, y);
   }
   /* If image width is odd, do the last output column separately */
   if (cinfo->output_width & 1) {
@@ -273,9 +297,7 @@ h2v1_merged_upsample (j_decompress_ptr cinfo,
     cgreen = (int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr], SCALEBITS);
     cblue = Cbbtab[cb];
     y  = GETJSAMPLE(*inptr0);
-    outptr[RGB_RED] =   range_limit[y + cred];
-    outptr[RGB_GREEN] = range_limit[y + cgreen];
-    outptr[RGB_BLUE] =  range_limit[y + cblue];
+    EMIT_PIXEL(outptr, y);
   }
 }
 
@@ -294,13 +316,15 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
   int cb, cr;
   register JSAMPROW outptr0, outptr1;
   JSAMPROW inptr00, inptr01, inptr1, inptr2;
-  JDIMENSION col;
+  JDIMENSION col, done;
   /* copy these pointers into registers if possible */
   register JSAMPLE * range_limit = cinfo->sample_range_limit;
   int * Crrtab = upsample->Cr_r_tab;
   int * Cbbtab = upsample->Cb_b_tab;
   INT32 * Crgtab = upsample->Cr_g_tab;
   INT32 * Cbgtab = upsample->Cb_g_tab;
+  int red = upsample->red, green = upsample->green, blue = upsample->blue;
+  int alpha = upsample->alpha, pixelsize = upsample->pixelsize;
   SHIFT_TEMPS
 
   inptr00 = input_buf[0][in_row_group_ctr*2];
@@ -309,8 +333,22 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
   inptr2 = input_buf[2][in_row_group_ctr];
   outptr0 = output_buf[0];
   outptr1 = output_buf[1];
+  /* The SIMD kernel does an even number of leading pixels of both rows */
+  done = 0;
+  if (upsample->simd_row != NULL) {
+    done = (*upsample->simd_row) (inptr00, inptr1, inptr2, outptr0,
+				  cinfo->output_width, cinfo->out_color_space);
+    (*upsample->simd_row) (inptr01, inptr1, inptr2, outptr1,
+			   cinfo->output_width, cinfo->out_color_space);
+    inptr00 += done;
+    inptr01 += done;
+    inptr1 += done >> 1;
+    inptr2 += done >> 1;
+    outptr0 += done * pixelsize;
+    outptr1 += done * pixelsize;
+  }
   /* Loop for each group of output pixels */
-  for (col = cinfo->output_width >> 1; col > 0; col--) {
+  for (col = (cinfo->output_width - done) >> 1; col > 0; col--) {
     /* Do the chroma part of the calculation */
     cb = GETJSAMPLE(*inptr1++);
     cr = GETJSAMPLE(*inptr2++);
@@ -319,25 +357,13 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
     cblue = Cbbtab[cb];
     /* Fetch 4 Y values and emit 4 pixels */
     y  = GETJSAMPLE(*inptr00++);
-    outptr0[RGB_RED] =   range_limit[y + cred];
-    outptr0[RGB_GREEN] = range_limit[y + cgreen];
-    outptr0[RGB_BLUE] =  range_limit[y + cblue];
-    outptr0 += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr0, y);
     y  = GETJSAMPLE(*inptr00++);
-    outptr0[RGB_RED] =   range_limit[y + cred];
-    outptr0[RGB_GREEN] = range_limit[y + cgreen];
-    outptr0[RGB_BLUE] =  range_limit[y + cblue];
-    outptr0 += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr0, y);
     y  = GETJSAMPLE(*inptr01++);
-    outptr1[RGB_RED] =   range_limit[y + cred];
-    outptr1[RGB_GREEN] = range_limit[y + cgreen];
-    outptr1[RGB_BLUE] =  range_limit[y + cblue];
-    outptr1 += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr1, y);
     y  = GETJSAMPLE(*inptr01++);
-    outptr1[RGB_RED] =   range_limit[y + cred];
-    outptr1[RGB_GREEN] = range_limit[y + cgreen];
-    outptr1[RGB_BLUE] =  range_limit[y + cblue];
-    outptr1 += RGB_PIXELSIZE;
+    EMIT_PIXEL(outptr1, y);
   }
   /* If image width is odd, do the last output column separately */
   if (cinfo->output_width & 1) {
@@ -347,13 +373,9 @@ h2v2_merged_upsample (j_decompress_ptr cinfo,
     cgreen = (int) RIGHT_SHIFT(Cbgtab[cb] + Crgtab[cr], SCALEBITS);
     cblue = Cbbtab[cb];
     y  = GETJSAMPLE(*inptr00);
-    outptr0[RGB_RED] =   range_limit[y + cred];
-    outptr0[RGB_GREEN] = range_limit[y + cgreen];
-    outptr0[RGB_BLUE] =  range_limit[y + cblue];
+    EMIT_PIXEL(outptr0, y);
     y  = GETJSAMPLE(*inptr01);
-    outptr1[RGB_RED] =   range_limit[y + cred];
-    outptr1[RGB_GREEN] = range_limit[y + cgreen];
-    outptr1[RGB_BLUE] =  range_limit[y + cblue];
+    EMIT_PIXEL(outptr1, y);
   }
 }
 
@@ -395,6 +417,22 @@ jinit_merged_upsampler (j_decompress_ptr cinfo)
   }
 
   build_ycc_rgb_table(cinfo);
+  upsample->simd_row = jsimd_h2_merged_method(cinfo->out_color_space);
+
+  /* Output layout; use_merged_upsample() admits these colorspaces only */
+  if (cinfo->out_color_space == JCS_RGB) {
+    upsample->red = RGB_RED;
+    upsample->green = RGB_GREEN;
+    upsample->blue = RGB_BLUE;
+    upsample->alpha = -1;
+    upsample->pixelsize = RGB_PIXELSIZE;
+  } else {
+    upsample->red = 2;
+    upsample->green = 1;
+    upsample->blue = 0;
+    upsample->alpha = cinfo->out_color_space == JCS_EXT_BGRA ? 3 : -1;
+    upsample->pixelsize = cinfo->out_color_space == JCS_EXT_BGRA ? 4 : 3;
+  }
 }
 
 #endif /* UPSAMPLE_MERGING_SUPPORTED */
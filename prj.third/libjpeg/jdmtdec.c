@@ -0,0 +1,736 @@
+/*
+ * jdmtdec.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains multi-threaded decompression of images with restart
+ * markers.  The entropy-coded segments between RSTn markers decode
+ * independently, so jpeg_read_image_mt splits the image into bands of
+ * iMCU rows that begin at restart boundaries and decodes the bands
+ * concurrently, IDCT, upsampling and color conversion included, each into
+ * its rows of the output.
+ *
+ * The scan is first read into memory (in place if the data source already
+ * holds all of it) and the RSTn markers are located.  Every band is then
+ * decoded by a decompression object of its own, from a datastream made up
+ * of a header equivalent to the image's, but with the band's height, and
+ * the scan's data from the band's first restart interval on.  When
+ * upsampling needs context rows, a band also decodes the restart interval
+ * above it and the iMCU row below it, and discards their output; thus
+ * every output row is exactly what sequential decoding produces.
+ * Each band reports the warnings about the restart intervals it keeps,
+ * which its decoder meets just as a sequential one does.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jthread.h"
+#include <setjmp.h>
+
+
+#define BANDS_PER_THREAD  2	/* a little slack for uneven bands */
+#define MAX_BAND_HEADER   256	/* room for SOI, DAC, DRI, SOF and SOS */
+
+
+typedef enum {			/* JPEG marker codes used here */
+  M_TEM   = 0x01,
+  M_SOF0  = 0xc0,
+  M_SOF1  = 0xc1,
+  M_SOF9  = 0xc9,
+  M_DAC   = 0xcc,
+  M_RST0  = 0xd0,
+  M_RST7  = 0xd7,
+  M_SOI   = 0xd8,
+  M_SOS   = 0xda,
+  M_DRI   = 0xdd
+} JPEG_MARKER;
+
+
+/* A band of the output image, and what to decode for it */
+
+typedef struct {
+  JDIMENSION image_height;	/* height of the band's datastream */
+  int first_interval;		/* first restart interval in the datastream */
+  JDIMENSION skip_rows;		/* output rows to discard first */
+  JDIMENSION out_row;		/* first output row kept */
+  JDIMENSION num_rows;		/* # of output rows kept */
+  size_t own_start;		/* data offsets of the restart intervals */
+  size_t own_end;		/* kept, whose warnings the band reports */
+  boolean reads_marker;		/* read the RSTn marker after the last row? */
+  boolean ends_scan;		/* decodes the scan's last MCU?  Then it
+				 * keeps everything from own_start on */
+
+  /* Outcome, reported to the application's error manager afterwards */
+  boolean failed;
+  struct jpeg_error_mgr error;	/* msg_code and msg_parm of the error */
+  long num_warnings;		/* # of warnings, up to any error */
+  struct jpeg_error_mgr warning; /* msg_code and msg_parm of the first */
+  long discarded_bytes;		/* garbage skipped to the marker that */
+  int end_marker;		/* ends the scan, and its code */
+} band_info;
+
+
+/* Multi-threaded decoding state, shared by the band tasks */
+
+typedef struct {
+  j_decompress_ptr cinfo;	/* the application's object; read only */
+  JSAMPARRAY scanlines;		/* output row pointers */
+
+  const JOCTET * data;		/* the scan's entropy-coded data */
+  size_t scan_end;		/* offset just after the terminating marker */
+  size_t length;		/* # of bytes read */
+  int num_intervals;		/* # of restart intervals in the scan */
+  size_t * seg_start;		/* data offsets of each interval's segment */
+
+  int num_bands;
+  band_info * bands;
+} mt_decoder;
+
+
+/* Data source of a band decoder: the band header, then the scan's data
+ * from the start of the band's first restart interval to the end of what
+ * was read, then EOI for as long as the decoder asks for more.  The band
+ * decoder stops after the band's last row, or the RSTn marker after it.
+ */
+
+typedef struct {
+  struct jpeg_source_mgr pub;	/* public fields */
+
+  const JOCTET * data;		/* the scan's data */
+  size_t start;			/* offset of the band's first interval */
+  size_t length;		/* # of bytes of data */
+  boolean data_due;		/* data not supplied yet? */
+  boolean in_data;		/* supplying the data now? */
+  JOCTET marker[2];
+} band_source_mgr;
+
+typedef band_source_mgr * band_src_ptr;
+
+
+/* Error manager of a band decoder: errors, and warnings about the restart
+ * intervals the band keeps, are recorded for the application's error
+ * manager, which is called from its own thread.
+ */
+
+typedef struct {
+  struct jpeg_error_mgr pub;	/* "public" fields */
+  jmp_buf setjmp_buffer;	/* for return to caller */
+  band_info * band;
+} band_error_mgr;
+
+typedef band_error_mgr * band_error_ptr;
+
+
+METHODDEF(void)
+band_error_exit (j_common_ptr cinfo)
+{
+  band_error_ptr err = (band_error_ptr) cinfo->err;
+
+  err->band->failed = TRUE;
+  err->band->error = err->pub;
+  longjmp(err->setjmp_buffer, 1);
+}
+
+
+METHODDEF(void)
+band_emit_message (j_common_ptr cinfo, int msg_level)
+{
+  band_error_ptr err = (band_error_ptr) cinfo->err;
+  band_src_ptr src = (band_src_ptr) ((j_decompress_ptr) cinfo)->src;
+  size_t pos;
+
+  if (msg_level < 0) {
+    /* Overlapping bands decode some intervals twice; the position in the
+     * data tells whose interval a warning is about.  The entropy decoder
+     * may not have synchronized the source with its own position, but
+     * that is within the current MCU, or just after the RSTn marker that
+     * garbage came before.
+     */
+    if (src != NULL && src->in_data) {
+      pos = (size_t) (src->pub.next_input_byte - src->data);
+      if (err->pub.msg_code == JWRN_EXTRANEOUS_DATA)
+	pos--;
+      if (pos < err->band->own_start ||
+	  (pos >= err->band->own_end && ! err->band->ends_scan))
+	return;
+    }
+    if (err->pub.num_warnings == 0)
+      err->band->warning = err->pub;
+    err->pub.num_warnings++;
+  }
+}
+
+
+METHODDEF(void)
+init_band_source (j_decompress_ptr cinfo)
+{
+  /* no work necessary here */
+}
+
+
+METHODDEF(boolean)
+fill_band_buffer (j_decompress_ptr cinfo)
+{
+  band_src_ptr src = (band_src_ptr) cinfo->src;
+
+  if (src->data_due) {
+    src->pub.next_input_byte = src->data + src->start;
+    src->pub.bytes_in_buffer = src->length - src->start;
+    src->data_due = FALSE;
+    src->in_data = TRUE;
+    return TRUE;
+  }
+
+  src->in_data = FALSE;
+  src->marker[0] = (JOCTET) 0xFF;
+  src->marker[1] = (JOCTET) JPEG_EOI;
+  src->pub.next_input_byte = src->marker;
+  src->pub.bytes_in_buffer = 2;
+  return TRUE;
+}
+
+
+METHODDEF(void)
+skip_band_data (j_decompress_ptr cinfo, long num_bytes)
+{
+  struct jpeg_source_mgr * src = cinfo->src;
+
+  if (num_bytes > 0) {
+    while (num_bytes > (long) src->bytes_in_buffer) {
+      num_bytes -= (long) src->bytes_in_buffer;
+      (void) (*src->fill_input_buffer) (cinfo);
+    }
+    src->next_input_byte += (size_t) num_bytes;
+    src->bytes_in_buffer -= (size_t) num_bytes;
+  }
+}
+
+
+METHODDEF(void)
+term_band_source (j_decompress_ptr cinfo)
+{
+  /* no work necessary here */
+}
+
+
+/*
+ * Write the header of a band's datastream: the markers that define the
+ * image's frame and scan, with the given image height.  The tables are
+ * copied into the band decoder directly.
+ */
+
+#define PUT_BYTE(val)  (*p++ = (JOCTET) (val))
+#define PUT_2BYTES(val)  (PUT_BYTE(((val) >> 8) & 0xFF), PUT_BYTE((val) & 0xFF))
+
+LOCAL(size_t)
+write_band_header (j_decompress_ptr cinfo, JOCTET * header,
+		   JDIMENSION image_height)
+{
+  JOCTET * p = header;
+  jpeg_component_info * compptr;
+  int ci, i;
+
+  PUT_BYTE(0xFF); PUT_BYTE(M_SOI);
+
+  if (cinfo->arith_code) {
+    PUT_BYTE(0xFF); PUT_BYTE(M_DAC);
+    PUT_2BYTES(2 + 2 * 2 * NUM_ARITH_TBLS);
+    for (i = 0; i < NUM_ARITH_TBLS; i++) {
+      PUT_BYTE(i);
+      PUT_BYTE((cinfo->arith_dc_U[i] << 4) + cinfo->arith_dc_L[i]);
+      PUT_BYTE(i + NUM_ARITH_TBLS);
+      PUT_BYTE(cinfo->arith_ac_K[i]);
+    }
+  }
+
+  PUT_BYTE(0xFF); PUT_BYTE(M_DRI);
+  PUT_2BYTES(4);
+  PUT_2BYTES(cinfo->restart_interval);
+
+  PUT_BYTE(0xFF);
+  PUT_BYTE(cinfo->arith_code ? M_SOF9 : cinfo->is_baseline ? M_SOF0 : M_SOF1);
+  PUT_2BYTES(8 + 3 * cinfo->num_components);
+  PUT_BYTE(cinfo->data_precision);
+  PUT_2BYTES(image_height);
+  PUT_2BYTES(cinfo->image_width);
+  PUT_BYTE(cinfo->num_components);
+  for (ci = 0, compptr = cinfo->comp_info; ci < cinfo->num_components;
+       ci++, compptr++) {
+    PUT_BYTE(compptr->component_id);
+    PUT_BYTE((compptr->h_samp_factor << 4) + compptr->v_samp_factor);
+    PUT_BYTE(compptr->quant_tbl_no);
+  }
+
+  PUT_BYTE(0xFF); PUT_BYTE(M_SOS);
+  PUT_2BYTES(6 + 2 * cinfo->comps_in_scan);
+  PUT_BYTE(cinfo->comps_in_scan);
+  for (i = 0; i < cinfo->comps_in_scan; i++) {
+    compptr = cinfo->cur_comp_info[i];
+    PUT_BYTE(compptr->component_id);
+    PUT_BYTE((compptr->dc_tbl_no << 4) + compptr->ac_tbl_no);
+  }
+  PUT_BYTE(cinfo->Ss);
+  PUT_BYTE(cinfo->Se);
+  PUT_BYTE((cinfo->Ah << 4) + cinfo->Al);
+
+  return (size_t) (p - header);
+}
+
+
+/*
+ * Find the next marker from *pp on, as next_marker does: add the bytes it
+ * would discard to *discarded, and return the marker code (0 if there is
+ * none before end) with *pp just after it.
+ */
+
+LOCAL(int)
+scan_for_marker (const JOCTET ** pp, const JOCTET * end, long * discarded)
+{
+  const JOCTET * p = *pp;
+  int c = 0;
+
+  while (p < end) {
+    if (GETJOCTET(*p) != 0xFF) {
+      p++;
+      (*discarded)++;
+      continue;
+    }
+    do {			/* fill bytes aren't counted */
+      p++;
+    } while (p < end && GETJOCTET(*p) == 0xFF);
+    if (p >= end)
+      break;
+    c = GETJOCTET(*p++);
+    if (c != 0)
+      break;
+    *discarded += 2;		/* stuffed zero byte */
+  }
+  *pp = p;
+  return c;
+}
+
+
+/*
+ * Decode one band; the body of a jthread_run task.
+ * A band with first_interval < 0 is the whole scan, as read.
+ */
+
+METHODDEF(void)
+decode_band (void * arg, int bandno)
+{
+  mt_decoder * mt = (mt_decoder *) arg;
+  j_decompress_ptr cinfo = mt->cinfo;
+  band_info * band = &mt->bands[bandno];
+  struct jpeg_decompress_struct dinfo;
+  band_error_mgr jerr;
+  band_source_mgr src;
+  JOCTET header[MAX_BAND_HEADER];
+  JSAMPARRAY scratch;
+  JBLOCKROW blocks, MCU_data[D_MAX_BLOCKS_IN_MCU];
+  const JOCTET * p;
+  const JOCTET * end;
+  long discarded;
+  JDIMENSION end_row;
+  int c, i;
+
+  dinfo.err = jpeg_std_error(&jerr.pub);
+  jerr.pub.error_exit = band_error_exit;
+  jerr.pub.emit_message = band_emit_message;
+  jerr.band = band;
+  dinfo.mem = NULL;
+  if (setjmp(jerr.setjmp_buffer)) {
+    band->num_warnings = jerr.pub.num_warnings;
+    jpeg_destroy_decompress(&dinfo);
+    return;
+  }
+  jpeg_create_decompress(&dinfo);
+
+  /* The tables may come from an earlier tables-only datastream */
+  for (i = 0; i < NUM_QUANT_TBLS; i++) {
+    if (cinfo->quant_tbl_ptrs[i] != NULL) {
+      dinfo.quant_tbl_ptrs[i] = jpeg_alloc_quant_table((j_common_ptr) &dinfo);
+      MEMCOPY(dinfo.quant_tbl_ptrs[i], cinfo->quant_tbl_ptrs[i],
+	      SIZEOF(JQUANT_TBL));
+    }
+  }
+  for (i = 0; i < NUM_HUFF_TBLS; i++) {
+    if (cinfo->dc_huff_tbl_ptrs[i] != NULL) {
+      dinfo.dc_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr) &dinfo);
+      MEMCOPY(dinfo.dc_huff_tbl_ptrs[i], cinfo->dc_huff_tbl_ptrs[i],
+	      SIZEOF(JHUFF_TBL));
+    }
+    if (cinfo->ac_huff_tbl_ptrs[i] != NULL) {
+      dinfo.ac_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr) &dinfo);
+      MEMCOPY(dinfo.ac_huff_tbl_ptrs[i], cinfo->ac_huff_tbl_ptrs[i],
+	      SIZEOF(JHUFF_TBL));
+    }
+  }
+
+  src.pub.init_source = init_band_source;
+  src.pub.fill_input_buffer = fill_band_buffer;
+  src.pub.skip_input_data = skip_band_data;
+  src.pub.resync_to_restart = jpeg_resync_to_restart;
+  src.pub.term_source = term_band_source;
+  src.pub.next_input_byte = header;
+  src.pub.bytes_in_buffer = write_band_header(cinfo, header, band->image_height);
+  src.data = mt->data;
+  src.start = band->first_interval > 0 ?
+	      mt->seg_start[band->first_interval] : 0;
+  src.length = mt->length;
+  src.data_due = TRUE;
+  src.in_data = FALSE;
+  dinfo.src = &src.pub;
+
+  (void) jpeg_read_header(&dinfo, TRUE);
+  /* The RSTn markers are the scan's own */
+  if (band->first_interval > 0)
+    dinfo.marker->next_restart_num = band->first_interval & 7;
+
+  /* Same decompression parameters as the application's object */
+  dinfo.jpeg_color_space = cinfo->jpeg_color_space;
+  dinfo.out_color_space = cinfo->out_color_space;
+  dinfo.scale_num = cinfo->scale_num;
+  dinfo.scale_denom = cinfo->scale_denom;
+  dinfo.output_gamma = cinfo->output_gamma;
+  dinfo.dct_method = cinfo->dct_method;
+  dinfo.do_fancy_upsampling = cinfo->do_fancy_upsampling;
+  dinfo.do_block_smoothing = cinfo->do_block_smoothing;
+  dinfo.mem->max_memory_to_use = cinfo->mem->max_memory_to_use;
+
+  (void) jpeg_start_decompress(&dinfo);
+  if (dinfo.output_width != cinfo->output_width ||
+      dinfo.output_components != cinfo->output_components)
+    ERREXIT(&dinfo, JERR_NOTIMPL);
+
+  end_row = band->skip_rows + band->num_rows;
+  if (end_row > dinfo.output_height)
+    end_row = dinfo.output_height;
+
+  if (band->skip_rows > 0) {
+    scratch = (*dinfo.mem->alloc_sarray)
+      ((j_common_ptr) &dinfo, JPOOL_IMAGE,
+       dinfo.output_width * (JDIMENSION) dinfo.output_components, 1);
+    while (dinfo.output_scanline < band->skip_rows)
+      (void) jpeg_read_scanlines(&dinfo, scratch, 1);
+  }
+  while (dinfo.output_scanline < end_row)
+    (void) jpeg_read_scanlines(&dinfo, mt->scanlines + band->out_row +
+			       (dinfo.output_scanline - band->skip_rows),
+			       end_row - dinfo.output_scanline);
+
+  if (band->reads_marker) {
+    /* The band ends with a restart interval: decoding the next MCU reads
+     * the RSTn marker, and any garbage before it, as sequential decoding
+     * does.
+     */
+    blocks = (JBLOCKROW) (*dinfo.mem->alloc_large)
+      ((j_common_ptr) &dinfo, JPOOL_IMAGE,
+       dinfo.blocks_in_MCU * SIZEOF(JBLOCK));
+    for (i = 0; i < dinfo.blocks_in_MCU; i++)
+      MCU_data[i] = blocks + i;
+    (void) (*dinfo.entropy->decode_mcu) (&dinfo, MCU_data);
+  } else if (band->ends_scan &&
+	     dinfo.output_scanline == dinfo.output_height && src.in_data) {
+    /* After the scan's last MCU, sequential decoding reads markers: any
+     * that the entropy decoder met early, then what next_marker finds,
+     * with a warning about garbage skipped.  Do the same up to the marker
+     * that ends the scan, which is the application's object's to read.
+     */
+    p = src.pub.next_input_byte;
+    end = src.data + mt->scan_end;
+    c = dinfo.unread_marker;
+    discarded = (long) dinfo.marker->discarded_bytes;
+    while (p < end) {
+      if (c == 0) {
+	c = scan_for_marker(&p, end, &discarded);
+	if (p >= end) {
+	  band->discarded_bytes = discarded;
+	  band->end_marker = c;
+	  break;
+	}
+	if (discarded != 0)
+	  WARNMS2(&dinfo, JWRN_EXTRANEOUS_DATA, discarded, c);
+	discarded = 0;
+      }
+      if ((c < M_RST0 || c > M_RST7) && c != M_TEM)
+	ERREXIT1(&dinfo, JERR_UNKNOWN_MARKER, c);
+      c = 0;			/* parameterless; read on */
+    }
+  }
+
+  band->num_warnings = jerr.pub.num_warnings;
+  jpeg_destroy_decompress(&dinfo);
+}
+
+
+/*
+ * Read the rest of the scan into memory, up to the marker that ends it,
+ * and locate the restart intervals.  The data source is left after that
+ * marker, which becomes cinfo->unread_marker.
+ * Returns FALSE if the RSTn markers are not the expected ones.
+ */
+
+LOCAL(boolean)
+read_scan_data (j_decompress_ptr cinfo, mt_decoder * mt)
+{
+  struct jpeg_source_mgr * src = cinfo->src;
+  const JOCTET * data = src->next_input_byte;
+  size_t length = src->bytes_in_buffer;
+  JOCTET * buffer = NULL;
+  size_t buffer_size = 0, new_size;
+  const JOCTET * chunk = data;	/* the source's current buffer */
+  size_t chunk_start = 0;	/* its offset in data */
+  size_t pos = 0, next = 0;
+  int count = 0, c = 0;
+  boolean in_sequence = TRUE;
+
+  mt->seg_start[0] = 0;
+  for (;;) {
+    while (pos < length) {
+      if (GETJOCTET(data[pos]) != 0xFF) {
+	pos++;
+	continue;
+      }
+      next = pos + 1;
+      while (next < length && GETJOCTET(data[next]) == 0xFF)
+	next++;
+      if (next >= length)
+	break;			/* need more data to see the marker */
+      c = GETJOCTET(data[next]);
+      if (c == 0) {		/* stuffed zero byte */
+	pos = next + 1;
+	continue;
+      }
+      if (c < M_RST0 || c > M_RST7) {
+	if (c >= M_SOF0)
+	  goto end_of_scan;
+	/* The entropy decoder resyncs past invalid marker codes; leave that
+	 * to the decoding of the scan as it is.
+	 */
+	in_sequence = FALSE;
+      } else if (count + 1 >= mt->num_intervals || c != M_RST0 + (count & 7))
+	in_sequence = FALSE;
+      if (in_sequence) {
+	mt->seg_start[++count] = next + 1;
+      }
+      pos = next + 1;
+    }
+
+    /* Copy what we have before the source reuses its buffer */
+    if (data != buffer) {
+      buffer_size = MAX(length * 2, 65536);
+      buffer = (JOCTET *) (*cinfo->mem->alloc_large)
+	((j_common_ptr) cinfo, JPOOL_IMAGE, buffer_size * SIZEOF(JOCTET));
+      MEMCOPY(buffer, data, length * SIZEOF(JOCTET));
+      data = buffer;
+    }
+    src->next_input_byte += src->bytes_in_buffer;
+    src->bytes_in_buffer = 0;
+    if (! (*src->fill_input_buffer) (cinfo))
+      ERREXIT(cinfo, JERR_CANT_SUSPEND);
+    if (length + src->bytes_in_buffer > buffer_size) {
+      new_size = buffer_size * 2;
+      while (length + src->bytes_in_buffer > new_size)
+	new_size *= 2;
+      buffer = (JOCTET *) (*cinfo->mem->alloc_large)
+	((j_common_ptr) cinfo, JPOOL_IMAGE, new_size * SIZEOF(JOCTET));
+      MEMCOPY(buffer, data, length * SIZEOF(JOCTET));
+      data = buffer;
+      buffer_size = new_size;
+    }
+    chunk = src->next_input_byte;
+    chunk_start = length;
+    MEMCOPY(buffer + length, chunk, src->bytes_in_buffer * SIZEOF(JOCTET));
+    length += src->bytes_in_buffer;
+  }
+
+end_of_scan:
+  /* The marker code is in the source's current buffer, which starts at
+   * chunk_start: had it been in an earlier one, the marker would have
+   * been found before reading more.
+   */
+  mt->scan_end = next + 1;
+  mt->length = length;
+  mt->data = data;
+  cinfo->unread_marker = c;
+  src->next_input_byte = chunk + (next + 1 - chunk_start);
+  src->bytes_in_buffer -= next + 1 - chunk_start;
+
+  return in_sequence && count + 1 == mt->num_intervals;
+}
+
+
+/*
+ * Can the image be decoded in bands?  The application's object must be
+ * about to output the first row of a single-scan image with restart
+ * markers, and must not be quantizing colors or cropping the output.
+ */
+
+LOCAL(boolean)
+use_bands (j_decompress_ptr cinfo)
+{
+  return cinfo->output_scanline == 0 && cinfo->restart_interval > 0 &&
+	 ! cinfo->inputctl->has_multiple_scans &&
+	 ! cinfo->inputctl->eoi_reached && cinfo->unread_marker == 0 &&
+	 ! cinfo->quantize_colors && cinfo->crop_width == 0 ? TRUE : FALSE;
+}
+
+
+/*
+ * Decode the image in bands on num_threads threads.
+ */
+
+LOCAL(void)
+decode_in_bands (j_decompress_ptr cinfo, JSAMPARRAY scanlines,
+		 int num_threads)
+{
+  mt_decoder mt;
+  band_info * band;
+  JDIMENSION rows_per_iMCU, out_rows_per_iMCU, total_rows;
+  JDIMENSION r0, r1, first, last;
+  long mcus_per_iMCU, total_mcus, step, a, b, t;
+  int num_steps, i;
+
+  mt.cinfo = cinfo;
+  mt.scanlines = scanlines;
+
+  /* iMCU rows that begin a restart interval are multiples of step */
+  mcus_per_iMCU = (long) cinfo->MCUs_per_row;
+  if (cinfo->comps_in_scan == 1)
+    mcus_per_iMCU *= cinfo->cur_comp_info[0]->v_samp_factor;
+  total_mcus = (long) cinfo->MCUs_per_row * (long) cinfo->MCU_rows_in_scan;
+  a = (long) cinfo->restart_interval;
+  b = mcus_per_iMCU;
+  while (b != 0) {		/* a = gcd(restart_interval, mcus_per_iMCU) */
+    t = a % b; a = b; b = t;
+  }
+  step = (long) cinfo->restart_interval / a;
+  total_rows = cinfo->total_iMCU_rows;
+  num_steps = (int) ((total_rows + step - 1) / step);
+
+  rows_per_iMCU = (JDIMENSION) (cinfo->max_v_samp_factor * cinfo->block_size);
+  out_rows_per_iMCU = (JDIMENSION)
+    (cinfo->max_v_samp_factor * cinfo->min_DCT_v_scaled_size);
+
+  mt.num_intervals = (int) ((total_mcus + cinfo->restart_interval - 1) /
+			    cinfo->restart_interval);
+  mt.seg_start = (size_t *) (*cinfo->mem->alloc_large)
+    ((j_common_ptr) cinfo, JPOOL_IMAGE, mt.num_intervals * SIZEOF(size_t));
+
+  mt.num_bands = num_threads * BANDS_PER_THREAD;
+  if (mt.num_bands > num_steps)
+    mt.num_bands = num_steps;
+  mt.bands = (band_info *) (*cinfo->mem->alloc_small)
+    ((j_common_ptr) cinfo, JPOOL_IMAGE, mt.num_bands * SIZEOF(band_info));
+  MEMZERO(mt.bands, mt.num_bands * SIZEOF(band_info));
+
+  if (read_scan_data(cinfo, &mt)) {
+    for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+      /* Keep iMCU rows r0..r1-1, decode rows first..last-1 */
+      r0 = (JDIMENSION) (step * ((long) i * num_steps / mt.num_bands));
+      r1 = (JDIMENSION) (step * ((long) (i + 1) * num_steps / mt.num_bands));
+      if (r1 > total_rows)
+	r1 = total_rows;
+      first = r0;
+      last = r1;
+      if (cinfo->upsample->need_context_rows) {
+	if (r0 > 0)
+	  first = r0 - (JDIMENSION) step;
+	if (r1 < total_rows)
+	  last = r1 + 1;
+      }
+      band->first_interval = (int) ((long) first * mcus_per_iMCU /
+				    cinfo->restart_interval);
+      if (last == total_rows)
+	band->image_height = cinfo->image_height - first * rows_per_iMCU;
+      else
+	band->image_height = (last - first) * rows_per_iMCU;
+      band->skip_rows = (r0 - first) * out_rows_per_iMCU;
+      band->out_row = r0 * out_rows_per_iMCU;
+      band->num_rows = MIN(r1 * out_rows_per_iMCU, cinfo->output_height) -
+		       band->out_row;
+      band->own_start = mt.seg_start[(long) r0 * mcus_per_iMCU /
+				     cinfo->restart_interval];
+      band->ends_scan = (r1 == total_rows);
+      if (! band->ends_scan)
+	band->own_end = mt.seg_start[(long) r1 * mcus_per_iMCU /
+				     cinfo->restart_interval];
+      band->reads_marker = (last == r1 && ! band->ends_scan);
+    }
+  } else {
+    /* Unexpected RSTn markers: decode the scan as it is, on this thread */
+    mt.num_bands = 1;
+    band = mt.bands;
+    band->first_interval = -1;
+    band->image_height = cinfo->image_height;
+    band->skip_rows = 0;
+    band->out_row = 0;
+    band->num_rows = cinfo->output_height;
+    band->own_start = 0;
+    band->reads_marker = FALSE;
+    band->ends_scan = TRUE;
+    num_threads = 1;
+  }
+
+  jthread_run(num_threads, mt.num_bands, decode_band, (void *) &mt);
+
+  /* Report warnings and the first error, in band order */
+  for (i = 0, band = mt.bands; i < mt.num_bands; i++, band++) {
+    if (band->num_warnings > 0) {
+      cinfo->err->msg_code = band->warning.msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &band->warning.msg_parm,
+	      SIZEOF(cinfo->err->msg_parm));
+      (*cinfo->err->emit_message) ((j_common_ptr) cinfo, -1);
+      cinfo->err->num_warnings += band->num_warnings - 1;
+    }
+    if (band->failed) {
+      cinfo->err->msg_code = band->error.msg_code;
+      MEMCOPY(&cinfo->err->msg_parm, &band->error.msg_parm,
+	      SIZEOF(cinfo->err->msg_parm));
+      (*cinfo->err->error_exit) ((j_common_ptr) cinfo);
+    }
+    if (band->discarded_bytes != 0)
+      WARNMS2(cinfo, JWRN_EXTRANEOUS_DATA, band->discarded_bytes,
+	      band->end_marker);
+  }
+
+  /* The scan is complete; the terminating marker is cinfo->unread_marker */
+  (*cinfo->inputctl->finish_input_pass) (cinfo);
+  cinfo->output_scanline = cinfo->output_height;
+}
+
+
+/*
+ * Read all remaining scanlines, on up to num_threads threads.
+ * scanlines[] has a pointer for every output row of the image.
+ *
+ * Single-scan images with restart markers are decoded in bands (see
+ * above) when num_threads > 1; anything else is read with
+ * jpeg_read_scanlines on the calling thread.  The data source must not
+ * suspend.  Returns the number of scanlines read.
+ */
+
+GLOBAL(JDIMENSION)
+jpeg_read_image_mt (j_decompress_ptr cinfo, JSAMPARRAY scanlines,
+		    int num_threads)
+{
+  JDIMENSION start_scanline = cinfo->output_scanline;
+
+  if (cinfo->global_state != DSTATE_SCANNING)
+    ERREXIT1(cinfo, JERR_BAD_STATE, cinfo->global_state);
+
+  if (num_threads > 1 && use_bands(cinfo))
+    decode_in_bands(cinfo, scanlines, num_threads);
+  else {
+    while (cinfo->output_scanline < cinfo->output_height) {
+      if (jpeg_read_scanlines(cinfo, scanlines + cinfo->output_scanline,
+			      cinfo->output_height -
+			      cinfo->output_scanline) == 0)
+	ERREXIT(cinfo, JERR_CANT_SUSPEND);
+    }
+  }
+
+  return cinfo->output_scanline - start_scanline;
+}
@@ -0,0 +1,530 @@
+/*
+ * jfdctsimd.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SSE2, AVX2 and NEON versions of the slow-but-accurate
+ * integer forward DCT (jfdctint.c) and of the quantization step of
+ * forward_DCT (jcdctmgr.c).  Both produce output identical to the C code.
+ *
+ * The FDCT carries out the operations of jpeg_fdct_islow in 32-bit lanes,
+ * several rows (pass 1) or columns (pass 2) at a time.  Some intermediate
+ * sums of the column pass can exceed 32 bits in the worst case, but lane
+ * arithmetic is modulo 2**32 and every value that is shifted (an output
+ * times 2**15 plus rounding, below 2**29 for 8-bit samples) fits, so the
+ * results are exact.
+ *
+ * Quantization divides |coefficient| + divisor/2 by the divisor in single
+ * precision and truncates.  For integers a, b with a + b < 2**24 the
+ * rounded float quotient never reaches the next integer, so this is the
+ * exact integer quotient.  FDCT outputs are below 2**16 and divisors
+ * below 2**20 (16-bit quantizers times 8, or the AA&N scaled ones), well
+ * within the limit.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#if DCTSIZE != 8
+  Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
+#endif
+
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+/* Scaling and constants as in jfdctint.c (8-bit samples). */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  ((INT32)  2446)	/* FIX(0.298631336) */
+#define FIX_0_390180644  ((INT32)  3196)	/* FIX(0.390180644) */
+#define FIX_0_541196100  ((INT32)  4433)	/* FIX(0.541196100) */
+#define FIX_0_765366865  ((INT32)  6270)	/* FIX(0.765366865) */
+#define FIX_0_899976223  ((INT32)  7373)	/* FIX(0.899976223) */
+#define FIX_1_175875602  ((INT32)  9633)	/* FIX(1.175875602) */
+#define FIX_1_501321110  ((INT32)  12299)	/* FIX(1.501321110) */
+#define FIX_1_847759065  ((INT32)  15137)	/* FIX(1.847759065) */
+#define FIX_1_961570560  ((INT32)  16069)	/* FIX(1.961570560) */
+#define FIX_2_053119869  ((INT32)  16819)	/* FIX(2.053119869) */
+#define FIX_2_562915447  ((INT32)  20995)	/* FIX(2.562915447) */
+#define FIX_3_072711026  ((INT32)  25172)	/* FIX(3.072711026) */
+
+
+/* One 1-D FDCT of eight vectors in[0..7] into out[0..7], operation for
+ * operation as in jpeg_fdct_islow; rnd is the rounding term of the pass.
+ * out[0] and out[4] are tmp10 + tmp11 and tmp10 - tmp11 without offset or
+ * scaling; the other outputs are not yet descaled.
+ */
+
+#define FDCT_1D(T, ADD, SUB, MUL, in, rnd, out) \
+{ \
+  T z1_, tmp0_, tmp1_, tmp2_, tmp3_; \
+  T tmp10_, tmp11_, tmp12_, tmp13_; \
+  \
+  tmp0_ = ADD(in[0], in[7]); \
+  tmp1_ = ADD(in[1], in[6]); \
+  tmp2_ = ADD(in[2], in[5]); \
+  tmp3_ = ADD(in[3], in[4]); \
+  \
+  tmp10_ = ADD(tmp0_, tmp3_); \
+  tmp12_ = SUB(tmp0_, tmp3_); \
+  tmp11_ = ADD(tmp1_, tmp2_); \
+  tmp13_ = SUB(tmp1_, tmp2_); \
+  \
+  tmp0_ = SUB(in[0], in[7]); \
+  tmp1_ = SUB(in[1], in[6]); \
+  tmp2_ = SUB(in[2], in[5]); \
+  tmp3_ = SUB(in[3], in[4]); \
+  \
+  out[0] = ADD(tmp10_, tmp11_); \
+  out[4] = SUB(tmp10_, tmp11_); \
+  \
+  z1_ = ADD(MUL(ADD(tmp12_, tmp13_), FIX_0_541196100), rnd); \
+  out[2] = ADD(z1_, MUL(tmp12_, FIX_0_765366865)); \
+  out[6] = SUB(z1_, MUL(tmp13_, FIX_1_847759065)); \
+  \
+  tmp10_ = ADD(tmp0_, tmp3_); \
+  tmp11_ = ADD(tmp1_, tmp2_); \
+  tmp12_ = ADD(tmp0_, tmp2_); \
+  tmp13_ = ADD(tmp1_, tmp3_); \
+  z1_ = ADD(MUL(ADD(tmp12_, tmp13_), FIX_1_175875602), rnd); \
+  \
+  tmp0_ = MUL(tmp0_, FIX_1_501321110); \
+  tmp1_ = MUL(tmp1_, FIX_3_072711026); \
+  tmp2_ = MUL(tmp2_, FIX_2_053119869); \
+  tmp3_ = MUL(tmp3_, FIX_0_298631336); \
+  tmp10_ = MUL(tmp10_, - FIX_0_899976223); \
+  tmp11_ = MUL(tmp11_, - FIX_2_562915447); \
+  tmp12_ = ADD(MUL(tmp12_, - FIX_0_390180644), z1_); \
+  tmp13_ = ADD(MUL(tmp13_, - FIX_1_961570560), z1_); \
+  \
+  out[1] = ADD(ADD(tmp0_, tmp10_), tmp12_); \
+  out[3] = ADD(ADD(tmp1_, tmp11_), tmp13_); \
+  out[5] = ADD(ADD(tmp2_, tmp11_), tmp12_); \
+  out[7] = ADD(ADD(tmp3_, tmp10_), tmp13_); \
+}
+
+/* Pass 1 leaves out[0] and out[4] scaled up by 2**PASS1_BITS, the DC term
+ * less the 8 * CENTERJSAMPLE offset, and descales the rest by
+ * CONST_BITS-PASS1_BITS.  Pass 2 adds the rounding term of the C code to
+ * out[0] and out[4] and descales them by PASS1_BITS, the rest by
+ * CONST_BITS+PASS1_BITS.
+ */
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+#ifdef JSIMD_SSE2_SUPPORTED
+
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+/* Low 32 bits of the lane products (the same for signed and unsigned). */
+
+LOCAL(__m128i)
+mullo_epi32_sse2 (__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+  return _mm_mullo_epi32(a, b);
+#else
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+#define SSE2_ADD(a,b)  _mm_add_epi32(a, b)
+#define SSE2_SUB(a,b)  _mm_sub_epi32(a, b)
+#define SSE2_MUL(a,c)  mullo_epi32_sse2(a, _mm_set1_epi32((int) (c)))
+
+#define TRANSPOSE_4X4_EPI32(r0,r1,r2,r3) \
+{ \
+  __m128i t0_ = _mm_unpacklo_epi32(r0, r1); \
+  __m128i t1_ = _mm_unpacklo_epi32(r2, r3); \
+  __m128i t2_ = _mm_unpackhi_epi32(r0, r1); \
+  __m128i t3_ = _mm_unpackhi_epi32(r2, r3); \
+  r0 = _mm_unpacklo_epi64(t0_, t1_); \
+  r1 = _mm_unpackhi_epi64(t0_, t1_); \
+  r2 = _mm_unpacklo_epi64(t2_, t3_); \
+  r3 = _mm_unpackhi_epi64(t2_, t3_); \
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow_sse2 (DCTELEM * data, JSAMPARRAY sample_data,
+		       JDIMENSION start_col)
+{
+  /* [h][k]: column k of rows 4h..4h+3; after the transpose, row k of
+   * columns 4h..4h+3.
+   */
+  __m128i row16[8], data32[2][8], out[8];
+  __m128i zero = _mm_setzero_si128();
+  int h, k;
+
+  /* Load the rows as 16-bit samples and transpose them into columns. */
+  for (k = 0; k < DCTSIZE; k++)
+    row16[k] = _mm_unpacklo_epi8(
+      _mm_loadl_epi64((const __m128i *) (sample_data[k] + start_col)), zero);
+  {
+    __m128i a0 = _mm_unpacklo_epi16(row16[0], row16[1]);
+    __m128i a1 = _mm_unpackhi_epi16(row16[0], row16[1]);
+    __m128i a2 = _mm_unpacklo_epi16(row16[2], row16[3]);
+    __m128i a3 = _mm_unpackhi_epi16(row16[2], row16[3]);
+    __m128i a4 = _mm_unpacklo_epi16(row16[4], row16[5]);
+    __m128i a5 = _mm_unpackhi_epi16(row16[4], row16[5]);
+    __m128i a6 = _mm_unpacklo_epi16(row16[6], row16[7]);
+    __m128i a7 = _mm_unpackhi_epi16(row16[6], row16[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+
+    row16[0] = _mm_unpacklo_epi64(b0, b4);
+    row16[1] = _mm_unpackhi_epi64(b0, b4);
+    row16[2] = _mm_unpacklo_epi64(b1, b5);
+    row16[3] = _mm_unpackhi_epi64(b1, b5);
+    row16[4] = _mm_unpacklo_epi64(b2, b6);
+    row16[5] = _mm_unpackhi_epi64(b2, b6);
+    row16[6] = _mm_unpacklo_epi64(b3, b7);
+    row16[7] = _mm_unpackhi_epi64(b3, b7);
+  }
+  for (k = 0; k < DCTSIZE; k++) {
+    data32[0][k] = _mm_unpacklo_epi16(row16[k], zero);
+    data32[1][k] = _mm_unpackhi_epi16(row16[k], zero);
+  }
+
+  /* Pass 1: process rows, four at a time. */
+  for (h = 0; h < 2; h++) {
+    __m128i * in = data32[h];
+
+    FDCT_1D(__m128i, SSE2_ADD, SSE2_SUB, SSE2_MUL, in,
+	    _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)), out);
+    in[0] = _mm_slli_epi32(_mm_sub_epi32(out[0], _mm_set1_epi32(8 * CENTERJSAMPLE)),
+			   PASS1_BITS);
+    in[4] = _mm_slli_epi32(out[4], PASS1_BITS);
+    for (k = 1; k < DCTSIZE; k++)
+      if (k != 4)
+	in[k] = _mm_srai_epi32(out[k], CONST_BITS-PASS1_BITS);
+  }
+
+  TRANSPOSE_4X4_EPI32(data32[0][0], data32[0][1], data32[0][2], data32[0][3]);
+  TRANSPOSE_4X4_EPI32(data32[0][4], data32[0][5], data32[0][6], data32[0][7]);
+  TRANSPOSE_4X4_EPI32(data32[1][0], data32[1][1], data32[1][2], data32[1][3]);
+  TRANSPOSE_4X4_EPI32(data32[1][4], data32[1][5], data32[1][6], data32[1][7]);
+  for (k = 0; k < 4; k++) {
+    __m128i t = data32[0][k + 4];
+    data32[0][k + 4] = data32[1][k];
+    data32[1][k] = t;
+  }
+
+  /* Pass 2: process columns, four at a time; out[k] is output row k. */
+  for (h = 0; h < 2; h++) {
+    __m128i * in = data32[h];
+    __m128i rnd = _mm_set1_epi32(1 << (PASS1_BITS-1));
+
+    FDCT_1D(__m128i, SSE2_ADD, SSE2_SUB, SSE2_MUL, in,
+	    _mm_set1_epi32(1 << (CONST_BITS+PASS1_BITS-1)), out);
+    out[0] = _mm_srai_epi32(_mm_add_epi32(out[0], rnd), PASS1_BITS);
+    out[4] = _mm_srai_epi32(_mm_add_epi32(out[4], rnd), PASS1_BITS);
+    for (k = 1; k < DCTSIZE; k++)
+      if (k != 4)
+	out[k] = _mm_srai_epi32(out[k], CONST_BITS+PASS1_BITS);
+    for (k = 0; k < DCTSIZE; k++)
+      _mm_storeu_si128((__m128i *) (data + k * DCTSIZE + 4 * h), out[k]);
+  }
+}
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+/* Signed 32-bit lanes to JCOEF, truncating as the (JCOEF) cast does. */
+
+#define WRAP_EPI16(a,b) \
+  _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16), \
+		  _mm_srai_epi32(_mm_slli_epi32(b, 16), 16))
+
+
+GLOBAL(void)
+jsimd_quantize_sse2 (JCOEFPTR coef_block, DCTELEM * divisors,
+		     DCTELEM * workspace)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 8) {
+    __m128i q[2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      __m128i temp = _mm_loadu_si128((const __m128i *) (workspace + i + 4 * h));
+      __m128i qval = _mm_loadu_si128((const __m128i *) (divisors + i + 4 * h));
+      __m128i sign = _mm_srai_epi32(temp, 31);
+      __m128i absval = _mm_sub_epi32(_mm_xor_si128(temp, sign), sign);
+      __m128 quot;
+
+      absval = _mm_add_epi32(absval, _mm_srai_epi32(qval, 1));
+      quot = _mm_div_ps(_mm_cvtepi32_ps(absval), _mm_cvtepi32_ps(qval));
+      q[h] = _mm_sub_epi32(_mm_xor_si128(_mm_cvttps_epi32(quot), sign), sign);
+    }
+    _mm_storeu_si128((__m128i *) (coef_block + i), WRAP_EPI16(q[0], q[1]));
+  }
+}
+
+#endif /* JSIMD_SSE2_SUPPORTED */
+
+
+#ifdef JSIMD_AVX2_SUPPORTED
+
+#include <immintrin.h>
+
+#ifdef __GNUC__
+#define AVX2_TARGET  __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+#define AVX2_ADD(a,b)  _mm256_add_epi32(a, b)
+#define AVX2_SUB(a,b)  _mm256_sub_epi32(a, b)
+#define AVX2_MUL(a,c)  _mm256_mullo_epi32(a, _mm256_set1_epi32((int) (c)))
+
+/* r[0..7] := transpose of the 8x8 matrix of 32-bit elements in r[0..7] */
+
+AVX2_TARGET LOCAL(void)
+transpose_8x8_epi32_avx2 (__m256i * r)
+{
+  __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+
+AVX2_TARGET GLOBAL(void)
+jsimd_fdct_islow_avx2 (DCTELEM * data, JSAMPARRAY sample_data,
+		       JDIMENSION start_col)
+{
+  __m256i data32[8], out[8];	/* rows, or columns after the transpose */
+  int k;
+
+  for (k = 0; k < DCTSIZE; k++)
+    data32[k] = _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64((const __m128i *) (sample_data[k] + start_col)));
+  transpose_8x8_epi32_avx2(data32);
+
+  /* Pass 1: process all rows at once. */
+  FDCT_1D(__m256i, AVX2_ADD, AVX2_SUB, AVX2_MUL, data32,
+	  _mm256_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)), out);
+  data32[0] = _mm256_slli_epi32(_mm256_sub_epi32(out[0], _mm256_set1_epi32(8 * CENTERJSAMPLE)),
+				PASS1_BITS);
+  data32[4] = _mm256_slli_epi32(out[4], PASS1_BITS);
+  for (k = 1; k < DCTSIZE; k++)
+    if (k != 4)
+      data32[k] = _mm256_srai_epi32(out[k], CONST_BITS-PASS1_BITS);
+
+  transpose_8x8_epi32_avx2(data32);
+
+  /* Pass 2: process all columns at once; out[k] is output row k. */
+  {
+    __m256i rnd = _mm256_set1_epi32(1 << (PASS1_BITS-1));
+
+    FDCT_1D(__m256i, AVX2_ADD, AVX2_SUB, AVX2_MUL, data32,
+	    _mm256_set1_epi32(1 << (CONST_BITS+PASS1_BITS-1)), out);
+    out[0] = _mm256_srai_epi32(_mm256_add_epi32(out[0], rnd), PASS1_BITS);
+    out[4] = _mm256_srai_epi32(_mm256_add_epi32(out[4], rnd), PASS1_BITS);
+    for (k = 1; k < DCTSIZE; k++)
+      if (k != 4)
+	out[k] = _mm256_srai_epi32(out[k], CONST_BITS+PASS1_BITS);
+  }
+  for (k = 0; k < DCTSIZE; k++)
+    _mm256_storeu_si256((__m256i *) (data + k * DCTSIZE), out[k]);
+}
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+AVX2_TARGET GLOBAL(void)
+jsimd_quantize_avx2 (JCOEFPTR coef_block, DCTELEM * divisors,
+		     DCTELEM * workspace)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 16) {
+    __m256i q[2], packed;
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      __m256i temp = _mm256_loadu_si256((const __m256i *) (workspace + i + 8 * h));
+      __m256i qval = _mm256_loadu_si256((const __m256i *) (divisors + i + 8 * h));
+      __m256i absval = _mm256_add_epi32(_mm256_abs_epi32(temp), _mm256_srai_epi32(qval, 1));
+      __m256 quot = _mm256_div_ps(_mm256_cvtepi32_ps(absval), _mm256_cvtepi32_ps(qval));
+
+      /* sign_epi32 zeroes the quotient of a zero coefficient; it is 0 anyway */
+      q[h] = _mm256_sign_epi32(_mm256_cvttps_epi32(quot), temp);
+      q[h] = _mm256_srai_epi32(_mm256_slli_epi32(q[h], 16), 16);
+    }
+    /* packs works within 128-bit halves; put the eight words back in order */
+    packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(q[0], q[1]),
+				      _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256((__m256i *) (coef_block + i), packed);
+  }
+}
+
+#endif /* JSIMD_AVX2_SUPPORTED */
+
+
+#ifdef JSIMD_NEON_SUPPORTED
+
+#include <arm_neon.h>
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+#define NEON_ADD(a,b)  vaddq_s32(a, b)
+#define NEON_SUB(a,b)  vsubq_s32(a, b)
+#define NEON_MUL(a,c)  vmulq_n_s32(a, (int32_t) (c))
+
+#define TRANSPOSE_4X4_S32(r0,r1,r2,r3) \
+{ \
+  int32x4x2_t t01_ = vtrnq_s32(r0, r1); \
+  int32x4x2_t t23_ = vtrnq_s32(r2, r3); \
+  r0 = vcombine_s32(vget_low_s32(t01_.val[0]), vget_low_s32(t23_.val[0])); \
+  r1 = vcombine_s32(vget_low_s32(t01_.val[1]), vget_low_s32(t23_.val[1])); \
+  r2 = vcombine_s32(vget_high_s32(t01_.val[0]), vget_high_s32(t23_.val[0])); \
+  r3 = vcombine_s32(vget_high_s32(t01_.val[1]), vget_high_s32(t23_.val[1])); \
+}
+
+
+GLOBAL(void)
+jsimd_fdct_islow_neon (DCTELEM * data, JSAMPARRAY sample_data,
+		       JDIMENSION start_col)
+{
+  /* same layout as in jsimd_fdct_islow_sse2 */
+  int32x4_t data32[2][8], out[8];
+  int h, k;
+
+  /* Load the rows as 32-bit samples; transpose 4x4 blocks into columns. */
+  for (k = 0; k < DCTSIZE; k++) {
+    int16x8_t row = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(sample_data[k] + start_col)));
+
+    data32[0][k] = vmovl_s16(vget_low_s16(row));
+    data32[1][k] = vmovl_s16(vget_high_s16(row));
+  }
+  TRANSPOSE_4X4_S32(data32[0][0], data32[0][1], data32[0][2], data32[0][3]);
+  TRANSPOSE_4X4_S32(data32[0][4], data32[0][5], data32[0][6], data32[0][7]);
+  TRANSPOSE_4X4_S32(data32[1][0], data32[1][1], data32[1][2], data32[1][3]);
+  TRANSPOSE_4X4_S32(data32[1][4], data32[1][5], data32[1][6], data32[1][7]);
+  for (k = 0; k < 4; k++) {
+    int32x4_t t = data32[0][k + 4];
+    data32[0][k + 4] = data32[1][k];
+    data32[1][k] = t;
+  }
+
+  /* Pass 1: process rows, four at a time. */
+  for (h = 0; h < 2; h++) {
+    int32x4_t * in = data32[h];
+
+    FDCT_1D(int32x4_t, NEON_ADD, NEON_SUB, NEON_MUL, in,
+	    vdupq_n_s32(1 << (CONST_BITS-PASS1_BITS-1)), out);
+    in[0] = vshlq_n_s32(vsubq_s32(out[0], vdupq_n_s32(8 * CENTERJSAMPLE)), PASS1_BITS);
+    in[4] = vshlq_n_s32(out[4], PASS1_BITS);
+    for (k = 1; k < DCTSIZE; k++)
+      if (k != 4)
+	in[k] = vshrq_n_s32(out[k], CONST_BITS-PASS1_BITS);
+  }
+
+  TRANSPOSE_4X4_S32(data32[0][0], data32[0][1], data32[0][2], data32[0][3]);
+  TRANSPOSE_4X4_S32(data32[0][4], data32[0][5], data32[0][6], data32[0][7]);
+  TRANSPOSE_4X4_S32(data32[1][0], data32[1][1], data32[1][2], data32[1][3]);
+  TRANSPOSE_4X4_S32(data32[1][4], data32[1][5], data32[1][6], data32[1][7]);
+  for (k = 0; k < 4; k++) {
+    int32x4_t t = data32[0][k + 4];
+    data32[0][k + 4] = data32[1][k];
+    data32[1][k] = t;
+  }
+
+  /* Pass 2: process columns, four at a time; out[k] is output row k. */
+  for (h = 0; h < 2; h++) {
+    int32x4_t * in = data32[h];
+    int32x4_t rnd = vdupq_n_s32(1 << (PASS1_BITS-1));
+
+    FDCT_1D(int32x4_t, NEON_ADD, NEON_SUB, NEON_MUL, in,
+	    vdupq_n_s32(1 << (CONST_BITS+PASS1_BITS-1)), out);
+    out[0] = vshrq_n_s32(vaddq_s32(out[0], rnd), PASS1_BITS);
+    out[4] = vshrq_n_s32(vaddq_s32(out[4], rnd), PASS1_BITS);
+    for (k = 1; k < DCTSIZE; k++)
+      if (k != 4)
+	out[k] = vshrq_n_s32(out[k], CONST_BITS+PASS1_BITS);
+    for (k = 0; k < DCTSIZE; k++)
+      vst1q_s32(data + k * DCTSIZE + 4 * h, out[k]);
+  }
+}
+
+#endif /* DCT_ISLOW_SUPPORTED */
+
+
+#ifdef __aarch64__		/* ARMv7 NEON has no vector divide */
+
+GLOBAL(void)
+jsimd_quantize_neon (JCOEFPTR coef_block, DCTELEM * divisors,
+		     DCTELEM * workspace)
+{
+  int i;
+
+  for (i = 0; i < DCTSIZE2; i += 8) {
+    int32x4_t q[2];
+    int h;
+
+    for (h = 0; h < 2; h++) {
+      int32x4_t temp = vld1q_s32(workspace + i + 4 * h);
+      int32x4_t qval = vld1q_s32(divisors + i + 4 * h);
+      int32x4_t absval = vaddq_s32(vabsq_s32(temp), vshrq_n_s32(qval, 1));
+      int32x4_t quot = vcvtq_s32_f32(vdivq_f32(vcvtq_f32_s32(absval),
+					       vcvtq_f32_s32(qval)));
+      int32x4_t sign = vshrq_n_s32(temp, 31);
+
+      q[h] = vsubq_s32(veorq_s32(quot, sign), sign);
+    }
+    /* vmovn keeps the low 16 bits, as the (JCOEF) cast does */
+    vst1q_s16(coef_block + i, vcombine_s16(vmovn_s32(q[0]), vmovn_s32(q[1])));
+  }
+}
+
+#endif /* __aarch64__ */
+
+#endif /* JSIMD_NEON_SUPPORTED */
@@ -0,0 +1,501 @@
+/*
+ * jidctsimd.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains SSE2, AVX2 and NEON versions of the slow-but-accurate
+ * integer IDCT (jidctint.c), dequantization included.  They carry out the
+ * same operations as jpeg_idct_islow in 32-bit lanes, several columns
+ * (pass 1) or rows (pass 2) at a time, and produce identical output.
+ *
+ * jpeg_idct_islow computes in INT32, which may be wider than 32 bits, so a
+ * block could produce intermediates a 32-bit lane cannot hold.  Each output
+ * is a linear combination of the dequantized coefficients; with
+ * |coefficient| summed over the block below SIMD_MAX_MAGNITUDE, every
+ * intermediate stays below 2**31.  Blocks above it (corrupt data, or rare
+ * extreme blocks of quality-100 files) are passed on to jpeg_idct_islow.
+ *
+ * The zero-AC shortcuts of jpeg_idct_islow need no special treatment: with
+ * this rounding they give the same result as the full computation.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"		/* Private declarations for DCT subsystem */
+#include "jsimd.h"
+
+#ifdef DCT_ISLOW_SUPPORTED
+
+#if DCTSIZE != 8
+  Sorry, this code only copes with 8x8 DCTs. /* deliberate syntax err */
+#endif
+
+
+/* Scaling and constants as in jidctint.c (8-bit samples). */
+
+#define CONST_BITS  13
+#define PASS1_BITS  2
+
+#define FIX_0_298631336  ((INT32)  2446)	/* FIX(0.298631336) */
+#define FIX_0_390180644  ((INT32)  3196)	/* FIX(0.390180644) */
+#define FIX_0_541196100  ((INT32)  4433)	/* FIX(0.541196100) */
+#define FIX_0_765366865  ((INT32)  6270)	/* FIX(0.765366865) */
+#define FIX_0_899976223  ((INT32)  7373)	/* FIX(0.899976223) */
+#define FIX_1_175875602  ((INT32)  9633)	/* FIX(1.175875602) */
+#define FIX_1_501321110  ((INT32)  12299)	/* FIX(1.501321110) */
+#define FIX_1_847759065  ((INT32)  15137)	/* FIX(1.847759065) */
+#define FIX_1_961570560  ((INT32)  16069)	/* FIX(1.961570560) */
+#define FIX_2_053119869  ((INT32)  16819)	/* FIX(2.053119869) */
+#define FIX_2_562915447  ((INT32)  20995)	/* FIX(2.562915447) */
+#define FIX_3_072711026  ((INT32)  25172)	/* FIX(3.072711026) */
+
+/* The largest coefficient of any intermediate, as a linear form of the 64
+ * dequantized inputs, is about 116500; 16384 * 116500 plus the rounding
+ * terms is below 2**31.
+ */
+#define SIMD_MAX_MAGNITUDE  16384
+
+
+/* One 1-D IDCT of eight vectors in[0..7] into out[0..7], operation for
+ * operation as in jpeg_idct_islow.  e0 and e4 are the even-part inputs
+ * in[0] and in[4] already scaled by 2**CONST_BITS, e0 with the rounding
+ * term of the pass added.  Outputs are not yet descaled.
+ */
+
+#define IDCT_1D(T, ADD, SUB, MUL, in, e0, e4, out) \
+{ \
+  T z1_, z2_, z3_, tmp0_, tmp1_, tmp2_, tmp3_; \
+  T tmp10_, tmp11_, tmp12_, tmp13_; \
+  \
+  z1_ = MUL(ADD(in[2], in[6]), FIX_0_541196100); \
+  tmp2_ = ADD(z1_, MUL(in[2], FIX_0_765366865)); \
+  tmp3_ = SUB(z1_, MUL(in[6], FIX_1_847759065)); \
+  \
+  tmp0_ = ADD(e0, e4); \
+  tmp1_ = SUB(e0, e4); \
+  \
+  tmp10_ = ADD(tmp0_, tmp2_); \
+  tmp13_ = SUB(tmp0_, tmp2_); \
+  tmp11_ = ADD(tmp1_, tmp3_); \
+  tmp12_ = SUB(tmp1_, tmp3_); \
+  \
+  tmp0_ = in[7]; \
+  tmp1_ = in[5]; \
+  tmp2_ = in[3]; \
+  tmp3_ = in[1]; \
+  \
+  z2_ = ADD(tmp0_, tmp2_); \
+  z3_ = ADD(tmp1_, tmp3_); \
+  \
+  z1_ = MUL(ADD(z2_, z3_), FIX_1_175875602); \
+  z2_ = ADD(MUL(z2_, - FIX_1_961570560), z1_); \
+  z3_ = ADD(MUL(z3_, - FIX_0_390180644), z1_); \
+  \
+  z1_ = MUL(ADD(tmp0_, tmp3_), - FIX_0_899976223); \
+  tmp0_ = ADD(MUL(tmp0_, FIX_0_298631336), ADD(z1_, z2_)); \
+  tmp3_ = ADD(MUL(tmp3_, FIX_1_501321110), ADD(z1_, z3_)); \
+  \
+  z1_ = MUL(ADD(tmp1_, tmp2_), - FIX_2_562915447); \
+  tmp1_ = ADD(MUL(tmp1_, FIX_2_053119869), ADD(z1_, z3_)); \
+  tmp2_ = ADD(MUL(tmp2_, FIX_3_072711026), ADD(z1_, z2_)); \
+  \
+  out[0] = ADD(tmp10_, tmp3_); \
+  out[7] = SUB(tmp10_, tmp3_); \
+  out[1] = ADD(tmp11_, tmp2_); \
+  out[6] = SUB(tmp11_, tmp2_); \
+  out[2] = ADD(tmp12_, tmp1_); \
+  out[5] = SUB(tmp12_, tmp1_); \
+  out[3] = ADD(tmp13_, tmp0_); \
+  out[4] = SUB(tmp13_, tmp0_); \
+}
+
+/* Pass 2 outputs are descaled by CONST_BITS+PASS1_BITS+3 = 18 bits and
+ * range-limited as by IDCT_range_limit(): the table is indexed by the low
+ * 10 bits, which it maps like a 10-bit signed value clamped to -128..127,
+ * plus CENTERJSAMPLE.  Shifting left by 4 and arithmetically right by 22
+ * yields that signed value; the clamp is the saturating pack.
+ */
+
+
+#ifdef JSIMD_SSE2_SUPPORTED
+
+#include <emmintrin.h>
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+/* Low 32 bits of the lane products (the same for signed and unsigned). */
+
+LOCAL(__m128i)
+mullo_epi32_sse2 (__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+  return _mm_mullo_epi32(a, b);
+#else
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+			    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+#define SSE2_ADD(a,b)  _mm_add_epi32(a, b)
+#define SSE2_SUB(a,b)  _mm_sub_epi32(a, b)
+#define SSE2_MUL(a,c)  mullo_epi32_sse2(a, _mm_set1_epi32((int) (c)))
+
+#define TRANSPOSE_4X4_EPI32(r0,r1,r2,r3) \
+{ \
+  __m128i t0_ = _mm_unpacklo_epi32(r0, r1); \
+  __m128i t1_ = _mm_unpacklo_epi32(r2, r3); \
+  __m128i t2_ = _mm_unpackhi_epi32(r0, r1); \
+  __m128i t3_ = _mm_unpackhi_epi32(r2, r3); \
+  r0 = _mm_unpacklo_epi64(t0_, t1_); \
+  r1 = _mm_unpackhi_epi64(t0_, t1_); \
+  r2 = _mm_unpacklo_epi64(t2_, t3_); \
+  r3 = _mm_unpackhi_epi64(t2_, t3_); \
+}
+
+
+GLOBAL(void)
+jsimd_idct_islow_sse2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  ISLOW_MULT_TYPE * quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  /* [h][k]: row k, columns 4h..4h+3; after the transpose, column k of
+   * rows 4h..4h+3.
+   */
+  __m128i data[2][8], out[8], col16[8];
+  __m128i magnitude = _mm_setzero_si128();
+  __m128i ones = _mm_set1_epi16(1);
+  int h, k;
+
+  /* Dequantize, and total the magnitudes saturated to 16 bits. */
+  for (k = 0; k < DCTSIZE; k++) {
+    __m128i coef = _mm_loadu_si128((const __m128i *) (coef_block + k * DCTSIZE));
+    __m128i packed, absval;
+
+    data[0][k] = mullo_epi32_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(coef, coef), 16),
+      _mm_loadu_si128((const __m128i *) (quantptr + k * DCTSIZE)));
+    data[1][k] = mullo_epi32_sse2(_mm_srai_epi32(_mm_unpackhi_epi16(coef, coef), 16),
+      _mm_loadu_si128((const __m128i *) (quantptr + k * DCTSIZE + 4)));
+    packed = _mm_packs_epi32(data[0][k], data[1][k]);
+    absval = _mm_max_epi16(packed, _mm_subs_epi16(_mm_setzero_si128(), packed));
+    magnitude = _mm_add_epi32(magnitude, _mm_madd_epi16(absval, ones));
+  }
+  magnitude = _mm_add_epi32(magnitude, _mm_shuffle_epi32(magnitude, _MM_SHUFFLE(1, 0, 3, 2)));
+  magnitude = _mm_add_epi32(magnitude, _mm_shuffle_epi32(magnitude, _MM_SHUFFLE(2, 3, 0, 1)));
+  if (_mm_cvtsi128_si32(magnitude) >= SIMD_MAX_MAGNITUDE) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process columns, four at a time. */
+  for (h = 0; h < 2; h++) {
+    __m128i * in = data[h];
+    __m128i e0 = _mm_add_epi32(_mm_slli_epi32(in[0], CONST_BITS),
+			       _mm_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)));
+    __m128i e4 = _mm_slli_epi32(in[4], CONST_BITS);
+
+    IDCT_1D(__m128i, SSE2_ADD, SSE2_SUB, SSE2_MUL, in, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      in[k] = _mm_srai_epi32(out[k], CONST_BITS-PASS1_BITS);
+  }
+
+  TRANSPOSE_4X4_EPI32(data[0][0], data[0][1], data[0][2], data[0][3]);
+  TRANSPOSE_4X4_EPI32(data[0][4], data[0][5], data[0][6], data[0][7]);
+  TRANSPOSE_4X4_EPI32(data[1][0], data[1][1], data[1][2], data[1][3]);
+  TRANSPOSE_4X4_EPI32(data[1][4], data[1][5], data[1][6], data[1][7]);
+  for (k = 0; k < 4; k++) {
+    __m128i t = data[0][k + 4];
+    data[0][k + 4] = data[1][k];
+    data[1][k] = t;
+  }
+
+  /* Pass 2: process rows, four at a time; out[k] is output column k. */
+  for (h = 0; h < 2; h++) {
+    __m128i * in = data[h];
+    __m128i e0 = _mm_slli_epi32(_mm_add_epi32(in[0], _mm_set1_epi32(1 << (PASS1_BITS+2))),
+				CONST_BITS);
+    __m128i e4 = _mm_slli_epi32(in[4], CONST_BITS);
+
+    IDCT_1D(__m128i, SSE2_ADD, SSE2_SUB, SSE2_MUL, in, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      in[k] = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(out[k], 4), 22),
+			    _mm_set1_epi32(CENTERJSAMPLE));
+  }
+
+  /* Transpose the 16-bit columns into rows and store them as bytes. */
+  for (k = 0; k < DCTSIZE; k++)
+    col16[k] = _mm_packs_epi32(data[0][k], data[1][k]);
+  {
+    __m128i a0 = _mm_unpacklo_epi16(col16[0], col16[1]);
+    __m128i a1 = _mm_unpackhi_epi16(col16[0], col16[1]);
+    __m128i a2 = _mm_unpacklo_epi16(col16[2], col16[3]);
+    __m128i a3 = _mm_unpackhi_epi16(col16[2], col16[3]);
+    __m128i a4 = _mm_unpacklo_epi16(col16[4], col16[5]);
+    __m128i a5 = _mm_unpackhi_epi16(col16[4], col16[5]);
+    __m128i a6 = _mm_unpacklo_epi16(col16[6], col16[7]);
+    __m128i a7 = _mm_unpackhi_epi16(col16[6], col16[7]);
+    __m128i b0 = _mm_unpacklo_epi32(a0, a2);
+    __m128i b1 = _mm_unpackhi_epi32(a0, a2);
+    __m128i b2 = _mm_unpacklo_epi32(a1, a3);
+    __m128i b3 = _mm_unpackhi_epi32(a1, a3);
+    __m128i b4 = _mm_unpacklo_epi32(a4, a6);
+    __m128i b5 = _mm_unpackhi_epi32(a4, a6);
+    __m128i b6 = _mm_unpacklo_epi32(a5, a7);
+    __m128i b7 = _mm_unpackhi_epi32(a5, a7);
+    __m128i rows01 = _mm_packus_epi16(_mm_unpacklo_epi64(b0, b4), _mm_unpackhi_epi64(b0, b4));
+    __m128i rows23 = _mm_packus_epi16(_mm_unpacklo_epi64(b1, b5), _mm_unpackhi_epi64(b1, b5));
+    __m128i rows45 = _mm_packus_epi16(_mm_unpacklo_epi64(b2, b6), _mm_unpackhi_epi64(b2, b6));
+    __m128i rows67 = _mm_packus_epi16(_mm_unpacklo_epi64(b3, b7), _mm_unpackhi_epi64(b3, b7));
+
+    _mm_storel_epi64((__m128i *) (output_buf[0] + output_col), rows01);
+    _mm_storel_epi64((__m128i *) (output_buf[1] + output_col), _mm_srli_si128(rows01, 8));
+    _mm_storel_epi64((__m128i *) (output_buf[2] + output_col), rows23);
+    _mm_storel_epi64((__m128i *) (output_buf[3] + output_col), _mm_srli_si128(rows23, 8));
+    _mm_storel_epi64((__m128i *) (output_buf[4] + output_col), rows45);
+    _mm_storel_epi64((__m128i *) (output_buf[5] + output_col), _mm_srli_si128(rows45, 8));
+    _mm_storel_epi64((__m128i *) (output_buf[6] + output_col), rows67);
+    _mm_storel_epi64((__m128i *) (output_buf[7] + output_col), _mm_srli_si128(rows67, 8));
+  }
+}
+
+#endif /* JSIMD_SSE2_SUPPORTED */
+
+
+#ifdef JSIMD_AVX2_SUPPORTED
+
+#include <immintrin.h>
+
+#ifdef __GNUC__
+#define AVX2_TARGET  __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+#define AVX2_ADD(a,b)  _mm256_add_epi32(a, b)
+#define AVX2_SUB(a,b)  _mm256_sub_epi32(a, b)
+#define AVX2_MUL(a,c)  _mm256_mullo_epi32(a, _mm256_set1_epi32((int) (c)))
+
+/* r[0..7] := transpose of the 8x8 matrix of 32-bit elements in r[0..7] */
+
+AVX2_TARGET LOCAL(void)
+transpose_8x8_epi32_avx2 (__m256i * r)
+{
+  __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+  __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+  __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+  __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+  __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+  __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+  __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+  __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+  __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+
+AVX2_TARGET GLOBAL(void)
+jsimd_idct_islow_avx2 (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  ISLOW_MULT_TYPE * quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  __m256i data[8], out[8];	/* rows, or columns after the transpose */
+  __m256i magnitude = _mm256_setzero_si256();
+  __m256i limit16 = _mm256_set1_epi32(32767);
+  __m128i sum;
+  int k;
+
+  /* Dequantize, and total the magnitudes saturated to 16 bits. */
+  for (k = 0; k < DCTSIZE; k++) {
+    data[k] = _mm256_mullo_epi32(
+      _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (coef_block + k * DCTSIZE))),
+      _mm256_loadu_si256((const __m256i *) (quantptr + k * DCTSIZE)));
+    magnitude = _mm256_add_epi32(magnitude,
+				 _mm256_min_epi32(_mm256_abs_epi32(data[k]), limit16));
+  }
+  sum = _mm_add_epi32(_mm256_castsi256_si128(magnitude), _mm256_extracti128_si256(magnitude, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  if (_mm_cvtsi128_si32(sum) >= SIMD_MAX_MAGNITUDE) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process all columns at once. */
+  {
+    __m256i e0 = _mm256_add_epi32(_mm256_slli_epi32(data[0], CONST_BITS),
+				  _mm256_set1_epi32(1 << (CONST_BITS-PASS1_BITS-1)));
+    __m256i e4 = _mm256_slli_epi32(data[4], CONST_BITS);
+
+    IDCT_1D(__m256i, AVX2_ADD, AVX2_SUB, AVX2_MUL, data, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      data[k] = _mm256_srai_epi32(out[k], CONST_BITS-PASS1_BITS);
+  }
+
+  transpose_8x8_epi32_avx2(data);
+
+  /* Pass 2: process all rows at once; out[k] is output column k. */
+  {
+    __m256i e0 = _mm256_slli_epi32(_mm256_add_epi32(data[0], _mm256_set1_epi32(1 << (PASS1_BITS+2))),
+				   CONST_BITS);
+    __m256i e4 = _mm256_slli_epi32(data[4], CONST_BITS);
+
+    IDCT_1D(__m256i, AVX2_ADD, AVX2_SUB, AVX2_MUL, data, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      out[k] = _mm256_add_epi32(_mm256_srai_epi32(_mm256_slli_epi32(out[k], 4), 22),
+				_mm256_set1_epi32(CENTERJSAMPLE));
+  }
+
+  /* Back to rows; pack four rows to 32 bytes, 8 per row in order. */
+  transpose_8x8_epi32_avx2(out);
+  for (k = 0; k < DCTSIZE; k += 4) {
+    __m256i rows = _mm256_packus_epi16(_mm256_packs_epi32(out[k], out[k + 1]),
+				       _mm256_packs_epi32(out[k + 2], out[k + 3]));
+    __m128i lo, hi;
+
+    rows = _mm256_permutevar8x32_epi32(rows, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+    lo = _mm256_castsi256_si128(rows);
+    hi = _mm256_extracti128_si256(rows, 1);
+    _mm_storel_epi64((__m128i *) (output_buf[k] + output_col), lo);
+    _mm_storel_epi64((__m128i *) (output_buf[k + 1] + output_col), _mm_srli_si128(lo, 8));
+    _mm_storel_epi64((__m128i *) (output_buf[k + 2] + output_col), hi);
+    _mm_storel_epi64((__m128i *) (output_buf[k + 3] + output_col), _mm_srli_si128(hi, 8));
+  }
+}
+
+#endif /* JSIMD_AVX2_SUPPORTED */
+
+
+#ifdef JSIMD_NEON_SUPPORTED
+
+#include <arm_neon.h>
+
+#define NEON_ADD(a,b)  vaddq_s32(a, b)
+#define NEON_SUB(a,b)  vsubq_s32(a, b)
+#define NEON_MUL(a,c)  vmulq_n_s32(a, (int32_t) (c))
+
+#define TRANSPOSE_4X4_S32(r0,r1,r2,r3) \
+{ \
+  int32x4x2_t t01_ = vtrnq_s32(r0, r1); \
+  int32x4x2_t t23_ = vtrnq_s32(r2, r3); \
+  r0 = vcombine_s32(vget_low_s32(t01_.val[0]), vget_low_s32(t23_.val[0])); \
+  r1 = vcombine_s32(vget_low_s32(t01_.val[1]), vget_low_s32(t23_.val[1])); \
+  r2 = vcombine_s32(vget_high_s32(t01_.val[0]), vget_high_s32(t23_.val[0])); \
+  r3 = vcombine_s32(vget_high_s32(t01_.val[1]), vget_high_s32(t23_.val[1])); \
+}
+
+
+GLOBAL(void)
+jsimd_idct_islow_neon (j_decompress_ptr cinfo, jpeg_component_info * compptr,
+		       JCOEFPTR coef_block,
+		       JSAMPARRAY output_buf, JDIMENSION output_col)
+{
+  ISLOW_MULT_TYPE * quantptr = (ISLOW_MULT_TYPE *) compptr->dct_table;
+  /* same layout as in jsimd_idct_islow_sse2 */
+  int32x4_t data[2][8], out[8];
+  int32x4_t magnitude = vdupq_n_s32(0);
+  int32x2_t sum;
+  int16x8_t col16[8];
+  int h, k;
+
+  /* Dequantize, and total the magnitudes saturated to 16 bits. */
+  for (k = 0; k < DCTSIZE; k++) {
+    int16x8_t coef = vld1q_s16(coef_block + k * DCTSIZE);
+
+    data[0][k] = vmulq_s32(vmovl_s16(vget_low_s16(coef)), vld1q_s32(quantptr + k * DCTSIZE));
+    data[1][k] = vmulq_s32(vmovl_s16(vget_high_s16(coef)), vld1q_s32(quantptr + k * DCTSIZE + 4));
+    magnitude = vaddq_s32(magnitude, vminq_s32(vabsq_s32(data[0][k]), vdupq_n_s32(32767)));
+    magnitude = vaddq_s32(magnitude, vminq_s32(vabsq_s32(data[1][k]), vdupq_n_s32(32767)));
+  }
+  sum = vadd_s32(vget_low_s32(magnitude), vget_high_s32(magnitude));
+  if (vget_lane_s32(vpadd_s32(sum, sum), 0) >= SIMD_MAX_MAGNITUDE) {
+    jpeg_idct_islow(cinfo, compptr, coef_block, output_buf, output_col);
+    return;
+  }
+
+  /* Pass 1: process columns, four at a time. */
+  for (h = 0; h < 2; h++) {
+    int32x4_t * in = data[h];
+    int32x4_t e0 = vaddq_s32(vshlq_n_s32(in[0], CONST_BITS),
+			     vdupq_n_s32(1 << (CONST_BITS-PASS1_BITS-1)));
+    int32x4_t e4 = vshlq_n_s32(in[4], CONST_BITS);
+
+    IDCT_1D(int32x4_t, NEON_ADD, NEON_SUB, NEON_MUL, in, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      in[k] = vshrq_n_s32(out[k], CONST_BITS-PASS1_BITS);
+  }
+
+  TRANSPOSE_4X4_S32(data[0][0], data[0][1], data[0][2], data[0][3]);
+  TRANSPOSE_4X4_S32(data[0][4], data[0][5], data[0][6], data[0][7]);
+  TRANSPOSE_4X4_S32(data[1][0], data[1][1], data[1][2], data[1][3]);
+  TRANSPOSE_4X4_S32(data[1][4], data[1][5], data[1][6], data[1][7]);
+  for (k = 0; k < 4; k++) {
+    int32x4_t t = data[0][k + 4];
+    data[0][k + 4] = data[1][k];
+    data[1][k] = t;
+  }
+
+  /* Pass 2: process rows, four at a time; out[k] is output column k. */
+  for (h = 0; h < 2; h++) {
+    int32x4_t * in = data[h];
+    int32x4_t e0 = vshlq_n_s32(vaddq_s32(in[0], vdupq_n_s32(1 << (PASS1_BITS+2))),
+			       CONST_BITS);
+    int32x4_t e4 = vshlq_n_s32(in[4], CONST_BITS);
+
+    IDCT_1D(int32x4_t, NEON_ADD, NEON_SUB, NEON_MUL, in, e0, e4, out);
+    for (k = 0; k < DCTSIZE; k++)
+      in[k] = vaddq_s32(vshrq_n_s32(vshlq_n_s32(out[k], 4), 22),
+			vdupq_n_s32(CENTERJSAMPLE));
+  }
+
+  /* Transpose the 16-bit columns into rows and store them as bytes. */
+  for (k = 0; k < DCTSIZE; k++)
+    col16[k] = vcombine_s16(vqmovn_s32(data[0][k]), vqmovn_s32(data[1][k]));
+  {
+    int16x8x2_t a01 = vtrnq_s16(col16[0], col16[1]);
+    int16x8x2_t a23 = vtrnq_s16(col16[2], col16[3]);
+    int16x8x2_t a45 = vtrnq_s16(col16[4], col16[5]);
+    int16x8x2_t a67 = vtrnq_s16(col16[6], col16[7]);
+    int32x4x2_t b02 = vtrnq_s32(vreinterpretq_s32_s16(a01.val[0]), vreinterpretq_s32_s16(a23.val[0]));
+    int32x4x2_t b13 = vtrnq_s32(vreinterpretq_s32_s16(a01.val[1]), vreinterpretq_s32_s16(a23.val[1]));
+    int32x4x2_t b46 = vtrnq_s32(vreinterpretq_s32_s16(a45.val[0]), vreinterpretq_s32_s16(a67.val[0]));
+    int32x4x2_t b57 = vtrnq_s32(vreinterpretq_s32_s16(a45.val[1]), vreinterpretq_s32_s16(a67.val[1]));
+    int16x8_t row[8];
+
+    row[0] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(b02.val[0]), vget_low_s32(b46.val[0])));
+    row[1] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(b13.val[0]), vget_low_s32(b57.val[0])));
+    row[2] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(b02.val[1]), vget_low_s32(b46.val[1])));
+    row[3] = vreinterpretq_s16_s32(vcombine_s32(vget_low_s32(b13.val[1]), vget_low_s32(b57.val[1])));
+    row[4] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(b02.val[0]), vget_high_s32(b46.val[0])));
+    row[5] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(b13.val[0]), vget_high_s32(b57.val[0])));
+    row[6] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(b02.val[1]), vget_high_s32(b46.val[1])));
+    row[7] = vreinterpretq_s16_s32(vcombine_s32(vget_high_s32(b13.val[1]), vget_high_s32(b57.val[1])));
+    for (k = 0; k < DCTSIZE; k++)
+      vst1_u8(output_buf[k] + output_col, vqmovun_s16(row[k]));
+  }
+}
+
+#endif /* JSIMD_NEON_SUPPORTED */
+
+#endif /* DCT_ISLOW_SUPPORTED */
@@ -10,9 +10,21 @@
  * assumes that you have the ANSI-standard library routine tmpfile().
  * Also, the problem of determining the amount of memory available
  * is shoved onto the user.
+ *
+ * Optionally, the pools freed by jpeg_destroy are cached per thread and
+ * handed out again by the next jpeg_create on that thread, so a loop
+ * coding many images stops calling malloc/free; see jpeg_mem_pool_enable.
  */
 
 #define JPEG_INTERNALS
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+#include <windows.h>		/* first: jmorecfg.h must see basetsd.h's INT32 */
+#else
+#include <pthread.h>
+#endif
+#endif
+
 #include "jinclude.h"
 #include "jpeglib.h"
 #include "jmemsys.h"		/* import the system-dependent declarations */
@@ -30,18 +42,298 @@ extern void free JPP((void *ptr));
 /*
  * Memory allocation and freeing are controlled by the regular library
  * routines malloc() and free().
+ *
+ * Every block carries a small header holding its real capacity, so that
+ * a block can go to the cache whether or not it was allocated while the
+ * thread was caching.  The header is two ALIGN_TYPEs long to keep the
+ * alignment malloc gave the block.
+ */
+
+#ifndef ALIGN_TYPE		/* so can override from jconfig.h */
+#define ALIGN_TYPE  double
+#endif
+
+typedef union block_hdr_struct {
+  struct {
+    union block_hdr_struct * next; /* next in cache bin, while cached */
+    size_t capacity;		/* usable bytes after the header */
+  } hdr;
+  ALIGN_TYPE dummy[2];		/* included in union to ensure alignment */
+} block_hdr;
+
+
+/*
+ * The cache sorts blocks into size classes four to an octave, from
+ * MIN_POOLED_SIZE up.  While caching, requests are rounded up to a class
+ * size, so that the pools of two images of nearly the same size fit
+ * each other; memory managers mostly ask for the same few sizes anyway.
+ */
+
+#define MIN_POOLED_SIZE  64	/* smaller blocks go straight back to free */
+#define NUM_CLASSES  (4 * 64)	/* more than enough for 64-bit size_t */
+
+typedef struct {
+  long high_water;		/* max bytes kept in the cache, 0 = off */
+  block_hdr * bins[NUM_CLASSES]; /* cached blocks of each size class */
+  struct jpeg_mem_pool_stats stats;
+} pool_state;
+
+
+/* Index of the smallest class holding n bytes; stores the class size. */
+
+LOCAL(int)
+class_above (size_t n, size_t * class_size)
+{
+  int k = 6;
+  size_t step, m;
+
+  if (n <= MIN_POOLED_SIZE) {
+    *class_size = MIN_POOLED_SIZE;
+    return 0;
+  }
+  while ((n >> k) > 1)		/* 2^k <= n < 2^(k+1) */
+    k++;
+  step = (size_t) 1 << (k - 2);
+  m = (n + step - 1) / step;	/* 5..8 */
+  *class_size = m * step;
+  return (k - 6) * 4 + (int) (m - 4);
+}
+
+/* Index of the largest class not above n bytes, n >= MIN_POOLED_SIZE. */
+
+LOCAL(int)
+class_below (size_t n)
+{
+  int k = 6;
+
+  while ((n >> k) > 1)
+    k++;
+  return (k - 6) * 4 + (int) ((n >> (k - 2)) - 4);
+}
+
+
+LOCAL(void)
+release_cache (pool_state * state)
+{
+  int i;
+  block_hdr * hdr;
+
+  for (i = 0; i < NUM_CLASSES; i++) {
+    while ((hdr = state->bins[i]) != NULL) {
+      state->bins[i] = hdr->hdr.next;
+      free(hdr);
+    }
+  }
+  state->stats.bytes_cached = 0;
+  state->stats.blocks_cached = 0;
+}
+
+
+/*
+ * Per-thread cache state.  A thread has none until it enables caching
+ * (or the JPEGPOOL environment variable asks for it); whatever a thread
+ * still has cached when it exits is freed.  Without thread support there
+ * is a single cache for the process, which is then not thread-safe.
  */
 
+static long default_high_water = 0; /* from JPEGPOOL, set up once */
+
+LOCAL(void)
+read_pool_env (void)
+{
+#ifndef NO_GETENV
+  char * poolenv;
+  long kbytes;
+  char ch = 'x';
+
+  /* Same syntax as JPEGMEM: thousands of bytes, or millions with 'm' */
+  if ((poolenv = getenv("JPEGPOOL")) != NULL &&
+      sscanf(poolenv, "%ld%c", &kbytes, &ch) > 0 && kbytes > 0) {
+    if (ch == 'm' || ch == 'M')
+      kbytes *= 1000L;
+    default_high_water = kbytes * 1000L;
+  }
+#endif
+}
+
+#ifdef NO_JPEG_THREADS
+
+static pool_state * the_state = NULL;
+static boolean env_read = FALSE;
+
+LOCAL(pool_state *)
+get_state (void)
+{
+  if (! env_read) {
+    read_pool_env();
+    env_read = TRUE;
+  }
+  return the_state;
+}
+
+LOCAL(void)
+set_state (pool_state * state)
+{
+  the_state = state;
+}
+
+#else
+
+static void
+#ifdef _WIN32
+WINAPI
+#endif
+destroy_state (void * state)
+{
+  if (state != NULL) {
+    release_cache((pool_state *) state);
+    free(state);
+  }
+}
+
+#ifdef _WIN32
+
+static DWORD state_key = FLS_OUT_OF_INDEXES;
+static INIT_ONCE state_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK
+make_state_key (PINIT_ONCE once, PVOID param, PVOID * context)
+{
+  state_key = FlsAlloc(destroy_state);
+  read_pool_env();
+  return TRUE;
+}
+
+LOCAL(pool_state *)
+get_state (void)
+{
+  InitOnceExecuteOnce(&state_once, make_state_key, NULL, NULL);
+  if (state_key == FLS_OUT_OF_INDEXES)
+    return NULL;
+  return (pool_state *) FlsGetValue(state_key);
+}
+
+LOCAL(void)
+set_state (pool_state * state)
+{
+  if (state_key != FLS_OUT_OF_INDEXES)
+    FlsSetValue(state_key, state);
+}
+
+#else
+
+static pthread_key_t state_key;
+static boolean state_key_ok = FALSE;
+static pthread_once_t state_once = PTHREAD_ONCE_INIT;
+
+static void
+make_state_key (void)
+{
+  state_key_ok = (pthread_key_create(&state_key, destroy_state) == 0);
+  read_pool_env();
+}
+
+LOCAL(pool_state *)
+get_state (void)
+{
+  pthread_once(&state_once, make_state_key);
+  if (! state_key_ok)
+    return NULL;
+  return (pool_state *) pthread_getspecific(state_key);
+}
+
+LOCAL(void)
+set_state (pool_state * state)
+{
+  if (state_key_ok)
+    pthread_setspecific(state_key, state);
+}
+
+#endif
+
+#endif /* NO_JPEG_THREADS */
+
+
+/* The calling thread's cache, created on first use if JPEGPOOL is set. */
+
+LOCAL(pool_state *)
+caching_state (void)
+{
+  pool_state * state = get_state();
+
+  if (state == NULL && default_high_water > 0) {
+    jpeg_mem_pool_enable(default_high_water);
+    state = get_state();
+  }
+  return (state != NULL && state->high_water > 0) ? state : NULL;
+}
+
+
+LOCAL(void *)
+get_block (size_t sizeofobject)
+{
+  pool_state * state = caching_state();
+  block_hdr * hdr;
+  size_t capacity = sizeofobject;
+  int cls = 0;
+
+  if (state != NULL) {
+    state->stats.gets++;
+    cls = class_above(sizeofobject, &capacity);
+    if ((hdr = state->bins[cls]) != NULL) {
+      state->bins[cls] = hdr->hdr.next;
+      state->stats.hits++;
+      state->stats.bytes_cached -= (long) hdr->hdr.capacity;
+      state->stats.blocks_cached--;
+      return (void *) (hdr + 1);
+    }
+  }
+  if (capacity > (size_t) -1 - SIZEOF(block_hdr))
+    return NULL;
+  hdr = (block_hdr *) malloc(SIZEOF(block_hdr) + capacity);
+  if (hdr == NULL)
+    return NULL;
+  hdr->hdr.capacity = capacity;
+  return (void *) (hdr + 1);
+}
+
+LOCAL(void)
+free_block (void * object)
+{
+  pool_state * state = caching_state();
+  block_hdr * hdr = (block_hdr *) object - 1;
+  size_t capacity = hdr->hdr.capacity;
+  int cls;
+
+  if (state != NULL) {
+    state->stats.frees++;
+    if (capacity >= MIN_POOLED_SIZE &&
+	(long) capacity <= state->high_water - state->stats.bytes_cached) {
+      cls = class_below(capacity);
+      hdr->hdr.next = state->bins[cls];
+      state->bins[cls] = hdr;
+      state->stats.bytes_cached += (long) capacity;
+      state->stats.blocks_cached++;
+      if (state->stats.peak_bytes_cached < state->stats.bytes_cached)
+	state->stats.peak_bytes_cached = state->stats.bytes_cached;
+      return;
+    }
+    state->stats.released++;	/* over the high-water mark */
+  }
+  free(hdr);
+}
+
+
 GLOBAL(void *)
 jpeg_get_small (j_common_ptr cinfo, size_t sizeofobject)
 {
-  return (void *) malloc(sizeofobject);
+  return get_block(sizeofobject);
 }
 
 GLOBAL(void)
 jpeg_free_small (j_common_ptr cinfo, void * object, size_t sizeofobject)
 {
-  free(object);
+  free_block(object);
 }
 
 
@@ -55,13 +347,98 @@ jpeg_free_small (j_common_ptr cinfo, void * object, size_t sizeofobject)
 GLOBAL(void FAR *)
 jpeg_get_large (j_common_ptr cinfo, size_t sizeofobject)
 {
-  return (void FAR *) malloc(sizeofobject);
+  return (void FAR *) get_block(sizeofobject);
 }
 
 GLOBAL(void)
 jpeg_free_large (j_common_ptr cinfo, void FAR * object, size_t sizeofobject)
 {
-  free(object);
+  free_block((void *) object);
+}
+
+
+/*
+ * Turn caching on for the calling thread, keeping at most high_water
+ * bytes of freed pools for reuse, or off (high_water <= 0), which frees
+ * everything cached.  The statistics are kept until the thread exits.
+ */
+
+GLOBAL(void)
+jpeg_mem_pool_enable (long high_water)
+{
+  pool_state * state = get_state();
+
+  if (high_water < 0)
+    high_water = 0;
+  if (state == NULL) {
+    if (high_water == 0)
+      return;
+    state = (pool_state *) malloc(SIZEOF(pool_state));
+    if (state == NULL)
+      return;			/* caching is only an optimisation */
+    MEMZERO(state, SIZEOF(pool_state));
+    set_state(state);
+    if (get_state() != state) {	/* no thread-local slot */
+      free(state);
+      return;
+    }
+  }
+  state->high_water = high_water;
+  state->stats.high_water = high_water;
+  if (high_water == 0)
+    release_cache(state);
+  else {
+    /* trim from the largest blocks down to the new mark */
+    int i;
+    block_hdr * hdr;
+
+    for (i = NUM_CLASSES - 1; i >= 0; i--) {
+      while (state->stats.bytes_cached > high_water &&
+	     (hdr = state->bins[i]) != NULL) {
+	state->bins[i] = hdr->hdr.next;
+	state->stats.bytes_cached -= (long) hdr->hdr.capacity;
+	state->stats.blocks_cached--;
+	state->stats.released++;
+	free(hdr);
+      }
+    }
+  }
+}
+
+
+/* Copy the calling thread's cache statistics (all zero if it has none). */
+
+GLOBAL(void)
+jpeg_mem_pool_get_stats (struct jpeg_mem_pool_stats * stats)
+{
+  pool_state * state = get_state();
+
+  if (state != NULL)
+    *stats = state->stats;
+  else
+    MEMZERO(stats, SIZEOF(struct jpeg_mem_pool_stats));
+}
+
+
+/*
+ * Print the calling thread's cache statistics, in the manner of the
+ * MEM_STATS report of jmemmgr.c.
+ */
+
+GLOBAL(void)
+jpeg_mem_pool_report (FILE * outfile)
+{
+  struct jpeg_mem_pool_stats st;
+
+  jpeg_mem_pool_get_stats(&st);
+  fprintf(outfile, "Memory pool: high-water %ld, cached %ld in %ld blocks,"
+	  " peak cached %ld\n",
+	  st.high_water, st.bytes_cached, st.blocks_cached,
+	  st.peak_bytes_cached);
+  fprintf(outfile, "  Gets %ld, from cache %ld, from malloc %ld\n",
+	  st.gets, st.hits, st.gets - st.hits);
+  fprintf(outfile, "  Frees %ld, released over high-water %ld\n",
+	  st.frees, st.released);
 }
 
 
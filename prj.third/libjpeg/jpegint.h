@@ -213,6 +213,10 @@ struct jpeg_entropy_decoder {
   JMETHOD(void, start_pass, (j_decompress_ptr cinfo));
   JMETHOD(boolean, decode_mcu, (j_decompress_ptr cinfo,
 				JBLOCKROW *MCU_data));
+  /* Reads past MCUs whose coefficients aren't wanted; NULL if the decoder
+   * has no cheaper way than decode_mcu.
+   */
+  JMETHOD(JDIMENSION, skip_mcus, (j_decompress_ptr cinfo, JDIMENSION count));
 };
 
 /* Inverse DCT (also performs dequantization) */
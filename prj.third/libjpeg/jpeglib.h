@@ -218,7 +218,10 @@ typedef enum {
 	JCS_RGB,		/* red/green/blue */
 	JCS_YCbCr,		/* Y/Cb/Cr (also known as YUV) */
 	JCS_CMYK,		/* C/M/Y/K */
-	JCS_YCCK		/* Y/Cb/Cr/K */
+	JCS_YCCK,		/* Y/Cb/Cr/K */
+	/* Decompression output only: the RGB colorspace in other layouts */
+	JCS_EXT_BGR,		/* blue/green/red */
+	JCS_EXT_BGRA		/* blue/green/red/alpha (always MAXJSAMPLE) */
 } J_COLOR_SPACE;
 
 /* DCT/IDCT algorithm options. */
@@ -462,6 +465,10 @@ struct jpeg_decompress_struct {
 
   unsigned int scale_num, scale_denom; /* fraction by which to scale image */
 
+  /* Region of the scaled image to output; set with jpeg_crop_output() */
+  JDIMENSION crop_x, crop_y;	/* top left corner of the region */
+  JDIMENSION crop_width, crop_height; /* its size; 0 = whole image */
+
   double output_gamma;		/* image gamma wanted in output */
 
   boolean buffered_image;	/* TRUE=multiple output passes */
@@ -877,6 +884,13 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_stdio_src		jStdSrc
 #define jpeg_mem_dest		jMemDest
 #define jpeg_mem_src		jMemSrc
+#define jpeg_buffer_dest	jBufDest
+#define jpeg_free_out_buffer	jFreeOutBuf
+#define jpeg_map_file		jMapFile
+#define jpeg_unmap_file		jUnmapFile
+#define jpeg_mem_pool_enable	jMemPoolEnable
+#define jpeg_mem_pool_get_stats	jMemPoolStats
+#define jpeg_mem_pool_report	jMemPoolReport
 #define jpeg_set_defaults	jSetDefaults
 #define jpeg_set_colorspace	jSetColorspace
 #define jpeg_default_colorspace	jDefColorspace
@@ -894,6 +908,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_finish_compress	jFinCompress
 #define jpeg_calc_jpeg_dimensions	jCjpegDimensions
 #define jpeg_write_raw_data	jWrtRawData
+#define jpeg_write_image_mt	jWrtImageMT
 #define jpeg_write_marker	jWrtMarker
 #define jpeg_write_m_header	jWrtMHeader
 #define jpeg_write_m_byte	jWrtMByte
@@ -903,6 +918,7 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_read_scanlines	jReadScanlines
 #define jpeg_finish_decompress	jFinDecompress
 #define jpeg_read_raw_data	jReadRawData
+#define jpeg_read_image_mt	jReadImageMT
 #define jpeg_has_multiple_scans	jHasMultScn
 #define jpeg_start_output	jStrtOutput
 #define jpeg_finish_output	jFinOutput
@@ -911,11 +927,14 @@ typedef JMETHOD(boolean, jpeg_marker_parser_method, (j_decompress_ptr cinfo));
 #define jpeg_consume_input	jConsumeInput
 #define jpeg_core_output_dimensions	jCoreDimensions
 #define jpeg_calc_output_dimensions	jCalcDimensions
+#define jpeg_crop_output	jCropOutput
 #define jpeg_save_markers	jSaveMarkers
 #define jpeg_set_marker_processor	jSetMarker
 #define jpeg_read_coefficients	jReadCoefs
 #define jpeg_write_coefficients	jWrtCoefs
 #define jpeg_copy_critical_parameters	jCopyCrit
+#define jpeg_request_transform	jReqTransform
+#define jpeg_transform_coefficients	jTransCoefs
 #define jpeg_abort_compress	jAbrtCompress
 #define jpeg_abort_decompress	jAbrtDecompress
 #define jpeg_abort		jAbort
@@ -962,6 +981,49 @@ EXTERN(void) jpeg_mem_src JPP((j_decompress_ptr cinfo,
 			      unsigned char * inbuffer,
 			      unsigned long insize));
 
+/* Destination manager writing into a buffer that is kept and reused across
+ * images, so a series of encodes stops allocating once it is large enough.
+ * Zero-initialize before first use; free with jpeg_free_out_buffer.
+ */
+struct jpeg_out_buffer {
+  JOCTET * data;		/* compressed data of the last image */
+  size_t size;			/* its length in bytes */
+  size_t capacity;		/* allocated length of data */
+};
+
+EXTERN(void) jpeg_buffer_dest JPP((j_compress_ptr cinfo,
+				  struct jpeg_out_buffer * outbuf));
+EXTERN(void) jpeg_free_out_buffer JPP((struct jpeg_out_buffer * outbuf));
+
+/* Read-only mapping of a whole file, decoded in place via jpeg_mem_src. */
+struct jpeg_file_map {
+  unsigned char * data;		/* NULL if not mapped */
+  unsigned long size;
+};
+
+EXTERN(boolean) jpeg_map_file JPP((struct jpeg_file_map * map,
+				   const char * filename));
+EXTERN(void) jpeg_unmap_file JPP((struct jpeg_file_map * map));
+
+/* Per-thread cache of the memory freed by jpeg_destroy, reused by the next
+ * jpeg_create on the same thread.  Off unless enabled here or through the
+ * JPEGPOOL environment variable (same syntax as JPEGMEM).
+ */
+struct jpeg_mem_pool_stats {
+  long high_water;		/* most bytes the cache may keep */
+  long bytes_cached;		/* bytes kept now */
+  long blocks_cached;		/* blocks kept now */
+  long peak_bytes_cached;	/* most bytes ever kept */
+  long gets;			/* blocks requested while caching */
+  long hits;			/* ... of which served from the cache */
+  long frees;			/* blocks released while caching */
+  long released;		/* blocks given back to free() over the mark */
+};
+
+EXTERN(void) jpeg_mem_pool_enable JPP((long high_water));
+EXTERN(void) jpeg_mem_pool_get_stats JPP((struct jpeg_mem_pool_stats * stats));
+EXTERN(void) jpeg_mem_pool_report JPP((FILE * outfile));
+
 /* Default parameter setup for compression */
 EXTERN(void) jpeg_set_defaults JPP((j_compress_ptr cinfo));
 /* Compression parameter setup aids */
@@ -1002,6 +1064,13 @@ EXTERN(JDIMENSION) jpeg_write_raw_data JPP((j_compress_ptr cinfo,
 					    JSAMPIMAGE data,
 					    JDIMENSION num_lines));
 
+/* Writes all remaining scanlines, compressing restart intervals in parallel
+ * on up to num_threads threads; scanlines[] holds every input row.
+ */
+EXTERN(JDIMENSION) jpeg_write_image_mt JPP((j_compress_ptr cinfo,
+					    JSAMPARRAY scanlines,
+					    int num_threads));
+
 /* Write a special marker.  See libjpeg.txt concerning safe usage. */
 EXTERN(void) jpeg_write_marker
 	JPP((j_compress_ptr cinfo, int marker,
@@ -1040,6 +1109,13 @@ EXTERN(JDIMENSION) jpeg_read_raw_data JPP((j_decompress_ptr cinfo,
 					   JSAMPIMAGE data,
 					   JDIMENSION max_lines));
 
+/* Reads all remaining scanlines, decoding restart intervals in parallel
+ * on up to num_threads threads; scanlines[] holds every output row.
+ */
+EXTERN(JDIMENSION) jpeg_read_image_mt JPP((j_decompress_ptr cinfo,
+					   JSAMPARRAY scanlines,
+					   int num_threads));
+
 /* Additional entry points for buffered-image mode. */
 EXTERN(boolean) jpeg_has_multiple_scans JPP((j_decompress_ptr cinfo));
 EXTERN(boolean) jpeg_start_output JPP((j_decompress_ptr cinfo,
@@ -1059,6 +1135,20 @@ EXTERN(int) jpeg_consume_input JPP((j_decompress_ptr cinfo));
 EXTERN(void) jpeg_core_output_dimensions JPP((j_decompress_ptr cinfo));
 EXTERN(void) jpeg_calc_output_dimensions JPP((j_decompress_ptr cinfo));
 
+/* Restrict the output to a region of the image, after jpeg_read_header and
+ * before jpeg_start_decompress.  The region is in scaled output pixels; it
+ * is widened to the iMCU grid, as returned in *x, *y, *width and *height,
+ * and then becomes output_width by output_height.  Blocks left and right
+ * of it are only entropy-decoded, or skipped outright a restart interval
+ * at a time, and so are the rows above it in a single-scan image.  Rows
+ * below it are left to jpeg_finish_decompress, which skips them the same
+ * way; jpeg_abort_decompress doesn't read them at all.  Color quantization
+ * dithers the region as if it were the whole image.
+ */
+EXTERN(void) jpeg_crop_output JPP((j_decompress_ptr cinfo,
+				   JDIMENSION * x, JDIMENSION * y,
+				   JDIMENSION * width, JDIMENSION * height));
+
 /* Control saving of COM and APPn markers into marker_list. */
 EXTERN(void) jpeg_save_markers
 	JPP((j_decompress_ptr cinfo, int marker_code,
@@ -1076,6 +1166,57 @@ EXTERN(void) jpeg_write_coefficients JPP((j_compress_ptr cinfo,
 EXTERN(void) jpeg_copy_critical_parameters JPP((j_decompress_ptr srcinfo,
 						j_compress_ptr dstinfo));
 
+/* Lossless rotation, flipping, cropping and grayscale conversion of the
+ * DCT coefficients between jpeg_read_coefficients and
+ * jpeg_write_coefficients, without the IDCT/FDCT and generation loss.
+ * Set up a struct jpeg_transform_info and call jpeg_request_transform after
+ * jpeg_read_header; after jpeg_read_coefficients and
+ * jpeg_copy_critical_parameters, jpeg_transform_coefficients fixes up the
+ * destination's parameters and returns the arrays to hand to
+ * jpeg_write_coefficients.  Finish the compression before finishing the
+ * decompression, whose memory holds the transformed arrays.
+ */
+typedef enum {
+	JXFORM_NONE,		/* no transformation */
+	JXFORM_FLIP_H,		/* horizontal flip */
+	JXFORM_FLIP_V,		/* vertical flip */
+	JXFORM_TRANSPOSE,	/* transpose across UL-to-LR axis */
+	JXFORM_TRANSVERSE,	/* transpose across UR-to-LL axis */
+	JXFORM_ROT_90,		/* 90-degree clockwise rotation */
+	JXFORM_ROT_180,		/* 180-degree rotation */
+	JXFORM_ROT_270		/* 270-degree clockwise (or 90 ccw) */
+} JXFORM_CODE;
+
+struct jpeg_transform_info {
+  /* Set by the application: */
+  JXFORM_CODE transform;	/* image transform */
+  boolean trim;			/* drop edge iMCUs that can't be mirrored? */
+  boolean force_grayscale;	/* keep only the luminance plane? */
+  /* Region of the transformed image to keep, 0 width/height = to the edge;
+   * it is widened to the iMCU grid by jpeg_request_transform.
+   */
+  JDIMENSION crop_x, crop_y;
+  JDIMENSION crop_width, crop_height;
+
+  /* Set by jpeg_request_transform: */
+  JDIMENSION output_width;	/* dimensions of the transformed image */
+  JDIMENSION output_height;
+
+  /* Remaining fields are private to the transform code. */
+  int num_components;		/* components kept */
+  int iMCU_width, iMCU_height;	/* output iMCU size in pixels */
+  JDIMENSION mirror_iMCU_cols;	/* complete iMCUs in a mirrored direction */
+  JDIMENSION mirror_iMCU_rows;
+  jvirt_barray_ptr * workspace;	/* output arrays, NULL if none needed */
+};
+
+EXTERN(void) jpeg_request_transform JPP((j_decompress_ptr srcinfo,
+					 struct jpeg_transform_info * info));
+EXTERN(jvirt_barray_ptr *) jpeg_transform_coefficients
+	JPP((j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
+	     jvirt_barray_ptr * src_coef_arrays,
+	     struct jpeg_transform_info * info));
+
 /* If you choose to abort compression or decompression before completing
  * jpeg_finish_(de)compress, then you need to clean up to release memory,
  * temporary files, etc.  You can just call jpeg_destroy_(de)compress
@@ -0,0 +1,281 @@
+/*
+ * jsimd.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the run-time selection of SIMD routines: the CPU is
+ * queried once, and each selector returns the fastest routine that was
+ * compiled in and that the CPU supports.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jdct.h"
+#include "jsimd.h"
+
+#ifndef NO_GETENV
+#ifndef HAVE_STDLIB_H		/* <stdlib.h> should declare getenv() */
+extern char * getenv JPP((const char * name));
+#endif
+#endif
+
+#if defined(JSIMD_SSE2_SUPPORTED) && defined(JSIMD_AVX2_SUPPORTED)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+#if defined(JSIMD_SSE2_SUPPORTED) && defined(JSIMD_AVX2_SUPPORTED)
+
+/* SSSE3 and AVX2 as reported by cpuid; AVX2 also needs the OS to save the
+ * YMM registers (XCR0 bits 1 and 2).
+ */
+
+LOCAL(int)
+x86_cpu_features (void)
+{
+  unsigned int a, b, c, d, max_leaf, xcr0_lo;
+  int features = 0;
+#ifdef _MSC_VER
+  int regs[4];
+
+  __cpuid(regs, 0);
+  max_leaf = (unsigned int) regs[0];
+  __cpuid(regs, 1);
+  c = (unsigned int) regs[2];
+#else
+  max_leaf = __get_cpuid_max(0, NULL);
+  __cpuid(1, a, b, c, d);
+#endif
+  if (c & (1 << 9))
+    features |= JSIMD_SSSE3;
+  if (max_leaf < 7 || (c & (1 << 27)) == 0 || (c & (1 << 28)) == 0) /* OSXSAVE, AVX */
+    return features;
+#ifdef _MSC_VER
+  xcr0_lo = (unsigned int) _xgetbv(0);
+  __cpuidex(regs, 7, 0);
+  b = (unsigned int) regs[1];
+  a = d = 0;
+#else
+  __asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (d) : "c" (0));
+  __cpuid_count(7, 0, a, b, c, d);
+#endif
+  if ((xcr0_lo & 6) == 6 && (b & (1 << 5)) != 0)
+    features |= JSIMD_AVX2;
+  return features;
+}
+
+#endif
+
+
+LOCAL(boolean)
+env_flag (const char * name)
+{
+#ifndef NO_GETENV
+  char * value = getenv(name);
+
+  return value != NULL && value[0] == '1' ? TRUE : FALSE;
+#else
+  return FALSE;
+#endif
+}
+
+
+LOCAL(int)
+detect_cpu_features (void)
+{
+  int features = 0;
+
+#ifdef JSIMD_SSE2_SUPPORTED
+  features |= JSIMD_SSE2;	/* the build targets it already */
+#ifdef JSIMD_AVX2_SUPPORTED
+  features |= x86_cpu_features();
+#endif
+  if (env_flag("JSIMD_FORCESSE2"))
+    features &= JSIMD_SSE2;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  features |= JSIMD_NEON;
+#endif
+  if (env_flag("JSIMD_FORCENONE"))
+    features = 0;
+  return features;
+}
+
+
+/* -1 until the first query.  Every thread computes the same value, so a
+ * race on the first calls is harmless.
+ */
+static int cpu_features = -1;
+
+GLOBAL(int)
+jsimd_cpu_features (void)
+{
+  if (cpu_features < 0)
+    cpu_features = detect_cpu_features();
+  return cpu_features;
+}
+
+
+GLOBAL(inverse_DCT_method_ptr)
+jsimd_idct_islow_method (void)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+#ifdef JSIMD_AVX2_SUPPORTED
+  if (features & JSIMD_AVX2)
+    return jsimd_idct_islow_avx2;
+#endif
+#ifdef JSIMD_SSE2_SUPPORTED
+  if (features & JSIMD_SSE2)
+    return jsimd_idct_islow_sse2;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_idct_islow_neon;
+#endif
+  return NULL;
+}
+
+
+GLOBAL(forward_DCT_method_ptr)
+jsimd_fdct_islow_method (void)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+#ifdef DCT_ISLOW_SUPPORTED
+#ifdef JSIMD_AVX2_SUPPORTED
+  if (features & JSIMD_AVX2)
+    return jsimd_fdct_islow_avx2;
+#endif
+#ifdef JSIMD_SSE2_SUPPORTED
+  if (features & JSIMD_SSE2)
+    return jsimd_fdct_islow_sse2;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_fdct_islow_neon;
+#endif
+#endif
+  return NULL;
+}
+
+
+GLOBAL(quantize_method_ptr)
+jsimd_quantize_method (void)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+#ifdef JSIMD_AVX2_SUPPORTED
+  if (features & JSIMD_AVX2)
+    return jsimd_quantize_avx2;
+#endif
+#ifdef JSIMD_SSE2_SUPPORTED
+  if (features & JSIMD_SSE2)
+    return jsimd_quantize_sse2;
+#endif
+#if defined(JSIMD_NEON_SUPPORTED) && defined(__aarch64__)
+  if (features & JSIMD_NEON)
+    return jsimd_quantize_neon;
+#endif
+  return NULL;
+}
+
+
+/* The colour kernels handle JCS_RGB only in its default layout. */
+
+LOCAL(boolean)
+simd_rgb_layout (J_COLOR_SPACE out_color_space)
+{
+  if (out_color_space == JCS_RGB)
+    return RGB_RED == 0 && RGB_GREEN == 1 && RGB_BLUE == 2 &&
+	   RGB_PIXELSIZE == 3 ? TRUE : FALSE;
+  return out_color_space == JCS_EXT_BGR || out_color_space == JCS_EXT_BGRA ?
+	 TRUE : FALSE;
+}
+
+
+GLOBAL(jsimd_ycc_row_ptr)
+jsimd_ycc_rgb_method (J_COLOR_SPACE out_color_space)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+  if (! simd_rgb_layout(out_color_space))
+    return NULL;
+#ifdef JSIMD_SSSE3_SUPPORTED
+  if (features & JSIMD_SSSE3)
+    return jsimd_ycc_rgb_row_ssse3;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_ycc_rgb_row_neon;
+#endif
+  return NULL;
+}
+
+
+GLOBAL(jsimd_ycc_row_ptr)
+jsimd_h2_merged_method (J_COLOR_SPACE out_color_space)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+  if (! simd_rgb_layout(out_color_space))
+    return NULL;
+#ifdef JSIMD_SSSE3_SUPPORTED
+  if (features & JSIMD_SSSE3)
+    return jsimd_h2_merged_row_ssse3;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_h2_merged_row_neon;
+#endif
+  return NULL;
+}
+
+
+GLOBAL(jsimd_rgb_ycc_row_ptr)
+jsimd_rgb_ycc_method (void)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+  if (! simd_rgb_layout(JCS_RGB))
+    return NULL;
+#ifdef JSIMD_SSSE3_SUPPORTED
+  if (features & JSIMD_SSSE3)
+    return jsimd_rgb_ycc_row_ssse3;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_rgb_ycc_row_neon;
+#endif
+  return NULL;
+}
+
+
+GLOBAL(jsimd_downsample_row_ptr)
+jsimd_h2v2_downsample_method (void)
+{
+  int features = jsimd_cpu_features();
+
+  (void) features;
+#ifdef JSIMD_SSE2_SUPPORTED
+  if (features & JSIMD_SSE2)
+    return jsimd_h2v2_downsample_row_sse2;
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+  if (features & JSIMD_NEON)
+    return jsimd_h2v2_downsample_row_neon;
+#endif
+  return NULL;
+}
@@ -0,0 +1,164 @@
+/*
+ * jsimd.h
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file declares the SIMD versions of libjpeg's inner loops and the
+ * CPU-feature query used to pick them at run time.  The SIMD routines
+ * produce exactly the same output as the C routines they replace.
+ *
+ * USE_SSE_SIMD / USE_NEON_SIMD come from the build (compiler_definitions.cmake);
+ * the intrinsics are compiled only when the target has the instruction set.
+ * SSSE3 and AVX2 code is compiled whenever the compiler can target it and is
+ * used only on CPUs (and operating systems) that support it.
+ */
+
+#if BITS_IN_JSAMPLE == 8
+
+#if defined(USE_SSE_SIMD) && (defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define JSIMD_SSE2_SUPPORTED
+/* compilers that can target later instruction sets function by function */
+#if (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+    defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800)
+#define JSIMD_SSSE3_SUPPORTED
+#define JSIMD_AVX2_SUPPORTED
+#endif
+#endif
+
+#if defined(USE_NEON_SIMD) && (defined(__ARM_NEON__) || defined(__ARM_NEON))
+#define JSIMD_NEON_SUPPORTED
+#endif
+
+#endif /* BITS_IN_JSAMPLE == 8 */
+
+
+/* CPU features, as returned by jsimd_cpu_features(). */
+
+#define JSIMD_SSE2  0x01
+#define JSIMD_SSSE3 0x02
+#define JSIMD_AVX2  0x04
+#define JSIMD_NEON  0x08
+
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jsimd_cpu_features		jSCpuFeat
+#define jsimd_idct_islow_method		jSRDislowM
+#define jsimd_idct_islow_sse2		jSRDislowS
+#define jsimd_idct_islow_avx2		jSRDislowA
+#define jsimd_idct_islow_neon		jSRDislowN
+#define jsimd_ycc_rgb_method		jSYccRgbM
+#define jsimd_h2_merged_method		jSH2MergeM
+#define jsimd_ycc_rgb_row_ssse3		jSYccRgbS
+#define jsimd_ycc_rgb_row_neon		jSYccRgbN
+#define jsimd_h2_merged_row_ssse3	jSH2MergeS
+#define jsimd_h2_merged_row_neon	jSH2MergeN
+#define jsimd_rgb_ycc_method		jSRgbYccM
+#define jsimd_rgb_ycc_row_ssse3		jSRgbYccS
+#define jsimd_rgb_ycc_row_neon		jSRgbYccN
+#define jsimd_h2v2_downsample_method	jSH2V2DownM
+#define jsimd_h2v2_downsample_row_sse2	jSH2V2DownS
+#define jsimd_h2v2_downsample_row_neon	jSH2V2DownN
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+
+/* Features both compiled in and present on this CPU, minus those disabled
+ * by the environment: JSIMD_FORCENONE=1 disables all SIMD code,
+ * JSIMD_FORCESSE2=1 keeps x86 code from using anything beyond SSE2.
+ */
+EXTERN(int) jsimd_cpu_features JPP((void));
+
+/* The fastest routine for the 8x8 JDCT_ISLOW inverse DCT, or NULL if
+ * there is none; jpeg_idct_islow is then used.
+ */
+EXTERN(inverse_DCT_method_ptr) jsimd_idct_islow_method JPP((void));
+
+/* Row kernels of YCbCr->RGB conversion, for output in JCS_RGB (default
+ * RGB_RED/GREEN/BLUE/PIXELSIZE only), JCS_EXT_BGR or JCS_EXT_BGRA.  They
+ * convert a leading part of the num_cols output pixels of one row, using
+ * exactly the arithmetic of the build_ycc_rgb_table tables, and return
+ * the number of pixels done; the caller converts the rest.
+ * ycc_rgb rows have one Cb/Cr sample per pixel, h2_merged rows one per
+ * two pixels (the merged 2h1v/2h2v upsampler); the count is then even.
+ */
+typedef JMETHOD(JDIMENSION, jsimd_ycc_row_ptr,
+		(JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+		 JSAMPROW outptr, JDIMENSION num_cols,
+		 J_COLOR_SPACE out_color_space));
+
+/* The row kernels for out_color_space, or NULL if there are none. */
+EXTERN(jsimd_ycc_row_ptr) jsimd_ycc_rgb_method
+    JPP((J_COLOR_SPACE out_color_space));
+EXTERN(jsimd_ycc_row_ptr) jsimd_h2_merged_method
+    JPP((J_COLOR_SPACE out_color_space));
+
+/* Row kernels of RGB->YCbCr conversion (JCS_RGB input in the default
+ * RGB_RED/GREEN/BLUE/PIXELSIZE layout only) and of 2h2v downsampling
+ * without smoothing.  Like the kernels above they process a leading part
+ * of the row, with exactly the arithmetic of the C code, and return the
+ * number of output samples done; the count is even for downsampling, so
+ * that the C loop resumes with the right rounding bias.
+ */
+typedef JMETHOD(JDIMENSION, jsimd_rgb_ycc_row_ptr,
+		(JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+		 JSAMPROW outptr2, JDIMENSION num_cols));
+typedef JMETHOD(JDIMENSION, jsimd_downsample_row_ptr,
+		(JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+		 JDIMENSION output_cols));
+
+/* The row kernels, or NULL if there are none.  The forward DCT and
+ * quantization routines are declared in jdct.h.
+ */
+EXTERN(jsimd_rgb_ycc_row_ptr) jsimd_rgb_ycc_method JPP((void));
+EXTERN(jsimd_downsample_row_ptr) jsimd_h2v2_downsample_method JPP((void));
+
+#ifdef JSIMD_SSSE3_SUPPORTED
+EXTERN(JDIMENSION) jsimd_ycc_rgb_row_ssse3
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr, JDIMENSION num_cols, J_COLOR_SPACE out_color_space));
+EXTERN(JDIMENSION) jsimd_h2_merged_row_ssse3
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr, JDIMENSION num_cols, J_COLOR_SPACE out_color_space));
+EXTERN(JDIMENSION) jsimd_rgb_ycc_row_ssse3
+    JPP((JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	 JSAMPROW outptr2, JDIMENSION num_cols));
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+EXTERN(JDIMENSION) jsimd_ycc_rgb_row_neon
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr, JDIMENSION num_cols, J_COLOR_SPACE out_color_space));
+EXTERN(JDIMENSION) jsimd_h2_merged_row_neon
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW inptr2,
+	 JSAMPROW outptr, JDIMENSION num_cols, J_COLOR_SPACE out_color_space));
+EXTERN(JDIMENSION) jsimd_rgb_ycc_row_neon
+    JPP((JSAMPROW inptr, JSAMPROW outptr0, JSAMPROW outptr1,
+	 JSAMPROW outptr2, JDIMENSION num_cols));
+EXTERN(JDIMENSION) jsimd_h2v2_downsample_row_neon
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+	 JDIMENSION output_cols));
+#endif
+
+#ifdef JSIMD_SSE2_SUPPORTED
+EXTERN(JDIMENSION) jsimd_h2v2_downsample_row_sse2
+    JPP((JSAMPROW inptr0, JSAMPROW inptr1, JSAMPROW outptr,
+	 JDIMENSION output_cols));
+#endif
+
+#ifdef JSIMD_SSE2_SUPPORTED
+EXTERN(void) jsimd_idct_islow_sse2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#endif
+#ifdef JSIMD_AVX2_SUPPORTED
+EXTERN(void) jsimd_idct_islow_avx2
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#endif
+#ifdef JSIMD_NEON_SUPPORTED
+EXTERN(void) jsimd_idct_islow_neon
+    JPP((j_decompress_ptr cinfo, jpeg_component_info * compptr,
+	 JCOEFPTR coef_block, JSAMPARRAY output_buf, JDIMENSION output_col));
+#endif
@@ -0,0 +1,162 @@
+/*
+ * jthread.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains the worker threads of the multi-threaded modes.
+ * jthread_run hands out task numbers in order from a mutex-protected
+ * counter; each thread, the caller's included, loops taking the next one.
+ */
+
+#define JPEG_INTERNALS
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+#include <windows.h>		/* first: jmorecfg.h must see basetsd.h's INT32 */
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#include "jinclude.h"
+#include "jpeglib.h"
+#include "jthread.h"
+
+#define MAX_THREADS  64		/* more would not pay off */
+
+
+typedef struct {
+  jthread_task_ptr task;
+  void * arg;
+  int num_tasks;
+  int next_task;		/* next task to start, guarded by mutex */
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  CRITICAL_SECTION mutex;
+#else
+  pthread_mutex_t mutex;
+#endif
+#endif
+} task_queue;
+
+
+LOCAL(int)
+take_task (task_queue * queue)
+{
+  int task;
+
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  EnterCriticalSection(&queue->mutex);
+#else
+  pthread_mutex_lock(&queue->mutex);
+#endif
+#endif
+  task = queue->next_task;
+  if (task < queue->num_tasks)
+    queue->next_task++;
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  LeaveCriticalSection(&queue->mutex);
+#else
+  pthread_mutex_unlock(&queue->mutex);
+#endif
+#endif
+  return task;
+}
+
+
+LOCAL(void)
+run_tasks (task_queue * queue)
+{
+  int task;
+
+  while ((task = take_task(queue)) < queue->num_tasks)
+    (*queue->task) (queue->arg, task);
+}
+
+
+#ifndef NO_JPEG_THREADS
+
+#ifdef _WIN32
+
+static unsigned __stdcall
+thread_main (void * queue)
+{
+  run_tasks((task_queue *) queue);
+  return 0;
+}
+
+#else
+
+static void *
+thread_main (void * queue)
+{
+  run_tasks((task_queue *) queue);
+  return NULL;
+}
+
+#endif
+
+#endif /* NO_JPEG_THREADS */
+
+
+GLOBAL(void)
+jthread_run (int num_threads, int num_tasks, jthread_task_ptr task,
+	     void * arg)
+{
+  task_queue queue;
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  HANDLE threads[MAX_THREADS];
+#else
+  pthread_t threads[MAX_THREADS];
+#endif
+  int started = 0, i;
+#endif
+
+  queue.task = task;
+  queue.arg = arg;
+  queue.num_tasks = num_tasks;
+  queue.next_task = 0;
+
+  if (num_threads > num_tasks)
+    num_threads = num_tasks;
+  if (num_threads > MAX_THREADS)
+    num_threads = MAX_THREADS;
+
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  InitializeCriticalSection(&queue.mutex);
+  for (; started < num_threads - 1; started++) {
+    threads[started] = (HANDLE) _beginthreadex(NULL, 0, thread_main,
+					       &queue, 0, NULL);
+    if (threads[started] == 0)
+      break;
+  }
+#else
+  pthread_mutex_init(&queue.mutex, NULL);
+  for (; started < num_threads - 1; started++) {
+    if (pthread_create(&threads[started], NULL, thread_main, &queue) != 0)
+      break;
+  }
+#endif
+#endif
+
+  run_tasks(&queue);
+
+#ifndef NO_JPEG_THREADS
+#ifdef _WIN32
+  for (i = 0; i < started; i++) {
+    WaitForSingleObject(threads[i], INFINITE);
+    CloseHandle(threads[i]);
+  }
+  DeleteCriticalSection(&queue.mutex);
+#else
+  for (i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  pthread_mutex_destroy(&queue.mutex);
+#endif
+#endif
+}
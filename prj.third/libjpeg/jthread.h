@@ -0,0 +1,28 @@
+/*
+ * jthread.h
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file declares the minimal worker-thread support used by the
+ * multi-threaded decoding and encoding modes.  POSIX threads are used,
+ * or Win32 threads on Windows; define NO_JPEG_THREADS to build the library
+ * without threads, in which case all tasks run on the calling thread.
+ */
+
+/* Short forms of external names for systems with brain-damaged linkers. */
+
+#ifdef NEED_SHORT_EXTERNAL_NAMES
+#define jthread_run		jTRun
+#endif /* NEED_SHORT_EXTERNAL_NAMES */
+
+
+/* One task of a jthread_run batch.  Tasks must not longjmp out. */
+typedef JMETHOD(void, jthread_task_ptr, (void * arg, int task));
+
+/* Run tasks 0..num_tasks-1 on up to num_threads threads, the calling
+ * thread included, and return when all of them are done.  Tasks are
+ * started in order.  If threads cannot be created, fewer are used.
+ */
+EXTERN(void) jthread_run JPP((int num_threads, int num_tasks,
+			      jthread_task_ptr task, void * arg));
@@ -0,0 +1,340 @@
+/*
+ * jxform.c
+ *
+ * This file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README file.
+ *
+ * This file contains lossless transforms of the DCT coefficient arrays
+ * read by jpeg_read_coefficients: rotation by multiples of 90 degrees,
+ * flips, cropping on the iMCU grid and grayscale conversion, for writing
+ * with jpeg_write_coefficients.  Each output block is a source block with
+ * its coefficients transposed and/or some of them negated, so nothing
+ * passes through the IDCT or FDCT and the image loses no quality.
+ *
+ * Every transform is a transposition or none, followed by mirroring in x,
+ * in y, or both.  A mirror only maps whole iMCUs onto whole iMCUs, so a
+ * partial iMCU at the edge it would move to the other side is left in
+ * place, unmirrored; set trim to drop it from the output instead.
+ * Grayscale conversion keeps just the luminance component, whose iMCU is
+ * then a single block.
+ */
+
+#define JPEG_INTERNALS
+#include "jinclude.h"
+#include "jpeglib.h"
+
+
+LOCAL(boolean)
+transposes (JXFORM_CODE transform)
+{
+  return transform == JXFORM_TRANSPOSE || transform == JXFORM_TRANSVERSE ||
+	 transform == JXFORM_ROT_90 || transform == JXFORM_ROT_270;
+}
+
+/* Mirroring, in output coordinates, that follows the transposition */
+
+LOCAL(boolean)
+mirrors_x (JXFORM_CODE transform)
+{
+  return transform == JXFORM_FLIP_H || transform == JXFORM_ROT_90 ||
+	 transform == JXFORM_ROT_180 || transform == JXFORM_TRANSVERSE;
+}
+
+LOCAL(boolean)
+mirrors_y (JXFORM_CODE transform)
+{
+  return transform == JXFORM_FLIP_V || transform == JXFORM_ROT_270 ||
+	 transform == JXFORM_ROT_180 || transform == JXFORM_TRANSVERSE;
+}
+
+
+/*
+ * Work out the output image and request its coefficient arrays.
+ * Call after jpeg_read_header and before jpeg_read_coefficients, which
+ * realizes the arrays; the crop region in info is updated to the one
+ * actually kept.
+ */
+
+GLOBAL(void)
+jpeg_request_transform (j_decompress_ptr srcinfo,
+			struct jpeg_transform_info * info)
+{
+  jpeg_component_info *compptr;
+  JDIMENSION width, height, x, y, w, h;
+  int ci, h_samp, v_samp;
+  boolean transposed;
+
+  switch (info->transform) {
+  case JXFORM_NONE:
+  case JXFORM_FLIP_H:
+  case JXFORM_FLIP_V:
+  case JXFORM_TRANSPOSE:
+  case JXFORM_TRANSVERSE:
+  case JXFORM_ROT_90:
+  case JXFORM_ROT_180:
+  case JXFORM_ROT_270:
+    break;
+  default:
+    ERREXIT(srcinfo, JERR_NOTIMPL);
+  }
+  transposed = transposes(info->transform);
+
+  /* Gives min_DCT_h/v_scaled_size and the image size in the DCT domain */
+  jpeg_core_output_dimensions(srcinfo);
+
+  /* Output iMCU size; with a single component it is one block */
+  info->num_components = srcinfo->num_components;
+  if (info->force_grayscale && srcinfo->num_components > 1) {
+    compptr = srcinfo->comp_info;
+    if (srcinfo->jpeg_color_space != JCS_YCbCr ||
+	srcinfo->num_components != 3 ||
+	compptr->h_samp_factor != srcinfo->max_h_samp_factor ||
+	compptr->v_samp_factor != srcinfo->max_v_samp_factor)
+      ERREXIT(srcinfo, JERR_CONVERSION_NOTIMPL);
+    info->num_components = 1;
+  }
+  if (info->num_components == 1) {
+    h_samp = v_samp = 1;
+  } else {
+    h_samp = srcinfo->max_h_samp_factor;
+    v_samp = srcinfo->max_v_samp_factor;
+  }
+  if (transposed) {
+    info->iMCU_width = v_samp * srcinfo->min_DCT_v_scaled_size;
+    info->iMCU_height = h_samp * srcinfo->min_DCT_h_scaled_size;
+    width = srcinfo->output_height;
+    height = srcinfo->output_width;
+  } else {
+    info->iMCU_width = h_samp * srcinfo->min_DCT_h_scaled_size;
+    info->iMCU_height = v_samp * srcinfo->min_DCT_v_scaled_size;
+    width = srcinfo->output_width;
+    height = srcinfo->output_height;
+  }
+
+  /* Extent of the mirrorable iMCUs, and trimming to it */
+  info->mirror_iMCU_cols = width / (JDIMENSION) info->iMCU_width;
+  info->mirror_iMCU_rows = height / (JDIMENSION) info->iMCU_height;
+  if (info->trim) {
+    if (mirrors_x(info->transform) && info->mirror_iMCU_cols > 0)
+      width = info->mirror_iMCU_cols * (JDIMENSION) info->iMCU_width;
+    if (mirrors_y(info->transform) && info->mirror_iMCU_rows > 0)
+      height = info->mirror_iMCU_rows * (JDIMENSION) info->iMCU_height;
+  }
+
+  /* Crop region, aligned down to the output iMCU grid */
+  x = info->crop_x;
+  y = info->crop_y;
+  if (x >= width || y >= height)
+    ERREXIT(srcinfo, JERR_BAD_CROP_SPEC);
+  w = info->crop_width;
+  h = info->crop_height;
+  if (w == 0 || w > width - x)
+    w = width - x;
+  if (h == 0 || h > height - y)
+    h = height - y;
+  info->crop_x = x - x % (JDIMENSION) info->iMCU_width;
+  info->crop_y = y - y % (JDIMENSION) info->iMCU_height;
+  info->crop_width = w + (x - info->crop_x);
+  info->crop_height = h + (y - info->crop_y);
+  info->output_width = info->crop_width;
+  info->output_height = info->crop_height;
+
+  /* The source arrays serve as they are if nothing moves */
+  info->workspace = NULL;
+  if (info->transform == JXFORM_NONE &&
+      info->output_width == srcinfo->output_width &&
+      info->output_height == srcinfo->output_height)
+    return;
+
+  info->workspace = (jvirt_barray_ptr *)
+    (*srcinfo->mem->alloc_small) ((j_common_ptr) srcinfo, JPOOL_IMAGE,
+				  SIZEOF(jvirt_barray_ptr) *
+				  info->num_components);
+  for (ci = 0, compptr = srcinfo->comp_info; ci < info->num_components;
+       ci++, compptr++) {
+    /* Output sampling factors are the source's, swapped if transposed */
+    if (info->num_components == 1) {
+      h_samp = v_samp = 1;
+    } else if (transposed) {
+      h_samp = compptr->v_samp_factor;
+      v_samp = compptr->h_samp_factor;
+    } else {
+      h_samp = compptr->h_samp_factor;
+      v_samp = compptr->v_samp_factor;
+    }
+    info->workspace[ci] = (*srcinfo->mem->request_virt_barray)
+      ((j_common_ptr) srcinfo, JPOOL_IMAGE, FALSE,
+       (JDIMENSION) jdiv_round_up((long) info->output_width,
+				  (long) info->iMCU_width) * h_samp,
+       (JDIMENSION) jdiv_round_up((long) info->output_height,
+				  (long) info->iMCU_height) * v_samp,
+       (JDIMENSION) v_samp);
+  }
+}
+
+
+/*
+ * Copy one block, transposing it and negating the odd horizontal and/or
+ * vertical frequencies for a mirror in x and/or y.
+ */
+
+LOCAL(void)
+transfer_block (JCOEFPTR src, JCOEFPTR dst, boolean transposed,
+		boolean mirror_x, boolean mirror_y)
+{
+  int i, j;
+  JCOEF val;
+
+  if (! transposed && ! mirror_x && ! mirror_y) {
+    MEMCOPY(dst, src, SIZEOF(JBLOCK));
+    return;
+  }
+  for (i = 0; i < DCTSIZE; i++) {
+    for (j = 0; j < DCTSIZE; j++) {
+      val = transposed ? src[j*DCTSIZE + i] : src[i*DCTSIZE + j];
+      if ((mirror_x && (j & 1)) != (mirror_y && (i & 1)))
+	val = -val;
+      dst[i*DCTSIZE + j] = val;
+    }
+  }
+}
+
+
+/*
+ * Adjust the destination's parameters to the transformed image and fill
+ * in its coefficient arrays.  Call after jpeg_read_coefficients and
+ * jpeg_copy_critical_parameters, and before changing parameters that
+ * depend on the components, such as jpeg_simple_progression.
+ * Returns the arrays to pass to jpeg_write_coefficients.
+ */
+
+GLOBAL(jvirt_barray_ptr *)
+jpeg_transform_coefficients (j_decompress_ptr srcinfo, j_compress_ptr dstinfo,
+			     jvirt_barray_ptr * src_coef_arrays,
+			     struct jpeg_transform_info * info)
+{
+  jpeg_component_info *compptr;
+  JQUANT_TBL *qtbl;
+  JBLOCKARRAY src_buffer, dst_buffer;
+  JBLOCKROW src_row;
+  JDIMENSION width_in_blocks, height_in_blocks, x_crop_blocks, y_crop_blocks;
+  JDIMENSION mirror_cols, mirror_rows, dst_blk_x, dst_blk_y, src_blk_x, src_blk_y;
+  int ci, tblno, i, j, h_samp, v_samp, offset_x, offset_y;
+  boolean transposed, mirror_x, mirror_y, flip_x, flip_y;
+  UINT16 qval;
+
+  transposed = transposes(info->transform);
+  mirror_x = mirrors_x(info->transform);
+  mirror_y = mirrors_y(info->transform);
+
+  dstinfo->image_width = dstinfo->jpeg_width = info->output_width;
+  dstinfo->image_height = dstinfo->jpeg_height = info->output_height;
+
+  if (info->num_components == 1 && srcinfo->num_components > 1) {
+    /* Keep the luminance quantization table and component id */
+    tblno = srcinfo->comp_info[0].quant_tbl_no;
+    jpeg_set_colorspace(dstinfo, JCS_GRAYSCALE);
+    dstinfo->comp_info[0].component_id = srcinfo->comp_info[0].component_id;
+    dstinfo->comp_info[0].quant_tbl_no = tblno;
+  }
+
+  if (transposed) {
+    /* Swap the sampling factors and transpose the quantization tables */
+    for (ci = 0, compptr = dstinfo->comp_info; ci < dstinfo->num_components;
+	 ci++, compptr++) {
+      h_samp = compptr->h_samp_factor;
+      compptr->h_samp_factor = compptr->v_samp_factor;
+      compptr->v_samp_factor = h_samp;
+    }
+    for (tblno = 0; tblno < NUM_QUANT_TBLS; tblno++) {
+      qtbl = dstinfo->quant_tbl_ptrs[tblno];
+      if (qtbl == NULL)
+	continue;
+      for (i = 0; i < DCTSIZE; i++) {
+	for (j = 0; j < i; j++) {
+	  qval = qtbl->quantval[i*DCTSIZE + j];
+	  qtbl->quantval[i*DCTSIZE + j] = qtbl->quantval[j*DCTSIZE + i];
+	  qtbl->quantval[j*DCTSIZE + i] = qval;
+	}
+      }
+    }
+    qval = dstinfo->X_density;
+    dstinfo->X_density = dstinfo->Y_density;
+    dstinfo->Y_density = qval;
+  }
+
+  if (info->workspace == NULL)
+    return src_coef_arrays;
+
+  for (ci = 0, compptr = dstinfo->comp_info; ci < info->num_components;
+       ci++, compptr++) {
+    h_samp = compptr->h_samp_factor;
+    v_samp = compptr->v_samp_factor;
+    width_in_blocks = (JDIMENSION)
+      jdiv_round_up((long) info->output_width, (long) info->iMCU_width) *
+      h_samp;
+    height_in_blocks = (JDIMENSION)
+      jdiv_round_up((long) info->output_height, (long) info->iMCU_height) *
+      v_samp;
+    x_crop_blocks = info->crop_x / (JDIMENSION) info->iMCU_width * h_samp;
+    y_crop_blocks = info->crop_y / (JDIMENSION) info->iMCU_height * v_samp;
+    mirror_cols = info->mirror_iMCU_cols * h_samp;
+    mirror_rows = info->mirror_iMCU_rows * v_samp;
+
+    for (dst_blk_y = 0; dst_blk_y < height_in_blocks;
+	 dst_blk_y += (JDIMENSION) v_samp) {
+      dst_buffer = (*srcinfo->mem->access_virt_barray)
+	((j_common_ptr) srcinfo, info->workspace[ci], dst_blk_y,
+	 (JDIMENSION) v_samp, TRUE);
+      if (! transposed) {
+	/* Output rows come from source rows, v_samp of them at a time */
+	src_blk_y = dst_blk_y + y_crop_blocks;
+	flip_y = mirror_y && src_blk_y < mirror_rows;
+	if (flip_y)
+	  src_blk_y = mirror_rows - src_blk_y - (JDIMENSION) v_samp;
+	src_buffer = (*srcinfo->mem->access_virt_barray)
+	  ((j_common_ptr) srcinfo, src_coef_arrays[ci], src_blk_y,
+	   (JDIMENSION) v_samp, FALSE);
+	for (offset_y = 0; offset_y < v_samp; offset_y++) {
+	  src_row = src_buffer[flip_y ? v_samp - 1 - offset_y : offset_y];
+	  for (dst_blk_x = 0; dst_blk_x < width_in_blocks; dst_blk_x++) {
+	    src_blk_x = dst_blk_x + x_crop_blocks;
+	    flip_x = mirror_x && src_blk_x < mirror_cols;
+	    if (flip_x)
+	      src_blk_x = mirror_cols - 1 - src_blk_x;
+	    transfer_block(src_row[src_blk_x], dst_buffer[offset_y][dst_blk_x],
+			   FALSE, flip_x, flip_y);
+	  }
+	}
+      } else {
+	/* Output columns come from source rows, h_samp of them at a time;
+	 * the source component's v_samp_factor is our h_samp.
+	 */
+	for (dst_blk_x = 0; dst_blk_x < width_in_blocks;
+	     dst_blk_x += (JDIMENSION) h_samp) {
+	  src_blk_y = dst_blk_x + x_crop_blocks;
+	  flip_x = mirror_x && src_blk_y < mirror_cols;
+	  if (flip_x)
+	    src_blk_y = mirror_cols - src_blk_y - (JDIMENSION) h_samp;
+	  src_buffer = (*srcinfo->mem->access_virt_barray)
+	    ((j_common_ptr) srcinfo, src_coef_arrays[ci], src_blk_y,
+	     (JDIMENSION) h_samp, FALSE);
+	  for (offset_x = 0; offset_x < h_samp; offset_x++) {
+	    src_row = src_buffer[flip_x ? h_samp - 1 - offset_x : offset_x];
+	    for (offset_y = 0; offset_y < v_samp; offset_y++) {
+	      src_blk_x = dst_blk_y + (JDIMENSION) offset_y + y_crop_blocks;
+	      flip_y = mirror_y && src_blk_x < mirror_rows;
+	      if (flip_y)
+		src_blk_x = mirror_rows - 1 - src_blk_x;
+	      transfer_block(src_row[src_blk_x],
+			     dst_buffer[offset_y][dst_blk_x + offset_x],
+			     TRUE, flip_x, flip_y);
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  return info->workspace;
+}